@@ -3,10 +3,10 @@
 in vec3 FragPos;
 in vec3 Normal;
 in vec3 LightDir;
+in vec3 Color;
 
 out vec4 FragColor;
 
-uniform vec3 objectColor;
 uniform vec3 lightColor;
 
 void main()
@@ -27,6 +27,6 @@ void main()
     float spec = pow(angle, 15.0); // get specular strength
     vec3 specular = spec * lightColor;
     
-    vec3 result = (ambient + diffuse + specular) * objectColor;
+    vec3 result = (ambient + diffuse + specular) * Color;
     FragColor = vec4(result, 1.0);
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#version 430 core
+
+layout (location = 0) in vec3 mPos;
+#ifdef OCT_NORMALS
+layout (location = 1) in vec2 mNormal;
+#else
+layout (location = 1) in vec3 mNormal;
+#endif
+layout (location = 11) in uint drawIndex; // baseInstance + instance, streamed by the geometry arena
+
+struct DrawData {
+    mat4 model;        // position dequantization folded in
+    mat3 normalMatrix; // inverse transpose of the model matrix, computed on the CPU
+    vec4 color;
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 LightDir;
+out vec3 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 lightPos;
+
+vec3 decodeNormal()
+{
+#ifdef OCT_NORMALS
+    vec3 n = vec3(mNormal, 1.0 - abs(mNormal.x) - abs(mNormal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+#else
+    return mNormal;
+#endif
+}
+
+void main()
+{
+    DrawData draw = draws[drawIndex];
+    vec4 worldPos = draw.model * vec4(mPos, 1.0);
+    gl_Position = projection * view * worldPos;
+
+    FragPos = worldPos.xyz;
+    Normal = draw.normalMatrix * decodeNormal();
+    LightDir = normalize(lightPos - FragPos);
+    Color = draw.color.rgb;
+}
@@ -0,0 +1,48 @@
+#version 330 core
+
+layout (location = 0) in vec3 mPos;
+#ifdef OCT_NORMALS
+layout (location = 1) in vec2 mNormal;
+#else
+layout (location = 1) in vec3 mNormal;
+#endif
+layout (location = 2) in mat4 iModel;
+layout (location = 6) in vec3 iColor;
+layout (location = 8) in mat3 iNormalMatrix; // inverse transpose of iModel, computed on the CPU
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec3 LightDir;
+out vec3 Color;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 lightPos;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+vec3 decodeNormal()
+{
+#ifdef OCT_NORMALS
+    vec3 n = vec3(mNormal, 1.0 - abs(mNormal.x) - abs(mNormal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+#else
+    return mNormal;
+#endif
+}
+
+void main()
+{
+    // Identity for float positions, bounds dequantization for 16-bit ones
+    vec3 position = mPos * positionScale + positionOffset;
+    vec4 worldPos = iModel * vec4(position, 1.0);
+    gl_Position = projection * view * worldPos;
+
+    FragPos = worldPos.xyz;
+    Normal = iNormalMatrix * decodeNormal();
+    LightDir = normalize(lightPos - FragPos);
+    Color = iColor;
+}
\ No newline at end of file
@@ -0,0 +1,798 @@
+#ifndef __UBENCH_HPP__
+#define __UBENCH_HPP__
+#include "UNARROWPHASE.hpp"
+#include "UBODY.hpp"
+#include "UISLAND.hpp"
+#include "USOLVER.hpp"
+#include "UGL.hpp"
+#include "UPICK.hpp"
+#include "UCULL.hpp"
+#include "USCENE.hpp"
+#include <random>
+
+// Command line benchmarks that run without a window, dispatched from main()
+
+enum class BENCH_DISTRIBUTION {
+	UNIFORM,
+	CLUSTERED,
+	STACKED,
+	COUNT
+};
+
+inline const char* getDistributionName(BENCH_DISTRIBUTION distribution) {
+	static const char* names[] = { "uniform", "clustered", "stacked" };
+	return names[static_cast<size_t>(distribution)];
+}
+
+// Unit box centers laid out in one of the benchmark distributions, about one box per 8 units^3 when uniform
+inline std::vector<glm::vec3> makeBenchPositions(BENCH_DISTRIBUTION distribution, size_t count, uint32_t seed) {
+	std::mt19937 rng(seed);
+	float side = 2.0f * std::cbrt(static_cast<float>(count));
+	std::uniform_real_distribution<float> uniform(0.0f, side);
+	std::vector<glm::vec3> positions;
+	positions.reserve(count);
+
+	if (distribution == BENCH_DISTRIBUTION::UNIFORM) {
+		for (size_t i = 0; i < count; ++i) {
+			positions.push_back({ uniform(rng), uniform(rng), uniform(rng) });
+		}
+	}
+	else if (distribution == BENCH_DISTRIBUTION::CLUSTERED) {
+		std::vector<glm::vec3> centers;
+		for (int i = 0; i < 8; ++i) {
+			centers.push_back({ uniform(rng), uniform(rng), uniform(rng) });
+		}
+		std::normal_distribution<float> spread(0.0f, side / 16.0f);
+		for (size_t i = 0; i < count; ++i) {
+			const glm::vec3& center = centers[i % centers.size()];
+			positions.push_back(center + glm::vec3(spread(rng), spread(rng), spread(rng)));
+		}
+	}
+	else {
+		// Columns of 20 boxes resting on each other
+		const size_t height = 20;
+		size_t columns = (count + height - 1) / height;
+		size_t row = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(columns))));
+		for (size_t i = 0; i < count; ++i) {
+			size_t column = i / height;
+			positions.push_back({ (column % row) * 1.5f, (i % height) * 0.99f, (column / row) * 1.5f });
+		}
+	}
+	return positions;
+}
+
+inline void makeBenchBounds(const std::vector<glm::vec3>& positions, std::vector<AABB>& bounds) {
+	bounds.resize(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		bounds[i] = { positions[i] - glm::vec3(0.5f), positions[i] + glm::vec3(0.5f) };
+	}
+}
+
+// --bench-broadphase [count] [frames]: every backend on every distribution, with small
+// random motion per frame so incremental backends pay for their updates.
+inline void BENCH_BROADPHASE(size_t count, int frames) {
+	printf("Broadphase benchmark: %zu bodies, %d frames\n", count, frames);
+	printf("%-10s %-18s %10s %12s %s\n", "scene", "backend", "pairs", "ms/frame", "");
+	for (int d = 0; d < static_cast<int>(BENCH_DISTRIBUTION::COUNT); ++d) {
+		BENCH_DISTRIBUTION distribution = static_cast<BENCH_DISTRIBUTION>(d);
+		std::vector<glm::vec3> start = makeBenchPositions(distribution, count, 1234);
+		std::vector<BROADPHASE_PAIR> reference;
+		std::vector<AABB> bounds;
+		makeBenchBounds(start, bounds);
+		// Brute force is the reference, skipped when it would take minutes
+		bool validate = count <= 20000;
+		if (validate) {
+			createBroadphase(BROADPHASE_TYPE::BRUTE_FORCE)->COLLECT(bounds, reference);
+		}
+
+		for (int b = 0; b < static_cast<int>(BROADPHASE_TYPE::COUNT); ++b) {
+			BROADPHASE_TYPE type = static_cast<BROADPHASE_TYPE>(b);
+			if (type == BROADPHASE_TYPE::BRUTE_FORCE && !validate) {
+				continue;
+			}
+			std::unique_ptr<BROADPHASE> broadphase = createBroadphase(type);
+			std::vector<BROADPHASE_PAIR> pairs;
+			makeBenchBounds(start, bounds);
+			broadphase->COLLECT(bounds, pairs);
+			bool match = !validate || pairs == reference;
+
+			std::vector<glm::vec3> positions = start;
+			std::mt19937 rng(42);
+			std::uniform_real_distribution<float> jitter(-0.05f, 0.05f);
+			double total = 0.0;
+			for (int frame = 0; frame < frames; ++frame) {
+				for (glm::vec3& position : positions) {
+					position += glm::vec3(jitter(rng), jitter(rng), jitter(rng));
+				}
+				makeBenchBounds(positions, bounds);
+				broadphase->COLLECT(bounds, pairs);
+				total += broadphase->time;
+			}
+			printf("%-10s %-18s %10zu %12.3f %s\n", getDistributionName(distribution), getBroadphaseName(type),
+				broadphase->pairCount, total / std::max(frames, 1), match ? "" : "MISMATCH");
+		}
+	}
+}
+
+// --bench-narrowphase [count] [maxThreads]: CollisionChecking over the broadphase pairs of a
+// stacked scene from 1 to maxThreads threads, checking each run matches the single threaded hits,
+// then the batched shape tests against their scalar reference on the same pairs.
+inline void BENCH_NARROWPHASE(size_t count, size_t maxThreads) {
+	const int runs = 10;
+	std::vector<glm::vec3> positions = makeBenchPositions(BENCH_DISTRIBUTION::STACKED, count, 1234);
+	std::vector<std::shared_ptr<COLLIDER>> colliders;
+	std::vector<AABB> bounds;
+	for (const glm::vec3& position : positions) {
+		std::shared_ptr<BOX_COLLIDER> box = std::make_shared<BOX_COLLIDER>();
+		box->SET(position, glm::vec3(1.0f), glm::mat3(1.0f));
+		bounds.push_back(getColliderBounds(*box));
+		colliders.push_back(box);
+	}
+	std::vector<BROADPHASE_PAIR> pairs;
+	createBroadphase(BROADPHASE_TYPE::SWEEP_AND_PRUNE)->COLLECT(bounds, pairs);
+	printf("Narrowphase benchmark: %zu bodies, %zu pairs\n", count, pairs.size());
+	printf("%8s %12s %10s %s\n", "threads", "ms/run", "speedup", "");
+
+	auto test = [&](const BROADPHASE_PAIR& pair) {
+		return CollisionChecking(*colliders[pair.a], *colliders[pair.b]);
+	};
+	NARROWPHASE narrowphase;
+	std::vector<uint32_t> reference;
+	double baseline = 0.0;
+	for (size_t threads = 1; threads <= std::max<size_t>(maxThreads, 1); ++threads) {
+		narrowphase.setThreadCount(threads);
+		double total = 0.0;
+		for (int run = 0; run < runs; ++run) {
+			narrowphase.RUN(pairs, test);
+			total += narrowphase.time;
+		}
+		if (threads == 1) {
+			reference = narrowphase.hits;
+			baseline = total;
+		}
+		bool match = narrowphase.hits == reference;
+		printf("%8zu %12.3f %10.2f %s\n", threads, total / runs, baseline / total, match ? "" : "MISMATCH");
+	}
+
+	// The same pairs as shapes: the scalar reference through RUN against the batched kernels
+	NARROWPHASE_SHAPES shapes;
+	for (const std::shared_ptr<COLLIDER>& collider : colliders) {
+		shapes.ADD(*collider);
+	}
+#if defined(UBODY_AVX)
+	const char* kernel = "AVX";
+#elif defined(UBODY_SSE)
+	const char* kernel = "SSE";
+#else
+	const char* kernel = "scalar";
+#endif
+	printf("\nBatched (%s) against scalar shape tests\n", kernel);
+	printf("%8s %12s %12s %10s %s\n", "threads", "scalar ms", "batched ms", "speedup", "");
+	for (size_t threads = 1; threads <= std::max<size_t>(maxThreads, 1); ++threads) {
+		narrowphase.setThreadCount(threads);
+		double scalar = 0.0;
+		double batched = 0.0;
+		for (int run = 0; run < runs; ++run) {
+			narrowphase.RUN(pairs, [&](const BROADPHASE_PAIR& pair) {
+				return testShapes(shapes, pair.a, pair.b);
+			});
+			scalar += narrowphase.time;
+		}
+		std::vector<uint32_t> scalarHits = narrowphase.hits;
+		for (int run = 0; run < runs; ++run) {
+			narrowphase.RUN_BATCHED(pairs, shapes);
+			batched += narrowphase.time;
+		}
+		bool match = narrowphase.hits == scalarHits;
+		printf("%8zu %12.3f %12.3f %10.2f %s\n", threads, scalar / runs, batched / runs, scalar / batched, match ? "" : "MISMATCH");
+	}
+}
+
+// Box overlap by projecting both boxes on each candidate axis in world space, built independently of
+// testBoxBox to check it; slack widens (or, negative, narrows) every interval
+inline bool testBoxBoxProjected(const NARROWPHASE_SHAPE& a, const NARROWPHASE_SHAPE& b, float slack) {
+	std::vector<glm::vec3> axes;
+	for (int i = 0; i < 3; ++i) {
+		axes.push_back(a.axes[i]);
+		axes.push_back(b.axes[i]);
+		for (int j = 0; j < 3; ++j) {
+			glm::vec3 edge = glm::cross(a.axes[i], b.axes[j]);
+			if (glm::length(edge) > 1e-3f) {
+				axes.push_back(glm::normalize(edge));
+			}
+		}
+	}
+	for (const glm::vec3& axis : axes) {
+		float ra = 0.0f;
+		float rb = 0.0f;
+		for (int k = 0; k < 3; ++k) {
+			ra += a.extent[k] * std::abs(glm::dot(a.axes[k], axis));
+			rb += b.extent[k] * std::abs(glm::dot(b.axes[k], axis));
+		}
+		if (std::abs(glm::dot(b.center - a.center, axis)) > ra + rb + slack) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// --fuzz-narrowphase [pairs] [seed]: the batched kernels against the scalar reference on random and
+// degenerate pairs: rotated boxes, flat boxes, parallel axes, shared centers and faces touching exactly.
+// A pair whose answer changes when both shapes grow or shrink by 1e-4 sits on the boundary, where float
+// rounding may go either way, so only the other pairs count as mismatches. Box pairs also check the
+// scalar reference itself against testBoxBoxProjected. Returns false on a mismatch.
+inline bool FUZZ_NARROWPHASE(size_t count, uint32_t seed) {
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> size(0.05f, 2.0f);
+	std::uniform_int_distribution<int> pick(0, 7);
+	auto rotation = [&]() {
+		glm::vec3 axis(unit(rng), unit(rng), unit(rng));
+		if (glm::length(axis) < 1e-3f) {
+			return glm::mat3(1.0f);
+		}
+		return glm::mat3(glm::rotate(glm::mat4(1.0f), unit(rng) * glm::pi<float>(), glm::normalize(axis)));
+	};
+	auto extent = [&]() {
+		return glm::vec3(size(rng), size(rng), size(rng));
+	};
+	auto offset = [&]() {
+		return glm::vec3(unit(rng), unit(rng), unit(rng)) * 3.0f;
+	};
+
+	NARROWPHASE_SHAPES shapes;
+	std::vector<BROADPHASE_PAIR> pairs;
+	for (size_t i = 0; i < count; ++i) {
+		glm::vec3 center = offset();
+		glm::mat3 axes = rotation();
+		glm::vec3 extentA = extent();
+		glm::vec3 extentB = extent();
+		switch (pick(rng)) {
+		case 0: // parallel axes, the edge cross products vanish
+			shapes.ADD_BOX(center, extentA, axes);
+			shapes.ADD_BOX(center + offset(), extentB, axes);
+			break;
+		case 1: // faces touching exactly along one of A's axes
+		{
+			int k = static_cast<int>(rng() % 3);
+			shapes.ADD_BOX(center, extentA, glm::mat3(1.0f));
+			glm::vec3 other = center;
+			other[k] += extentA[k] + extentB[k];
+			shapes.ADD_BOX(other, extentB, glm::mat3(1.0f));
+			break;
+		}
+		case 2: // shared centers, one shape flat
+			extentB[static_cast<int>(rng() % 3)] = 0.0f;
+			shapes.ADD_BOX(center, extentA, axes);
+			shapes.ADD_BOX(center, extentB, rotation());
+			break;
+		case 3:
+			shapes.ADD_SPHERE(center, extentA.x);
+			shapes.ADD_SPHERE(center + offset(), extentB.x);
+			break;
+		case 4:
+			shapes.ADD_SPHERE(center + offset(), extentA.x);
+			shapes.ADD_BOX(center, extentB, axes);
+			break;
+		case 5: // the box first, so the batch swaps the pair
+			shapes.ADD_BOX(center, extentA, axes);
+			shapes.ADD_SPHERE(center + offset(), extentB.x);
+			break;
+		case 6: // a sphere inside a box, or on its corner
+			shapes.ADD_BOX(center, extentA, axes);
+			shapes.ADD_SPHERE(rng() % 2 ? center : center + axes * extentA, rng() % 2 ? 0.0f : extentB.x);
+			break;
+		default:
+			shapes.ADD_BOX(center, extentA, axes);
+			shapes.ADD_BOX(center + offset(), extentB, rotation());
+			break;
+		}
+		uint32_t first = static_cast<uint32_t>(shapes.size() - 2);
+		pairs.push_back({ first, first + 1 });
+	}
+
+	auto scaled = [&](float scale) {
+		NARROWPHASE_SHAPES result = shapes;
+		for (NARROWPHASE_SHAPE& shape : result.shapes) {
+			shape.extent = glm::max(shape.extent + glm::vec3(scale), glm::vec3(0.0f));
+		}
+		return result;
+	};
+	NARROWPHASE_SHAPES grown = scaled(1e-4f);
+	NARROWPHASE_SHAPES shrunk = scaled(-1e-4f);
+
+	NARROWPHASE narrowphase;
+	narrowphase.setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+	narrowphase.grain = 64;
+	const std::vector<uint32_t>& hits = narrowphase.RUN_BATCHED(pairs, shapes);
+	std::vector<uint8_t> batched(pairs.size(), 0);
+	for (uint32_t hit : hits) {
+		batched[hit] = 1;
+	}
+	size_t overlapping = 0;
+	size_t boundary = 0;
+	size_t boundaryDifferent = 0;
+	size_t mismatches = 0;
+	size_t referenceMismatches = 0;
+	for (size_t i = 0; i < pairs.size(); ++i) {
+		bool reference = testShapes(shapes, pairs[i].a, pairs[i].b);
+		const NARROWPHASE_SHAPE& a = shapes[pairs[i].a];
+		const NARROWPHASE_SHAPE& b = shapes[pairs[i].b];
+		if (!a.sphere && !b.sphere && testBoxBoxProjected(a, b, 1e-3f) == testBoxBoxProjected(a, b, -1e-3f)
+			&& testBoxBoxProjected(a, b, 0.0f) != reference) {
+			++referenceMismatches;
+		}
+		overlapping += reference ? 1 : 0;
+		if (testShapes(grown, pairs[i].a, pairs[i].b) != testShapes(shrunk, pairs[i].a, pairs[i].b)) {
+			++boundary;
+			boundaryDifferent += (batched[i] != 0) != reference ? 1 : 0;
+			continue;
+		}
+		if ((batched[i] != 0) != reference) {
+			if (mismatches < 10) {
+				printf("mismatch at pair %zu: batched %d, reference %d\n", i, batched[i], reference ? 1 : 0);
+			}
+			++mismatches;
+		}
+	}
+	printf("Narrowphase fuzz: %zu pairs, seed %u, %zu overlapping\n", pairs.size(), seed, overlapping);
+	printf("boundary pairs: %zu (%zu answered differently)\n", boundary, boundaryDifferent);
+	printf("mismatches: %zu, reference against projection: %zu\n", mismatches, referenceMismatches);
+	return mismatches == 0 && referenceMismatches == 0;
+}
+
+// --bench-integrate [count] [steps]: SIMD INTEGRATE against the scalar reference on the same bodies
+inline void BENCH_INTEGRATE(size_t count, int steps) {
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+	std::uniform_real_distribution<float> mass(0.1f, 10.0f);
+	BODY_STORE bodies;
+	for (size_t i = 0; i < count; ++i) {
+		BODY_HANDLE body = bodies.CREATE({ value(rng), value(rng), value(rng) }, mass(rng));
+		bodies.setVelocity(body, { value(rng), value(rng), value(rng) });
+		bodies.setForce(body, { value(rng), value(rng), value(rng) });
+		bodies.setCollision(body, i % 10 == 0);
+	}
+	BODY_STORE reference = bodies;
+
+	double simd = 0.0;
+	double scalar = 0.0;
+	for (int step = 0; step < steps; ++step) {
+		auto start = std::chrono::high_resolution_clock::now();
+		bodies.INTEGRATE(0.01f);
+		auto middle = std::chrono::high_resolution_clock::now();
+		reference.integrateScalar(0, reference.size(), 0.01f);
+		auto end = std::chrono::high_resolution_clock::now();
+		simd += std::chrono::duration<double, std::milli>(middle - start).count();
+		scalar += std::chrono::duration<double, std::milli>(end - middle).count();
+	}
+	float maxError = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		maxError = std::max(maxError, std::fabs(bodies.px[i] - reference.px[i]));
+		maxError = std::max(maxError, std::fabs(bodies.py[i] - reference.py[i]));
+		maxError = std::max(maxError, std::fabs(bodies.pz[i] - reference.pz[i]));
+	}
+#if defined(UBODY_AVX)
+	const char* kernel = "AVX";
+#elif defined(UBODY_SSE)
+	const char* kernel = "SSE";
+#else
+	const char* kernel = "scalar";
+#endif
+	printf("Integrate benchmark: %zu bodies, %d steps\n", count, steps);
+	printf("%-8s %10.4f ms/step\n", kernel, simd / steps);
+	printf("%-8s %10.4f ms/step\n", "scalar", scalar / steps);
+	printf("max position difference: %g\n", maxError);
+}
+
+// Box colliders stepped outside the editor the way STEP_PHYSICS steps the editor's scene, with the proxy
+// index as the contact cache key. A box without mass has no body and never moves.
+struct BENCH_WORLD {
+	BODY_STORE bodies;
+	SIMULATION_ISLANDS islands;
+	CONTACT_SOLVER solver;
+	std::unique_ptr<BROADPHASE> broadphase = createBroadphase(BROADPHASE_TYPE::SWEEP_AND_PRUNE);
+	NARROWPHASE narrowphase;
+	std::vector<BOX_COLLIDER> colliders;
+	std::vector<glm::mat3> orientations;
+	std::vector<BODY_HANDLE> handles;
+	std::vector<AABB> bounds;
+	NARROWPHASE_SHAPES shapes;
+	std::vector<BROADPHASE_PAIR> pairs;
+
+	void ADD(const glm::vec3& position, const glm::vec3& size, float mass, const glm::mat3& orientation = glm::mat3(1.0f)) {
+		colliders.emplace_back();
+		colliders.back().SET(position, size, orientation);
+		orientations.push_back(orientation);
+		handles.push_back(mass > 0.0f ? bodies.CREATE(position, mass) : BODY_HANDLE());
+		bounds.push_back(getColliderBounds(colliders.back()));
+	}
+	bool isAsleep(size_t proxy) const {
+		return !handles[proxy].isNull() && !bodies.isAwake(handles[proxy]);
+	}
+
+	void STEP(float dt) {
+		bodies.CLEAR_COLLISIONS();
+		broadphase->resting.resize(colliders.size());
+		shapes.CLEAR();
+		for (size_t i = 0; i < colliders.size(); ++i) {
+			bool asleep = isAsleep(i);
+			if (!asleep) {
+				colliders[i].collision = false;
+				bounds[i] = getColliderBounds(colliders[i]);
+			}
+			broadphase->resting[i] = asleep ? 1 : 0;
+			shapes.ADD(colliders[i], orientations[i]);
+		}
+		broadphase->COLLECT(bounds, pairs);
+		islands.BEGIN();
+		solver.BEGIN();
+		for (uint32_t hit : narrowphase.RUN_BATCHED(pairs, shapes)) {
+			const BROADPHASE_PAIR& pair = pairs[hit];
+			islands.CONTACT(bodies, handles[pair.a], handles[pair.b]);
+			solver.ADD(colliders[pair.a], colliders[pair.b], pair.a, pair.b, handles[pair.a], handles[pair.b], shapes[pair.a].axes, shapes[pair.b].axes);
+			for (uint32_t proxy : { pair.a, pair.b }) {
+				colliders[proxy].collision = true;
+				if (!handles[proxy].isNull()) {
+					bodies.setCollision(handles[proxy], true);
+				}
+			}
+		}
+		bodies.INTEGRATE_VELOCITIES(dt, solver.gravity);
+		solver.SOLVE_VELOCITIES(bodies);
+		bodies.INTEGRATE_POSITIONS(dt);
+		solver.SOLVE_POSITIONS(bodies);
+		for (size_t i = 0; i < colliders.size(); ++i) {
+			if (!handles[i].isNull() && bodies.isAwake(handles[i])) {
+				colliders[i].position = bodies.getPosition(handles[i]);
+			}
+		}
+		islands.UPDATE(bodies, dt);
+	}
+};
+
+// --bench-sleep [count] [steps]: the physics step over a scene where 90% of the bodies rest in stacked
+// columns and the rest fly above them, with sleeping off and on. Sleeping should barely change where
+// anything ends up: only the correction of overlaps below the sleep speed is cut short.
+inline void BENCH_SLEEP(size_t count, int steps) {
+	const float dt = 1.0f / 60.0f;
+	size_t resting = count - count / 10;
+	std::vector<glm::vec3> positions = makeBenchPositions(BENCH_DISTRIBUTION::STACKED, resting, 1234);
+	std::vector<glm::vec3> velocities(resting, glm::vec3(0.0f));
+	// A layer over the footprint of the stacks, so the sweep axis stays horizontal
+	glm::vec3 footprint(0.0f);
+	for (const glm::vec3& position : positions) {
+		footprint = glm::max(footprint, position);
+	}
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (size_t i = resting; i < count; ++i) {
+		positions.push_back({ unit(rng) * footprint.x, 30.0f + unit(rng) * 10.0f, unit(rng) * footprint.z });
+		velocities.push_back(glm::normalize(glm::vec3(unit(rng) - 0.5f, 0.0f, unit(rng) - 0.5f) + glm::vec3(0.01f)) * 1.5f);
+	}
+
+	auto run = [&](bool sleeping, std::vector<glm::vec3>& result, size_t& awake) {
+		BENCH_WORLD world;
+		world.islands.sleeping = sleeping;
+		for (size_t i = 0; i < count; ++i) {
+			world.ADD(positions[i], glm::vec3(1.0f), 1.0f);
+			world.bodies.setVelocity(world.handles.back(), velocities[i]);
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int step = 0; step < steps; ++step) {
+			world.STEP(dt);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		result.clear();
+		for (BODY_HANDLE handle : world.handles) {
+			result.push_back(world.bodies.getPosition(handle));
+		}
+		awake = world.bodies.getAwakeCount();
+		return std::chrono::duration<double, std::milli>(end - start).count() / std::max(steps, 1);
+	};
+
+	std::vector<glm::vec3> reference;
+	std::vector<glm::vec3> slept;
+	size_t awakeWithout = 0;
+	size_t awakeWith = 0;
+	double without = run(false, reference, awakeWithout);
+	double with = run(true, slept, awakeWith);
+	float maxError = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		maxError = std::max(maxError, glm::length(slept[i] - reference[i]));
+	}
+	printf("Sleep benchmark: %zu bodies (%zu resting), %d steps\n", count, resting, steps);
+	printf("%-10s %10.4f ms/step %8zu awake at the end\n", "awake", without, awakeWithout);
+	printf("%-10s %10.4f ms/step %8zu awake at the end\n", "sleeping", with, awakeWith);
+	printf("max position difference: %g\n", maxError);
+}
+
+// --bench-stacking [columns] [steps] [tilt]: columns of 10 unit boxes on a static floor under gravity, solved
+// with 4, 8 and 30 iterations, cold and warm started. Reports the solver time, the deepest penetration
+// left after the last step, how far any box moved from where it started and the fastest box at the end.
+// A tilt in degrees turns the whole scene about z, so every column leans on a ramp along its own up axis and
+// only contacts built from the oriented boxes keep it standing; friction holds it up to about 26 degrees.
+inline void BENCH_STACKING(size_t columns, int steps, float tilt = 0.0f) {
+	const float dt = 1.0f / 60.0f;
+	const int height = 10;
+	size_t row = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(std::max<size_t>(columns, 1)))));
+	float side = 2.0f * static_cast<float>(row);
+	glm::mat3 orientation = TRANSFORM::rotationMatrix(glm::vec3(0.0f, 0.0f, tilt));
+	printf("Stacking benchmark: %zu columns of %d boxes, %d steps, tilted %g degrees\n", columns, height, steps, tilt);
+	printf("%10s %6s %12s %12s %10s %10s\n", "iterations", "warm", "solver ms", "penetration", "drift", "speed");
+	for (int iterations : { 4, 8, 30 }) {
+		for (bool warm : { false, true }) {
+			BENCH_WORLD world;
+			world.islands.sleeping = false;
+			world.solver.gravity = { 0.0f, -9.81f, 0.0f };
+			world.solver.iterations = iterations;
+			world.solver.warmStarting = warm;
+			world.ADD(orientation * glm::vec3(side * 0.5f, -0.5f, side * 0.5f), { side + 2.0f, 1.0f, side + 2.0f }, 0.0f, orientation);
+			std::vector<glm::vec3> start;
+			for (size_t column = 0; column < columns; ++column) {
+				for (int level = 0; level < height; ++level) {
+					start.push_back(orientation * glm::vec3((column % row) * 2.0f + 1.0f, 0.5f + level, (column / row) * 2.0f + 1.0f));
+					world.ADD(start.back(), glm::vec3(1.0f), 1.0f, orientation);
+				}
+			}
+			double solver = 0.0;
+			for (int step = 0; step < steps; ++step) {
+				world.STEP(dt);
+				solver += world.solver.time;
+			}
+			float drift = 0.0f;
+			float speed = 0.0f;
+			for (size_t i = 0; i < start.size(); ++i) {
+				BODY_HANDLE body = world.handles[i + 1];
+				drift = std::max(drift, glm::length(world.bodies.getPosition(body) - start[i]));
+				speed = std::max(speed, glm::length(world.bodies.getVelocity(body)));
+			}
+			printf("%10d %6s %12.4f %12.4f %10.4f %10.4f\n", iterations, warm ? "yes" : "no", solver / std::max(steps, 1),
+				world.solver.maxPenetration, drift, speed);
+		}
+	}
+}
+
+// --bench-meshcache <file.fbx> [runs]: cold loads (FBX SDK import + cache write) against warm loads
+// from the mapped cache, checking both produce the same arrays
+inline void BENCH_MESH_CACHE(const std::string& filename, int runs) {
+	runs = std::max(runs, 1);
+	MESH_CACHE& cache = getMeshCache();
+	auto timeLoad = [&](std::shared_ptr<MESH>& result) {
+		auto start = std::chrono::high_resolution_clock::now();
+		FBX fbx;
+		result = fbx.LOAD_MESH(filename);
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	};
+
+	std::shared_ptr<MESH> cold;
+	std::shared_ptr<MESH> warm;
+	double coldTotal = 0.0;
+	double warmTotal = 0.0;
+	for (int run = 0; run < runs; ++run) {
+		cache.REMOVE(filename);
+		coldTotal += timeLoad(cold);
+	}
+	for (int run = 0; run < runs; ++run) {
+		warmTotal += timeLoad(warm);
+	}
+	bool match = cold->vertices == warm->vertices && cold->normals == warm->normals
+		&& cold->textures == warm->textures && cold->indices == warm->indices;
+
+	printf("Mesh cache benchmark: %s, %zu vertices, %zu triangles, %d runs\n", filename.c_str(),
+		cold->getVertexCount(), cold->getTriangleCount(), runs);
+	printf("%-6s %12.3f ms/load\n", "cold", coldTotal / runs);
+	printf("%-6s %12.3f ms/load %s\n", "warm", warmTotal / runs, match ? "" : "MISMATCH");
+	printf("speedup %.1fx, cache file %s\n", coldTotal / std::max(warmTotal, 1e-9), cache.getCachePath(filename).c_str());
+}
+
+// Model with the shared cube mesh that needs no GL context
+struct BENCH_MODEL : public MODEL {
+	void Init(const std::string&) final {
+		mesh = CUBE::getSharedMesh();
+		name = "Bench";
+	}
+};
+
+// --bench-picking [count] [rays]: SCENE_PICKER against testing every model, over randomly rotated and
+// scaled cubes, then again after moving 1% of them so the refit is part of the measured PICK
+inline void BENCH_PICKING(size_t count, int rays) {
+	rays = std::max(rays, 1);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+	std::vector<glm::vec3> positions = makeBenchPositions(BENCH_DISTRIBUTION::UNIFORM, count, 1234);
+	ENTITY_STORE entities;
+	for (const glm::vec3& position : positions) {
+		std::unique_ptr<BENCH_MODEL> model = std::make_unique<BENCH_MODEL>();
+		model->Init("");
+		model->setProperty_Position(position);
+		model->setProperty_RotationAxis({ angle(rng), angle(rng), angle(rng) });
+		model->setProperty_Scale({ scale(rng), scale(rng), scale(rng) });
+		entities.CREATE(std::move(model));
+	}
+	const std::vector<MODEL*>& models = entities.getModels();
+	float side = 2.0f * std::cbrt(static_cast<float>(count));
+	std::uniform_real_distribution<float> target(0.0f, side);
+	auto makeRay = [&](glm::vec3& origin, glm::vec3& direction) {
+		origin = glm::vec3(-side, side * 0.5f, -side);
+		direction = glm::normalize(glm::vec3(target(rng), target(rng), target(rng)) - origin);
+	};
+
+	SCENE_PICKER picker;
+	auto start = std::chrono::high_resolution_clock::now();
+	picker.UPDATE(models);
+	double build = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Brute force is the reference, on a few rays only
+	int checked = std::min(rays, 20);
+	int mismatches = 0;
+	double bruteTotal = 0.0;
+	for (int i = 0; i < checked; ++i) {
+		glm::vec3 origin, direction;
+		makeRay(origin, direction);
+		PICK_RESULT hit = picker.PICK(models, origin, direction);
+		auto bruteStart = std::chrono::high_resolution_clock::now();
+		RAY ray(origin, direction);
+		RAY_HIT nearest;
+		size_t nearestModel = SIZE_MAX;
+		for (size_t m = 0; m < models.size(); ++m) {
+			if (SCENE_PICKER::RAYCAST_MODEL(*models[m], ray, nearest)) {
+				nearestModel = m;
+			}
+		}
+		bruteTotal += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bruteStart).count();
+		if (hit.model != nearestModel || (hit.isHit() && std::fabs(hit.distance - nearest.distance) > 1e-3f)) {
+			++mismatches;
+		}
+	}
+
+	double pickTotal = 0.0;
+	size_t hits = 0;
+	size_t candidates = 0;
+	for (int i = 0; i < rays; ++i) {
+		glm::vec3 origin, direction;
+		makeRay(origin, direction);
+		hits += picker.PICK(models, origin, direction).isHit() ? 1 : 0;
+		pickTotal += picker.time;
+		candidates += picker.candidates;
+	}
+
+	std::uniform_real_distribution<float> jitter(-0.5f, 0.5f);
+	double movedTotal = 0.0;
+	for (int i = 0; i < rays; ++i) {
+		for (size_t m = 0; m < std::max<size_t>(count / 100 / rays, 1); ++m) {
+			MODEL& model = *models[rng() % models.size()];
+			model.setProperty_Position(model.getProperty_Position() + glm::vec3(jitter(rng), jitter(rng), jitter(rng)));
+		}
+		glm::vec3 origin, direction;
+		makeRay(origin, direction);
+		picker.PICK(models, origin, direction);
+		movedTotal += picker.time;
+	}
+
+	printf("Picking benchmark: %zu models, %d rays\n", count, rays);
+	printf("build %12.3f ms\n", build);
+	printf("pick  %12.4f ms/ray (%.1f meshes tested, %zu hits)\n", pickTotal / rays, static_cast<double>(candidates) / rays, hits);
+	printf("moved %12.4f ms/ray (1%% of models moved across the rays)\n", movedTotal / rays);
+	printf("brute %12.4f ms/ray, %d/%d mismatches\n", bruteTotal / checked, mismatches, checked);
+}
+
+// --bench-culling [count] [frames]: FRUSTUM_CULLER over randomly placed cubes seen from the middle of the
+// scene, checked against the scalar sphere and box tests per model
+inline void BENCH_CULLING(size_t count, int frames) {
+	frames = std::max(frames, 1);
+	std::vector<glm::vec3> positions = makeBenchPositions(BENCH_DISTRIBUTION::UNIFORM, count, 1234);
+	ENTITY_STORE entities;
+	for (const glm::vec3& position : positions) {
+		std::unique_ptr<BENCH_MODEL> model = std::make_unique<BENCH_MODEL>();
+		model->Init("");
+		model->setProperty_Position(position);
+		entities.CREATE(std::move(model));
+	}
+	const std::vector<MODEL*>& models = entities.getModels();
+	float side = 2.0f * std::cbrt(static_cast<float>(count));
+	CAMERA camera;
+	camera._fovy = 60.0f;
+	camera._eye = glm::vec3(side * 0.5f);
+	camera._front = glm::normalize(glm::vec3(1.0f, 0.0f, 0.5f));
+
+	FRUSTUM_CULLER culler;
+	double total = 0.0;
+	for (int frame = 0; frame < frames; ++frame) {
+		culler.CULL(models, camera);
+		total += culler.time;
+	}
+
+	FRUSTUM frustum = FRUSTUM::FROM_MATRIX(camera.getProjectionMatrix() * camera.getViewMatrix());
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t expected = 0;
+	size_t mismatches = 0;
+	size_t next = 0;
+	for (MODEL* model : models) {
+		if (!frustum.intersects(model->getWorldSphere()) || !frustum.intersects(model->getWorldBounds())) {
+			continue;
+		}
+		++expected;
+		if (next < culler.visible.size() && culler.visible[next] == model) {
+			++next;
+		}
+		else {
+			++mismatches;
+		}
+	}
+	double scalar = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	mismatches += culler.visible.size() - next;
+
+#if defined(UBODY_AVX)
+	const char* kernel = "AVX";
+#elif defined(UBODY_SSE)
+	const char* kernel = "SSE";
+#else
+	const char* kernel = "scalar";
+#endif
+	printf("Culling benchmark: %zu models, %d frames\n", count, frames);
+	printf("%-8s %10.4f ms/frame\n", kernel, total / frames);
+	printf("%-8s %10.4f ms/frame\n", "scalar", scalar);
+	printf("visible %zu, culled %zu, %zu mismatches against %zu expected\n", culler.visible.size(), culler.culled, mismatches, expected);
+}
+
+// --bench-scene [count] [runs]: saves and loads a scene of cubes with colliders and bodies through the binary
+// file and the text export, and checks that both give back the same records
+inline void BENCH_SCENE(size_t count, int runs) {
+	runs = std::max(runs, 1);
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> positions = makeBenchPositions(BENCH_DISTRIBUTION::UNIFORM, count, 1234);
+	ENTITY_STORE entities;
+	std::vector<LIGHT> lights(1);
+	for (size_t i = 0; i < count; ++i) {
+		std::unique_ptr<CUBE> cube = std::make_unique<CUBE>();
+		cube->Init("");
+		cube->setName("Cube " + std::to_string(i));
+		cube->setProperty_Position(positions[i]);
+		cube->setProperty_RotationAxis(glm::vec3(unit(rng), unit(rng), unit(rng)) * 360.0f);
+		cube->setColor({ unit(rng), unit(rng), unit(rng) });
+		ENTITY_HANDLE entity = entities.CREATE(std::move(cube));
+		entities.setCollider(entity, COLLIDER_TYPE::BOX);
+		getBodyStore().setVelocity(entities.setBody(entity), { unit(rng), unit(rng), unit(rng) });
+		entities.setGizmo(entity);
+	}
+	SCENE_DATA expected = SCENE_FILE::CAPTURE(entities, lights);
+	auto matches = [&]() {
+		SCENE_DATA loaded = SCENE_FILE::CAPTURE(entities, lights);
+		return loaded.models.size() == expected.models.size() && loaded.strings == expected.strings
+			&& std::memcmp(loaded.models.data(), expected.models.data(), expected.models.size() * sizeof(SCENE_MODEL)) == 0;
+	};
+	auto time = [](auto&& action) {
+		auto start = std::chrono::high_resolution_clock::now();
+		bool ok = action();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return ok ? ms : -1.0;
+	};
+
+	SCENE_FILE scene;
+	const std::string binaryPath = "bench.uscn";
+	const std::string textPath = "bench.uscn.txt";
+	double save = 0.0, load = 0.0, exportText = 0.0, importText = 0.0;
+	bool binaryMatch = true;
+	bool textMatch = true;
+	for (int run = 0; run < runs; ++run) {
+		save += time([&]() { return scene.SAVE(binaryPath, entities, lights); });
+		load += time([&]() { return scene.LOAD(binaryPath, entities, lights); });
+		binaryMatch = binaryMatch && matches();
+		exportText += time([&]() { return scene.EXPORT_TEXT(textPath, entities, lights); });
+		importText += time([&]() { return scene.IMPORT_TEXT(textPath, entities, lights); });
+		textMatch = textMatch && matches();
+	}
+	std::error_code error;
+	printf("Scene benchmark: %zu models, %d runs\n", count, runs);
+	printf("%-8s %10.3f ms save %10.3f ms load %8.1f KB %s\n", "binary", save / runs, load / runs,
+		std::filesystem::file_size(binaryPath, error) / 1024.0, binaryMatch ? "" : "MISMATCH");
+	printf("%-8s %10.3f ms save %10.3f ms load %8.1f KB %s\n", "text", exportText / runs, importText / runs,
+		std::filesystem::file_size(textPath, error) / 1024.0, textMatch ? "" : "MISMATCH");
+	std::filesystem::remove(binaryPath, error);
+	std::filesystem::remove(textPath, error);
+}
+
+#endif
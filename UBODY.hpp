@@ -0,0 +1,415 @@
+#ifndef __UBODY_HPP__
+#define __UBODY_HPP__
+#include "UPHYSIC.hpp"
+#include <cstdint>
+#include <new>
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#define UBODY_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UBODY_SSE 1
+#endif
+
+template<typename T, size_t ALIGNMENT = 32>
+struct ALIGNED_ALLOCATOR {
+	using value_type = T;
+	template<typename U>
+	struct rebind {
+		using other = ALIGNED_ALLOCATOR<U, ALIGNMENT>;
+	};
+
+	ALIGNED_ALLOCATOR() = default;
+	template<typename U>
+	ALIGNED_ALLOCATOR(const ALIGNED_ALLOCATOR<U, ALIGNMENT>&) {}
+
+	T* allocate(size_t n) {
+		return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+	}
+	void deallocate(T* p, size_t) {
+		::operator delete(p, std::align_val_t(ALIGNMENT));
+	}
+	template<typename U>
+	bool operator==(const ALIGNED_ALLOCATOR<U, ALIGNMENT>&) const {
+		return true;
+	}
+	template<typename U>
+	bool operator!=(const ALIGNED_ALLOCATOR<U, ALIGNMENT>&) const {
+		return false;
+	}
+};
+
+// Generational handle: stays valid while the body lives, and detects use after DESTROY
+struct BODY_HANDLE {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool isNull() const {
+		return index == UINT32_MAX;
+	}
+	bool operator==(const BODY_HANDLE& other) const {
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(const BODY_HANDLE& other) const {
+		return !(*this == other);
+	}
+};
+
+// Rigid bodies as structure of arrays. Live bodies are packed densely so the integration
+// kernel streams through contiguous, 32 byte aligned arrays; handles map to dense indices
+// through the slot table and DESTROY swap-removes.
+// Awake bodies come first: [0, getAwakeCount()) is all INTEGRATE touches. Sleeping bodies sit
+// behind them in islands that wake as a whole, on any setter or through WAKE.
+struct BODY_STORE {
+	template<typename T>
+	using ARRAY = std::vector<T, ALIGNED_ALLOCATOR<T>>;
+
+	ARRAY<float> px, py, pz;
+	ARRAY<float> vx, vy, vz;
+	ARRAY<float> fx, fy, fz;
+	ARRAY<float> invMass;
+	ARRAY<float> collision; // 1.0f while touching something, 0.0f otherwise
+	ARRAY<float> restTime; // seconds the body has been slower than the sleep threshold
+
+	size_t size() const {
+		return px.size();
+	}
+	size_t getAwakeCount() const {
+		return awakeCount;
+	}
+	size_t getIslandCount() const {
+		return islands.size() - freeIslands.size();
+	}
+
+	BODY_HANDLE CREATE(const glm::vec3& position, float mass) {
+		uint32_t slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back({ 0, 0, NO_ISLAND });
+		}
+		uint32_t dense = static_cast<uint32_t>(size());
+		slots[slot].dense = dense;
+		denseToSlot.push_back(slot);
+		px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+		vx.push_back(0.0f); vy.push_back(0.0f); vz.push_back(0.0f);
+		fx.push_back(0.0f); fy.push_back(0.0f); fz.push_back(0.0f);
+		invMass.push_back(mass > 0.0f ? 1.0f / mass : 0.0f);
+		collision.push_back(0.0f);
+		restTime.push_back(0.0f);
+		slots[slot].island = NO_ISLAND;
+		swapBodies(dense, static_cast<uint32_t>(awakeCount));
+		awakeCount += 1;
+		return { slot, slots[slot].generation };
+	}
+
+	// Wakes the body's island first, so whatever rested on the body falls
+	void DESTROY(BODY_HANDLE handle) {
+		if (!isValid(handle)) {
+			return;
+		}
+		WAKE(handle);
+		uint32_t dense = slots[handle.index].dense;
+		uint32_t lastAwake = static_cast<uint32_t>(awakeCount - 1);
+		uint32_t last = static_cast<uint32_t>(size() - 1);
+		if (dense != lastAwake) {
+			moveBody(lastAwake, dense);
+		}
+		if (lastAwake != last) {
+			moveBody(last, lastAwake);
+		}
+		awakeCount -= 1;
+		popBack();
+		slots[handle.index].generation += 1;
+		freeSlots.push_back(handle.index);
+	}
+
+	bool isValid(BODY_HANDLE handle) const {
+		return !handle.isNull() && handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+	}
+	uint32_t getDenseIndex(BODY_HANDLE handle) const {
+		return slots[handle.index].dense;
+	}
+	BODY_HANDLE getHandle(uint32_t dense) const {
+		uint32_t slot = denseToSlot[dense];
+		return { slot, slots[slot].generation };
+	}
+	bool isAwake(BODY_HANDLE handle) const {
+		return getDenseIndex(handle) < awakeCount;
+	}
+
+	glm::vec3 getPosition(BODY_HANDLE handle) const {
+		uint32_t i = getDenseIndex(handle);
+		return { px[i], py[i], pz[i] };
+	}
+	void setPosition(BODY_HANDLE handle, const glm::vec3& position) {
+		WAKE(handle);
+		uint32_t i = getDenseIndex(handle);
+		px[i] = position.x; py[i] = position.y; pz[i] = position.z;
+	}
+	glm::vec3 getVelocity(BODY_HANDLE handle) const {
+		uint32_t i = getDenseIndex(handle);
+		return { vx[i], vy[i], vz[i] };
+	}
+	void setVelocity(BODY_HANDLE handle, const glm::vec3& velocity) {
+		WAKE(handle);
+		uint32_t i = getDenseIndex(handle);
+		vx[i] = velocity.x; vy[i] = velocity.y; vz[i] = velocity.z;
+	}
+	glm::vec3 getForce(BODY_HANDLE handle) const {
+		uint32_t i = getDenseIndex(handle);
+		return { fx[i], fy[i], fz[i] };
+	}
+	void setForce(BODY_HANDLE handle, const glm::vec3& force) {
+		WAKE(handle);
+		uint32_t i = getDenseIndex(handle);
+		fx[i] = force.x; fy[i] = force.y; fz[i] = force.z;
+	}
+	// A mass of 0 makes the body static
+	float getMass(BODY_HANDLE handle) const {
+		float inverse = invMass[getDenseIndex(handle)];
+		return inverse > 0.0f ? 1.0f / inverse : 0.0f;
+	}
+	void setMass(BODY_HANDLE handle, float mass) {
+		WAKE(handle);
+		invMass[getDenseIndex(handle)] = mass > 0.0f ? 1.0f / mass : 0.0f;
+	}
+	void setCollision(BODY_HANDLE handle, bool value) {
+		collision[getDenseIndex(handle)] = value ? 1.0f : 0.0f;
+	}
+	// Positions indexed by handle slot, with the owning generation or UINT32_MAX for free slots
+	void CAPTURE(std::vector<glm::vec3>& positions, std::vector<uint32_t>& generations) const {
+		positions.resize(slots.size());
+		generations.assign(slots.size(), UINT32_MAX);
+		for (size_t i = 0; i < size(); ++i) {
+			uint32_t slot = denseToSlot[i];
+			positions[slot] = { px[i], py[i], pz[i] };
+			generations[slot] = slots[slot].generation;
+		}
+	}
+	// Sleeping bodies keep theirs: nothing tests their pairs with each other until they wake
+	void CLEAR_COLLISIONS() {
+		std::fill(collision.begin(), collision.begin() + awakeCount, 0.0f);
+	}
+
+	// Puts the bodies to sleep together, with zero velocity. WAKE on any one of them wakes them all.
+	void SLEEP(const std::vector<BODY_HANDLE>& members) {
+		uint32_t island;
+		if (!freeIslands.empty()) {
+			island = freeIslands.back();
+			freeIslands.pop_back();
+		}
+		else {
+			island = static_cast<uint32_t>(islands.size());
+			islands.emplace_back();
+		}
+		islands[island].clear();
+		for (BODY_HANDLE handle : members) {
+			if (!isValid(handle) || !isAwake(handle)) {
+				continue;
+			}
+			uint32_t dense = getDenseIndex(handle);
+			vx[dense] = 0.0f; vy[dense] = 0.0f; vz[dense] = 0.0f;
+			awakeCount -= 1;
+			swapBodies(dense, static_cast<uint32_t>(awakeCount));
+			slots[handle.index].island = island;
+			islands[island].push_back(handle);
+		}
+		if (islands[island].empty()) {
+			freeIslands.push_back(island);
+		}
+	}
+	void WAKE(BODY_HANDLE handle) {
+		if (!isValid(handle) || isAwake(handle)) {
+			return;
+		}
+		uint32_t island = slots[handle.index].island;
+		for (BODY_HANDLE member : islands[island]) {
+			// Members destroyed while asleep were woken with the rest, so every handle is still valid
+			uint32_t dense = getDenseIndex(member);
+			swapBodies(dense, static_cast<uint32_t>(awakeCount));
+			awakeCount += 1;
+			restTime[awakeCount - 1] = 0.0f;
+			slots[member.index].island = NO_ISLAND;
+		}
+		islands[island].clear();
+		freeIslands.push_back(island);
+	}
+	void WAKE_ALL() {
+		while (awakeCount < size()) {
+			WAKE(getHandle(static_cast<uint32_t>(awakeCount)));
+		}
+	}
+
+	// Semi-implicit Euler over the awake bodies: forces, and gravity for dynamic bodies, into velocities,
+	// then velocities into positions. A contact solver runs between the two halves.
+	void INTEGRATE(float dt, const glm::vec3& gravity = glm::vec3(0.0f)) {
+		INTEGRATE_VELOCITIES(dt, gravity);
+		INTEGRATE_POSITIONS(dt);
+	}
+	void INTEGRATE_VELOCITIES(float dt, const glm::vec3& gravity) {
+		size_t i = 0;
+#if defined(UBODY_AVX)
+		i = integrateVelocitiesAVX(awakeCount, dt, gravity);
+#elif defined(UBODY_SSE)
+		i = integrateVelocitiesSSE(awakeCount, dt, gravity);
+#endif
+		integrateVelocitiesScalar(i, awakeCount, dt, gravity);
+	}
+	void INTEGRATE_POSITIONS(float dt) {
+		size_t i = 0;
+#if defined(UBODY_AVX)
+		i = integratePositionsAVX(awakeCount, dt);
+#elif defined(UBODY_SSE)
+		i = integratePositionsSSE(awakeCount, dt);
+#endif
+		integratePositionsScalar(i, awakeCount, dt);
+	}
+
+	void integrateScalar(size_t begin, size_t end, float dt, const glm::vec3& gravity = glm::vec3(0.0f)) {
+		integrateVelocitiesScalar(begin, end, dt, gravity);
+		integratePositionsScalar(begin, end, dt);
+	}
+	void integrateVelocitiesScalar(size_t begin, size_t end, float dt, const glm::vec3& gravity) {
+		glm::vec3 step = gravity * dt;
+		for (size_t i = begin; i < end; ++i) {
+			float scale = invMass[i] * dt;
+			glm::vec3 fall = invMass[i] > 0.0f ? step : glm::vec3(0.0f);
+			vx[i] = (vx[i] + fx[i] * scale) + fall.x;
+			vy[i] = (vy[i] + fy[i] * scale) + fall.y;
+			vz[i] = (vz[i] + fz[i] * scale) + fall.z;
+		}
+	}
+	void integratePositionsScalar(size_t begin, size_t end, float dt) {
+		for (size_t i = begin; i < end; ++i) {
+			px[i] += vx[i] * dt;
+			py[i] += vy[i] * dt;
+			pz[i] += vz[i] * dt;
+		}
+	}
+
+private:
+	static constexpr uint32_t NO_ISLAND = UINT32_MAX;
+	struct SLOT {
+		uint32_t dense;
+		uint32_t generation;
+		uint32_t island; // sleeping island, NO_ISLAND while awake
+	};
+	std::vector<SLOT> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<uint32_t> denseToSlot;
+	size_t awakeCount = 0;
+	std::vector<std::vector<BODY_HANDLE>> islands;
+	std::vector<uint32_t> freeIslands;
+
+	void moveBody(uint32_t from, uint32_t to) {
+		px[to] = px[from]; py[to] = py[from]; pz[to] = pz[from];
+		vx[to] = vx[from]; vy[to] = vy[from]; vz[to] = vz[from];
+		fx[to] = fx[from]; fy[to] = fy[from]; fz[to] = fz[from];
+		invMass[to] = invMass[from];
+		collision[to] = collision[from];
+		restTime[to] = restTime[from];
+		denseToSlot[to] = denseToSlot[from];
+		slots[denseToSlot[to]].dense = to;
+	}
+
+	void swapBodies(uint32_t a, uint32_t b) {
+		if (a == b) {
+			return;
+		}
+		std::swap(px[a], px[b]); std::swap(py[a], py[b]); std::swap(pz[a], pz[b]);
+		std::swap(vx[a], vx[b]); std::swap(vy[a], vy[b]); std::swap(vz[a], vz[b]);
+		std::swap(fx[a], fx[b]); std::swap(fy[a], fy[b]); std::swap(fz[a], fz[b]);
+		std::swap(invMass[a], invMass[b]);
+		std::swap(collision[a], collision[b]);
+		std::swap(restTime[a], restTime[b]);
+		std::swap(denseToSlot[a], denseToSlot[b]);
+		slots[denseToSlot[a]].dense = a;
+		slots[denseToSlot[b]].dense = b;
+	}
+
+	void popBack() {
+		px.pop_back(); py.pop_back(); pz.pop_back();
+		vx.pop_back(); vy.pop_back(); vz.pop_back();
+		fx.pop_back(); fy.pop_back(); fz.pop_back();
+		invMass.pop_back();
+		collision.pop_back();
+		restTime.pop_back();
+		denseToSlot.pop_back();
+	}
+
+	// The kernels use the same operation order as the scalar passes (no FMA), so they match the scalar reference
+#if defined(UBODY_AVX)
+	size_t integrateVelocitiesAVX(size_t count, float dt, const glm::vec3& gravity) {
+		const __m256 vdt = _mm256_set1_ps(dt);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 step[3] = { _mm256_set1_ps(gravity.x * dt), _mm256_set1_ps(gravity.y * dt), _mm256_set1_ps(gravity.z * dt) };
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 inverse = _mm256_load_ps(&invMass[i]);
+			__m256 scale = _mm256_mul_ps(inverse, vdt);
+			__m256 dynamic = _mm256_cmp_ps(inverse, zero, _CMP_GT_OQ);
+			float* v[3] = { &vx[i], &vy[i], &vz[i] };
+			float* f[3] = { &fx[i], &fy[i], &fz[i] };
+			for (int axis = 0; axis < 3; ++axis) {
+				__m256 velocity = _mm256_add_ps(_mm256_load_ps(v[axis]), _mm256_mul_ps(_mm256_load_ps(f[axis]), scale));
+				_mm256_store_ps(v[axis], _mm256_add_ps(velocity, _mm256_and_ps(step[axis], dynamic)));
+			}
+		}
+		return i;
+	}
+	size_t integratePositionsAVX(size_t count, float dt) {
+		const __m256 vdt = _mm256_set1_ps(dt);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			float* v[3] = { &vx[i], &vy[i], &vz[i] };
+			float* p[3] = { &px[i], &py[i], &pz[i] };
+			for (int axis = 0; axis < 3; ++axis) {
+				_mm256_store_ps(p[axis], _mm256_add_ps(_mm256_load_ps(p[axis]), _mm256_mul_ps(_mm256_load_ps(v[axis]), vdt)));
+			}
+		}
+		return i;
+	}
+#elif defined(UBODY_SSE)
+	size_t integrateVelocitiesSSE(size_t count, float dt, const glm::vec3& gravity) {
+		const __m128 vdt = _mm_set1_ps(dt);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 step[3] = { _mm_set1_ps(gravity.x * dt), _mm_set1_ps(gravity.y * dt), _mm_set1_ps(gravity.z * dt) };
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 inverse = _mm_load_ps(&invMass[i]);
+			__m128 scale = _mm_mul_ps(inverse, vdt);
+			__m128 dynamic = _mm_cmpgt_ps(inverse, zero);
+			float* v[3] = { &vx[i], &vy[i], &vz[i] };
+			float* f[3] = { &fx[i], &fy[i], &fz[i] };
+			for (int axis = 0; axis < 3; ++axis) {
+				__m128 velocity = _mm_add_ps(_mm_load_ps(v[axis]), _mm_mul_ps(_mm_load_ps(f[axis]), scale));
+				_mm_store_ps(v[axis], _mm_add_ps(velocity, _mm_and_ps(step[axis], dynamic)));
+			}
+		}
+		return i;
+	}
+	size_t integratePositionsSSE(size_t count, float dt) {
+		const __m128 vdt = _mm_set1_ps(dt);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			float* v[3] = { &vx[i], &vy[i], &vz[i] };
+			float* p[3] = { &px[i], &py[i], &pz[i] };
+			for (int axis = 0; axis < 3; ++axis) {
+				_mm_store_ps(p[axis], _mm_add_ps(_mm_load_ps(p[axis]), _mm_mul_ps(_mm_load_ps(v[axis]), vdt)));
+			}
+		}
+		return i;
+	}
+#endif
+};
+
+inline BODY_STORE& getBodyStore() {
+	static BODY_STORE store;
+	return store;
+}
+
+#endif
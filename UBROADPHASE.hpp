@@ -0,0 +1,719 @@
+#ifndef __UBROADPHASE_HPP__
+#define __UBROADPHASE_HPP__
+#include "UPHYSIC.hpp"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+struct AABB {
+	glm::vec3 min = { 0.0f, 0.0f, 0.0f };
+	glm::vec3 max = { 0.0f, 0.0f, 0.0f };
+
+	bool overlaps(const AABB& other) const {
+		return min.x <= other.max.x && max.x >= other.min.x
+			&& min.y <= other.max.y && max.y >= other.min.y
+			&& min.z <= other.max.z && max.z >= other.min.z;
+	}
+	bool contains(const AABB& other) const {
+		return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z
+			&& max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+	}
+	AABB merge(const AABB& other) const {
+		return { glm::min(min, other.min), glm::max(max, other.max) };
+	}
+	AABB expand(float margin) const {
+		return { min - glm::vec3(margin), max + glm::vec3(margin) };
+	}
+	glm::vec3 getCenter() const {
+		return (min + max) * 0.5f;
+	}
+	float getSurfaceArea() const {
+		glm::vec3 d = max - min;
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+	bool isFinite() const {
+		return std::isfinite(min.x) && std::isfinite(min.y) && std::isfinite(min.z)
+			&& std::isfinite(max.x) && std::isfinite(max.y) && std::isfinite(max.z);
+	}
+};
+
+// Conservative world bounds of a collider: a cube around its center that encloses
+// any box or sphere of the collider's scale, whatever its orientation.
+inline AABB getColliderBounds(const COLLIDER& collider) {
+	glm::vec3 center = collider.position + collider.getRelativePosition();
+	float extent = glm::length(collider.getScale());
+	return { center - glm::vec3(extent), center + glm::vec3(extent) };
+}
+
+// Indices into the bounds array handed to the broadphase, always a < b
+struct BROADPHASE_PAIR {
+	uint32_t a;
+	uint32_t b;
+
+	bool operator<(const BROADPHASE_PAIR& other) const {
+		return a < other.a || (a == other.a && b < other.b);
+	}
+	bool operator==(const BROADPHASE_PAIR& other) const {
+		return a == other.a && b == other.b;
+	}
+};
+
+enum class BROADPHASE_TYPE {
+	BRUTE_FORCE,
+	SWEEP_AND_PRUNE,
+	AABB_TREE,
+	SPATIAL_HASH,
+	COUNT
+};
+
+inline const char* getBroadphaseName(BROADPHASE_TYPE type) {
+	static const char* names[] = { "Brute Force", "Sweep and Prune", "Dynamic AABB Tree", "Spatial Hash" };
+	return names[static_cast<size_t>(type)];
+}
+
+// Bounds are indexed by proxy. Backends that keep state between frames rebuild it
+// when the proxy count changes and update it incrementally otherwise.
+struct BROADPHASE {
+	size_t pairCount = 0;
+	double time = 0.0; // ms spent in the last COLLECT
+	// Per proxy, filled by the caller: nonzero when the proxy is asleep with the same bounds it had in the
+	// last COLLECT. Incremental backends skip refitting it, and pairs of two resting proxies are dropped.
+	std::vector<uint8_t> resting;
+
+	virtual ~BROADPHASE() = default;
+	virtual BROADPHASE_TYPE getType() const = 0;
+	virtual void UPDATE(const std::vector<AABB>& bounds) = 0;
+	virtual void QUERY(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) = 0;
+
+	// Overlapping pairs of the tight bounds, sorted so the result does not depend on the backend
+	void COLLECT(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) {
+		auto start = std::chrono::high_resolution_clock::now();
+		pairs.clear();
+		UPDATE(bounds);
+		QUERY(bounds, pairs);
+		if (!resting.empty()) {
+			pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [this](const BROADPHASE_PAIR& pair) {
+				return isResting(pair.a) && isResting(pair.b);
+			}), pairs.end());
+		}
+		std::sort(pairs.begin(), pairs.end());
+		auto end = std::chrono::high_resolution_clock::now();
+		pairCount = pairs.size();
+		time = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+	bool isResting(uint32_t proxy) const {
+		return proxy < resting.size() && resting[proxy];
+	}
+};
+
+// Reference O(n^2) implementation, what PHYSICS_PIPE used to do
+struct BRUTE_FORCE_BROADPHASE : public BROADPHASE {
+	BROADPHASE_TYPE getType() const override {
+		return BROADPHASE_TYPE::BRUTE_FORCE;
+	}
+	void UPDATE(const std::vector<AABB>&) override {
+	}
+	void QUERY(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) override {
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			for (uint32_t j = i + 1; j < bounds.size(); ++j) {
+				if (bounds[i].overlaps(bounds[j])) {
+					pairs.push_back({ i, j });
+				}
+			}
+		}
+	}
+};
+
+// Endpoints stay sorted between frames, so coherent motion only costs an insertion sort pass.
+// A NaN bound sorts as an infinite one, which keeps the order strict; the exact overlap test still rejects it.
+struct SWEEP_AND_PRUNE_BROADPHASE : public BROADPHASE {
+	struct ENDPOINT {
+		float value;
+		uint32_t proxy;
+		bool isMax;
+
+		// Min endpoints sort before max endpoints at the same value, so touching bounds overlap
+		bool operator<(const ENDPOINT& other) const {
+			return value < other.value || (value == other.value && !isMax && other.isMax);
+		}
+	};
+	int axis = 0;
+	std::vector<ENDPOINT> endpoints;
+	std::vector<uint32_t> active;
+	std::vector<uint32_t> activeResting; // kept apart so resting proxies are never tested against each other
+
+	BROADPHASE_TYPE getType() const override {
+		return BROADPHASE_TYPE::SWEEP_AND_PRUNE;
+	}
+
+	void UPDATE(const std::vector<AABB>& bounds) override {
+		if (endpoints.size() != bounds.size() * 2) {
+			REBUILD(bounds);
+			return;
+		}
+		for (ENDPOINT& endpoint : endpoints) {
+			if (isResting(endpoint.proxy)) {
+				continue;
+			}
+			endpoint.value = getEndpointValue(bounds[endpoint.proxy], endpoint.isMax);
+		}
+		for (size_t i = 1; i < endpoints.size(); ++i) {
+			ENDPOINT key = endpoints[i];
+			size_t j = i;
+			while (j > 0 && key < endpoints[j - 1]) {
+				endpoints[j] = endpoints[j - 1];
+				--j;
+			}
+			endpoints[j] = key;
+		}
+	}
+
+	// Sweeps along the axis with the largest spread of centers
+	void REBUILD(const std::vector<AABB>& bounds) {
+		glm::vec3 sum(0.0f), sumSquared(0.0f);
+		size_t finiteCount = 0;
+		for (const AABB& box : bounds) {
+			if (!box.isFinite()) {
+				continue;
+			}
+			glm::vec3 center = box.getCenter();
+			sum += center;
+			sumSquared += center * center;
+			++finiteCount;
+		}
+		float count = static_cast<float>(std::max<size_t>(finiteCount, 1));
+		glm::vec3 variance = sumSquared / count - (sum / count) * (sum / count);
+		axis = 0;
+		if (variance.y > variance[axis]) axis = 1;
+		if (variance.z > variance[axis]) axis = 2;
+
+		endpoints.clear();
+		endpoints.reserve(bounds.size() * 2);
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			endpoints.push_back({ getEndpointValue(bounds[i], false), i, false });
+			endpoints.push_back({ getEndpointValue(bounds[i], true), i, true });
+		}
+		std::sort(endpoints.begin(), endpoints.end());
+	}
+
+	float getEndpointValue(const AABB& box, bool isMax) const {
+		float value = isMax ? box.max[axis] : box.min[axis];
+		if (std::isnan(value)) {
+			return isMax ? INFINITY : -INFINITY;
+		}
+		return value;
+	}
+
+	void QUERY(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) override {
+		active.clear();
+		activeResting.clear();
+		auto test = [&](uint32_t proxy, const std::vector<uint32_t>& list) {
+			for (uint32_t other : list) {
+				if (bounds[other].overlaps(bounds[proxy])) {
+					pairs.push_back({ std::min(other, proxy), std::max(other, proxy) });
+				}
+			}
+		};
+		for (const ENDPOINT& endpoint : endpoints) {
+			bool isRestingProxy = isResting(endpoint.proxy);
+			std::vector<uint32_t>& list = isRestingProxy ? activeResting : active;
+			if (endpoint.isMax) {
+				// Inverted bounds reach their max first; the proxy then stays active, which only costs tests
+				auto it = std::find(list.begin(), list.end(), endpoint.proxy);
+				if (it != list.end()) {
+					*it = list.back();
+					list.pop_back();
+				}
+				continue;
+			}
+			test(endpoint.proxy, active);
+			if (!isRestingProxy) {
+				test(endpoint.proxy, activeResting);
+			}
+			list.push_back(endpoint.proxy);
+		}
+	}
+};
+
+// Leaves store bounds fattened by margin and are only reinserted when the tight bounds escape them.
+// Proxies with non-finite bounds would poison every box above them, so they stay out of the tree and are
+// tested against every proxy instead; RAYCAST never visits them.
+struct AABB_TREE_BROADPHASE : public BROADPHASE {
+	struct NODE {
+		AABB box;
+		int parent = -1;
+		int child1 = -1;
+		int child2 = -1;
+		int height = 0;
+		uint32_t proxy = 0;
+
+		bool isLeaf() const {
+			return child1 == -1;
+		}
+	};
+	float margin = 0.1f;
+	int root = -1;
+	int freeList = -1;
+	std::vector<NODE> nodes;
+	std::vector<int> leaves;       // per proxy, -1 when it is unbounded
+	std::vector<uint32_t> unbounded; // sorted
+	std::vector<int> stack;
+
+	BROADPHASE_TYPE getType() const override {
+		return BROADPHASE_TYPE::AABB_TREE;
+	}
+
+	void UPDATE(const std::vector<AABB>& bounds) override {
+		if (leaves.size() != bounds.size()) {
+			REBUILD(bounds);
+			return;
+		}
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			if (!isResting(i)) {
+				UPDATE_PROXY(i, bounds[i]);
+			}
+		}
+	}
+
+	// Appends a proxy with the next index, without rebuilding the others
+	uint32_t ADD_PROXY(const AABB& box) {
+		uint32_t proxy = static_cast<uint32_t>(leaves.size());
+		leaves.push_back(-1);
+		if (box.isFinite()) {
+			insertProxy(proxy, box);
+		}
+		else {
+			unbounded.push_back(proxy);
+		}
+		return proxy;
+	}
+
+	// Refits one proxy; only reinserted once it leaves its fat box
+	void UPDATE_PROXY(uint32_t proxy, const AABB& box) {
+		int leaf = leaves[proxy];
+		bool finite = box.isFinite();
+		if (leaf == -1) {
+			if (finite) {
+				unbounded.erase(std::lower_bound(unbounded.begin(), unbounded.end(), proxy));
+				insertProxy(proxy, box);
+			}
+			return;
+		}
+		if (finite && nodes[leaf].box.contains(box)) {
+			return;
+		}
+		removeLeaf(leaf);
+		if (!finite) {
+			freeNode(leaf);
+			leaves[proxy] = -1;
+			unbounded.insert(std::lower_bound(unbounded.begin(), unbounded.end(), proxy), proxy);
+			return;
+		}
+		nodes[leaf].box = box.expand(margin);
+		insertLeaf(leaf);
+	}
+
+	void REBUILD(const std::vector<AABB>& bounds) {
+		nodes.clear();
+		leaves.assign(bounds.size(), -1);
+		unbounded.clear();
+		root = -1;
+		freeList = -1;
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			if (bounds[i].isFinite()) {
+				insertProxy(i, bounds[i]);
+			}
+			else {
+				unbounded.push_back(i);
+			}
+		}
+	}
+
+	void QUERY(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) override {
+		for (size_t k = 0; k < unbounded.size(); ++k) {
+			uint32_t a = unbounded[k];
+			for (uint32_t b = 0; b < bounds.size(); ++b) {
+				// Two unbounded proxies meet once, from the first of them
+				bool earlierUnbounded = std::binary_search(unbounded.begin(), unbounded.begin() + k, b);
+				if (b != a && !earlierUnbounded && bounds[a].overlaps(bounds[b])) {
+					pairs.push_back({ std::min(a, b), std::max(a, b) });
+				}
+			}
+		}
+		if (root == -1) {
+			return;
+		}
+		// Only awake proxies query: they report awake partners after them and every resting partner
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			if (isResting(i) || leaves[i] == -1) {
+				continue;
+			}
+			stack.clear();
+			stack.push_back(root);
+			while (!stack.empty()) {
+				const NODE& node = nodes[stack.back()];
+				stack.pop_back();
+				if (!node.box.overlaps(bounds[i])) {
+					continue;
+				}
+				if (!node.isLeaf()) {
+					stack.push_back(node.child1);
+					stack.push_back(node.child2);
+				}
+				else if ((node.proxy > i || isResting(node.proxy)) && bounds[node.proxy].overlaps(bounds[i])) {
+					pairs.push_back({ std::min(i, node.proxy), std::max(i, node.proxy) });
+				}
+			}
+		}
+	}
+
+	// Nearest-first ray traversal. entry(box, maxDistance) gives the distance at which the ray enters box,
+	// or FLT_MAX when it misses within maxDistance; visit(proxy, maxDistance) tests a leaf and returns the
+	// new maxDistance, so subtrees behind the closest hit so far are skipped.
+	template<typename ENTRY, typename VISIT>
+	void RAYCAST(float maxDistance, ENTRY entry, VISIT visit) const {
+		if (root == -1) {
+			return;
+		}
+		std::vector<std::pair<int, float>> rayStack;
+		rayStack.reserve(64);
+		float rootDistance = entry(nodes[root].box, maxDistance);
+		if (rootDistance != FLT_MAX) {
+			rayStack.push_back({ root, rootDistance });
+		}
+		while (!rayStack.empty()) {
+			auto [index, distance] = rayStack.back();
+			rayStack.pop_back();
+			if (distance > maxDistance) {
+				continue;
+			}
+			const NODE& node = nodes[index];
+			if (node.isLeaf()) {
+				maxDistance = visit(node.proxy, maxDistance);
+				continue;
+			}
+			float distance1 = entry(nodes[node.child1].box, maxDistance);
+			float distance2 = entry(nodes[node.child2].box, maxDistance);
+			int first = node.child1;
+			int second = node.child2;
+			if (distance1 > distance2) {
+				std::swap(first, second);
+				std::swap(distance1, distance2);
+			}
+			if (distance2 != FLT_MAX) rayStack.push_back({ second, distance2 });
+			if (distance1 != FLT_MAX) rayStack.push_back({ first, distance1 });
+		}
+	}
+
+private:
+	void insertProxy(uint32_t proxy, const AABB& box) {
+		int leaf = allocateNode();
+		nodes[leaf].box = box.expand(margin);
+		nodes[leaf].proxy = proxy;
+		insertLeaf(leaf);
+		leaves[proxy] = leaf;
+	}
+
+	int allocateNode() {
+		if (freeList == -1) {
+			nodes.emplace_back();
+			return static_cast<int>(nodes.size() - 1);
+		}
+		int id = freeList;
+		freeList = nodes[id].parent;
+		nodes[id] = NODE();
+		return id;
+	}
+
+	void freeNode(int id) {
+		nodes[id].parent = freeList;
+		nodes[id].height = -1;
+		freeList = id;
+	}
+
+	// Descends towards the sibling with the lowest surface area cost
+	void insertLeaf(int leaf) {
+		if (root == -1) {
+			root = leaf;
+			nodes[root].parent = -1;
+			return;
+		}
+		AABB leafBox = nodes[leaf].box;
+		int index = root;
+		while (!nodes[index].isLeaf()) {
+			const NODE& node = nodes[index];
+			float area = node.box.getSurfaceArea();
+			float combinedArea = node.box.merge(leafBox).getSurfaceArea();
+			float cost = 2.0f * combinedArea;
+			float inheritance = 2.0f * (combinedArea - area);
+
+			auto childCost = [&](int child) {
+				float merged = leafBox.merge(nodes[child].box).getSurfaceArea();
+				if (nodes[child].isLeaf()) {
+					return merged + inheritance;
+				}
+				return merged - nodes[child].box.getSurfaceArea() + inheritance;
+			};
+			float cost1 = childCost(node.child1);
+			float cost2 = childCost(node.child2);
+			if (cost < cost1 && cost < cost2) {
+				break;
+			}
+			index = cost1 < cost2 ? node.child1 : node.child2;
+		}
+
+		int sibling = index;
+		int oldParent = nodes[sibling].parent;
+		int newParent = allocateNode();
+		nodes[newParent].parent = oldParent;
+		nodes[newParent].box = leafBox.merge(nodes[sibling].box);
+		nodes[newParent].height = nodes[sibling].height + 1;
+		nodes[newParent].child1 = sibling;
+		nodes[newParent].child2 = leaf;
+		nodes[sibling].parent = newParent;
+		nodes[leaf].parent = newParent;
+		if (oldParent != -1) {
+			if (nodes[oldParent].child1 == sibling) {
+				nodes[oldParent].child1 = newParent;
+			}
+			else {
+				nodes[oldParent].child2 = newParent;
+			}
+		}
+		else {
+			root = newParent;
+		}
+		refit(nodes[leaf].parent);
+	}
+
+	void removeLeaf(int leaf) {
+		if (leaf == root) {
+			root = -1;
+			return;
+		}
+		int parent = nodes[leaf].parent;
+		int grandParent = nodes[parent].parent;
+		int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+		if (grandParent != -1) {
+			if (nodes[grandParent].child1 == parent) {
+				nodes[grandParent].child1 = sibling;
+			}
+			else {
+				nodes[grandParent].child2 = sibling;
+			}
+			nodes[sibling].parent = grandParent;
+			freeNode(parent);
+			refit(grandParent);
+		}
+		else {
+			root = sibling;
+			nodes[sibling].parent = -1;
+			freeNode(parent);
+		}
+	}
+
+	void refit(int index) {
+		while (index != -1) {
+			index = balance(index);
+			NODE& node = nodes[index];
+			node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+			node.box = nodes[node.child1].box.merge(nodes[node.child2].box);
+			index = node.parent;
+		}
+	}
+
+	void replaceChild(int parent, int oldChild, int newChild) {
+		if (parent == -1) {
+			root = newChild;
+		}
+		else if (nodes[parent].child1 == oldChild) {
+			nodes[parent].child1 = newChild;
+		}
+		else {
+			nodes[parent].child2 = newChild;
+		}
+	}
+
+	// Rotates the taller grandchild up when the children heights differ by more than one
+	int balance(int iA) {
+		NODE& A = nodes[iA];
+		if (A.isLeaf() || A.height < 2) {
+			return iA;
+		}
+		int iB = A.child1;
+		int iC = A.child2;
+		NODE& B = nodes[iB];
+		NODE& C = nodes[iC];
+		int difference = C.height - B.height;
+
+		if (difference > 1) {
+			int iF = C.child1;
+			int iG = C.child2;
+			NODE& F = nodes[iF];
+			NODE& G = nodes[iG];
+			C.child1 = iA;
+			C.parent = A.parent;
+			A.parent = iC;
+			replaceChild(C.parent, iA, iC);
+			if (F.height > G.height) {
+				C.child2 = iF;
+				A.child2 = iG;
+				G.parent = iA;
+				A.box = B.box.merge(G.box);
+				C.box = A.box.merge(F.box);
+				A.height = 1 + std::max(B.height, G.height);
+				C.height = 1 + std::max(A.height, F.height);
+			}
+			else {
+				C.child2 = iG;
+				A.child2 = iF;
+				F.parent = iA;
+				A.box = B.box.merge(F.box);
+				C.box = A.box.merge(G.box);
+				A.height = 1 + std::max(B.height, F.height);
+				C.height = 1 + std::max(A.height, G.height);
+			}
+			return iC;
+		}
+		if (difference < -1) {
+			int iD = B.child1;
+			int iE = B.child2;
+			NODE& D = nodes[iD];
+			NODE& E = nodes[iE];
+			B.child1 = iA;
+			B.parent = A.parent;
+			A.parent = iB;
+			replaceChild(B.parent, iA, iB);
+			if (D.height > E.height) {
+				B.child2 = iD;
+				A.child1 = iE;
+				E.parent = iA;
+				A.box = C.box.merge(E.box);
+				B.box = A.box.merge(D.box);
+				A.height = 1 + std::max(C.height, E.height);
+				B.height = 1 + std::max(A.height, D.height);
+			}
+			else {
+				B.child2 = iE;
+				A.child1 = iD;
+				D.parent = iA;
+				A.box = C.box.merge(D.box);
+				B.box = A.box.merge(E.box);
+				A.height = 1 + std::max(C.height, D.height);
+				B.height = 1 + std::max(A.height, E.height);
+			}
+			return iB;
+		}
+		return iA;
+	}
+};
+
+// Uniform grid rebuilt every frame; proxies are binned into every cell their bounds touch
+struct SPATIAL_HASH_BROADPHASE : public BROADPHASE {
+	struct CELL_ENTRY {
+		uint64_t cell;
+		uint32_t proxy;
+
+		bool operator<(const CELL_ENTRY& other) const {
+			return cell < other.cell || (cell == other.cell && proxy < other.proxy);
+		}
+	};
+	float cellSize = 2.0f;
+	size_t maxCellsPerProxy = 64; // a proxy covering more cells, such as a floor, is tested against every proxy instead
+	std::vector<CELL_ENTRY> entries;
+	std::vector<uint32_t> oversized;
+
+	BROADPHASE_TYPE getType() const override {
+		return BROADPHASE_TYPE::SPATIAL_HASH;
+	}
+
+	// 21 bits per axis, exact for cell coordinates within +-2^20; UPDATE clamps to that range
+	static constexpr float CELL_LIMIT = static_cast<float>(1 << 20);
+	static uint64_t packCell(int x, int y, int z) {
+		const int64_t bias = 1 << 20;
+		const uint64_t mask = (1u << 21) - 1;
+		return ((static_cast<uint64_t>(x + bias) & mask) << 42)
+			| ((static_cast<uint64_t>(y + bias) & mask) << 21)
+			| (static_cast<uint64_t>(z + bias) & mask);
+	}
+
+	void UPDATE(const std::vector<AABB>& bounds) override {
+		entries.clear();
+		oversized.clear();
+		float inverseCell = 1.0f / cellSize;
+		for (uint32_t i = 0; i < bounds.size(); ++i) {
+			glm::vec3 lo = glm::floor(bounds[i].min * inverseCell);
+			glm::vec3 hi = glm::floor(bounds[i].max * inverseCell);
+			bool finite = std::isfinite(lo.x) && std::isfinite(lo.y) && std::isfinite(lo.z)
+				&& std::isfinite(hi.x) && std::isfinite(hi.y) && std::isfinite(hi.z);
+			if (finite) {
+				lo = glm::clamp(lo, glm::vec3(-CELL_LIMIT), glm::vec3(CELL_LIMIT - 1.0f));
+				hi = glm::clamp(hi, glm::vec3(-CELL_LIMIT), glm::vec3(CELL_LIMIT - 1.0f));
+			}
+			// Inverted bounds cover no cell but can still overlap a proxy spanning them
+			glm::vec3 span = hi - lo + glm::vec3(1.0f);
+			bool inverted = span.x < 1.0f || span.y < 1.0f || span.z < 1.0f;
+			if (!finite || inverted || static_cast<double>(span.x) * span.y * span.z > static_cast<double>(maxCellsPerProxy)) {
+				oversized.push_back(i);
+				continue;
+			}
+			for (int x = static_cast<int>(lo.x); x <= static_cast<int>(hi.x); ++x) {
+				for (int y = static_cast<int>(lo.y); y <= static_cast<int>(hi.y); ++y) {
+					for (int z = static_cast<int>(lo.z); z <= static_cast<int>(hi.z); ++z) {
+						entries.push_back({ packCell(x, y, z), i });
+					}
+				}
+			}
+		}
+		std::sort(entries.begin(), entries.end());
+	}
+
+	void QUERY(const std::vector<AABB>& bounds, std::vector<BROADPHASE_PAIR>& pairs) override {
+		size_t begin = 0;
+		while (begin < entries.size()) {
+			size_t end = begin + 1;
+			while (end < entries.size() && entries[end].cell == entries[begin].cell) {
+				++end;
+			}
+			for (size_t i = begin; i < end; ++i) {
+				for (size_t j = i + 1; j < end; ++j) {
+					uint32_t a = entries[i].proxy;
+					uint32_t b = entries[j].proxy;
+					if (bounds[a].overlaps(bounds[b])) {
+						pairs.push_back({ a, b });
+					}
+				}
+			}
+			begin = end;
+		}
+		for (size_t k = 0; k < oversized.size(); ++k) {
+			uint32_t a = oversized[k];
+			for (uint32_t b = 0; b < bounds.size(); ++b) {
+				// Two oversized proxies meet once, from the first of them
+				bool earlierOversized = std::binary_search(oversized.begin(), oversized.begin() + k, b);
+				if (b != a && !earlierOversized && bounds[a].overlaps(bounds[b])) {
+					pairs.push_back({ std::min(a, b), std::max(a, b) });
+				}
+			}
+		}
+		// Proxies sharing several cells are reported once per cell
+		std::sort(pairs.begin(), pairs.end());
+		pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+	}
+};
+
+inline std::unique_ptr<BROADPHASE> createBroadphase(BROADPHASE_TYPE type) {
+	switch (type) {
+	case BROADPHASE_TYPE::SWEEP_AND_PRUNE:
+		return std::make_unique<SWEEP_AND_PRUNE_BROADPHASE>();
+	case BROADPHASE_TYPE::AABB_TREE:
+		return std::make_unique<AABB_TREE_BROADPHASE>();
+	case BROADPHASE_TYPE::SPATIAL_HASH:
+		return std::make_unique<SPATIAL_HASH_BROADPHASE>();
+	default:
+		return std::make_unique<BRUTE_FORCE_BROADPHASE>();
+	}
+}
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef __UBVH_HPP__
+#define __UBVH_HPP__
+#include "UBROADPHASE.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+// Ray for picking. invDirection is precomputed for the slab tests; direction does not need to be unit length,
+// distances are in units of it.
+struct RAY {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 invDirection;
+
+	RAY(const glm::vec3& origin, const glm::vec3& direction)
+		: origin(origin), direction(direction), invDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z) {}
+
+	// Entry distance into box, or FLT_MAX when the ray misses it within [0, maxDistance]
+	float intersect(const AABB& box, float maxDistance) const {
+		glm::vec3 t1 = (box.min - origin) * invDirection;
+		glm::vec3 t2 = (box.max - origin) * invDirection;
+		float tmin = std::max(std::max(std::min(t1.x, t2.x), std::min(t1.y, t2.y)), std::max(std::min(t1.z, t2.z), 0.0f));
+		float tmax = std::min(std::min(std::max(t1.x, t2.x), std::max(t1.y, t2.y)), std::min(std::max(t1.z, t2.z), maxDistance));
+		return tmin <= tmax ? tmin : FLT_MAX;
+	}
+};
+
+struct RAY_HIT {
+	float distance = FLT_MAX;
+	uint32_t triangle = UINT32_MAX;
+	glm::vec3 barycentric = { 0.0f, 0.0f, 0.0f }; // weights of the triangle's 3 corners
+
+	bool isHit() const {
+		return triangle != UINT32_MAX;
+	}
+};
+
+// Moller-Trumbore, two sided. Writes hit when closer than hit.distance.
+inline bool intersectTriangle(const RAY& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, uint32_t triangle, RAY_HIT& hit) {
+	glm::vec3 edge1 = b - a;
+	glm::vec3 edge2 = c - a;
+	glm::vec3 p = glm::cross(ray.direction, edge2);
+	float determinant = glm::dot(edge1, p);
+	if (std::fabs(determinant) < 1e-12f) {
+		return false;
+	}
+	float inverse = 1.0f / determinant;
+	glm::vec3 s = ray.origin - a;
+	float u = glm::dot(s, p) * inverse;
+	if (u < 0.0f || u > 1.0f) {
+		return false;
+	}
+	glm::vec3 q = glm::cross(s, edge1);
+	float v = glm::dot(ray.direction, q) * inverse;
+	if (v < 0.0f || u + v > 1.0f) {
+		return false;
+	}
+	float t = glm::dot(edge2, q) * inverse;
+	if (t < 0.0f || t >= hit.distance) {
+		return false;
+	}
+	hit.distance = t;
+	hit.triangle = triangle;
+	hit.barycentric = { 1.0f - u - v, u, v };
+	return true;
+}
+
+// Static BVH over the triangles of one mesh, in mesh space. Built top down with binned SAH;
+// nodes are stored depth first, so a node's left child directly follows it.
+struct TRIANGLE_BVH {
+	struct NODE {
+		AABB box;
+		uint32_t start = 0; // first entry of triangles for a leaf, right child for an inner node
+		uint32_t count = 0; // 0 for inner nodes
+	};
+	std::vector<NODE> nodes;
+	std::vector<uint32_t> triangles; // triangle ids, grouped by leaf
+	std::vector<glm::vec3> corners;  // 3 per triangle id
+	size_t maxLeafSize = 4;
+
+	bool isEmpty() const {
+		return nodes.empty();
+	}
+	AABB getBounds() const {
+		return nodes.empty() ? AABB() : nodes[0].box;
+	}
+
+	// vertices as xyz floats; without indices every 3 vertices form a triangle
+	void BUILD(const std::vector<float>& vertices, const std::vector<uint32_t>& indices) {
+		nodes.clear();
+		triangles.clear();
+		corners.clear();
+		size_t cornerCount = indices.empty() ? vertices.size() / 3 : indices.size();
+		corners.reserve(cornerCount);
+		for (size_t i = 0; i < cornerCount; ++i) {
+			size_t v = indices.empty() ? i : indices[i];
+			corners.emplace_back(vertices[v * 3], vertices[v * 3 + 1], vertices[v * 3 + 2]);
+		}
+		uint32_t count = static_cast<uint32_t>(corners.size() / 3);
+		if (count == 0) {
+			return;
+		}
+		std::vector<AABB> boxes(count);
+		std::vector<glm::vec3> centroids(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			const glm::vec3* c = &corners[i * 3];
+			boxes[i] = { glm::min(glm::min(c[0], c[1]), c[2]), glm::max(glm::max(c[0], c[1]), c[2]) };
+			centroids[i] = boxes[i].getCenter();
+			triangles.push_back(i);
+		}
+		nodes.reserve(count * 2);
+		build(0, count, boxes, centroids);
+	}
+
+	bool RAYCAST(const RAY& ray, RAY_HIT& hit) const {
+		if (nodes.empty()) {
+			return false;
+		}
+		bool found = false;
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(0);
+		while (!stack.empty()) {
+			const NODE& node = nodes[stack.back()];
+			stack.pop_back();
+			if (ray.intersect(node.box, hit.distance) == FLT_MAX) {
+				continue;
+			}
+			if (node.count > 0) {
+				for (uint32_t i = node.start; i < node.start + node.count; ++i) {
+					uint32_t triangle = triangles[i];
+					found |= intersectTriangle(ray, corners[triangle * 3], corners[triangle * 3 + 1], corners[triangle * 3 + 2], triangle, hit);
+				}
+				continue;
+			}
+			// Visit the nearer child first so the farther one is usually culled by hit.distance
+			uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1;
+			uint32_t right = node.start;
+			float leftDistance = ray.intersect(nodes[left].box, hit.distance);
+			float rightDistance = ray.intersect(nodes[right].box, hit.distance);
+			if (leftDistance > rightDistance) {
+				std::swap(left, right);
+				std::swap(leftDistance, rightDistance);
+			}
+			if (rightDistance != FLT_MAX) stack.push_back(right);
+			if (leftDistance != FLT_MAX) stack.push_back(left);
+		}
+		return found;
+	}
+
+private:
+	static constexpr int BINS = 12;
+
+	uint32_t build(uint32_t begin, uint32_t end, const std::vector<AABB>& boxes, const std::vector<glm::vec3>& centroids) {
+		uint32_t index = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+		AABB box = boxes[triangles[begin]];
+		AABB centroidBox = { centroids[triangles[begin]], centroids[triangles[begin]] };
+		for (uint32_t i = begin + 1; i < end; ++i) {
+			box = box.merge(boxes[triangles[i]]);
+			centroidBox = centroidBox.merge({ centroids[triangles[i]], centroids[triangles[i]] });
+		}
+		nodes[index].box = box;
+
+		uint32_t count = end - begin;
+		uint32_t middle = count > maxLeafSize ? split(begin, end, box, centroidBox, boxes, centroids) : begin;
+		if (middle == begin || middle == end) {
+			nodes[index].start = begin;
+			nodes[index].count = count;
+			return index;
+		}
+		build(begin, middle, boxes, centroids);
+		nodes[index].start = build(middle, end, boxes, centroids);
+		return index;
+	}
+
+	// Best binned SAH plane over all three axes; returns begin when staying a leaf is cheaper
+	uint32_t split(uint32_t begin, uint32_t end, const AABB& box, const AABB& centroidBox,
+		const std::vector<AABB>& boxes, const std::vector<glm::vec3>& centroids) {
+		float bestCost = static_cast<float>(end - begin) * box.getSurfaceArea();
+		int bestAxis = -1;
+		int bestBin = 0;
+		glm::vec3 extent = centroidBox.max - centroidBox.min;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			AABB binBoxes[BINS];
+			uint32_t binCounts[BINS] = {};
+			float scale = BINS / extent[axis];
+			for (uint32_t i = begin; i < end; ++i) {
+				uint32_t triangle = triangles[i];
+				int bin = std::min(BINS - 1, static_cast<int>((centroids[triangle][axis] - centroidBox.min[axis]) * scale));
+				binBoxes[bin] = binCounts[bin]++ ? binBoxes[bin].merge(boxes[triangle]) : boxes[triangle];
+			}
+			// Sweep from the right to get the cost of every plane between bins
+			float rightArea[BINS];
+			uint32_t rightCount[BINS];
+			AABB accumulated;
+			uint32_t total = 0;
+			for (int bin = BINS - 1; bin > 0; --bin) {
+				if (binCounts[bin]) {
+					accumulated = total ? accumulated.merge(binBoxes[bin]) : binBoxes[bin];
+					total += binCounts[bin];
+				}
+				rightArea[bin] = total ? accumulated.getSurfaceArea() : 0.0f;
+				rightCount[bin] = total;
+			}
+			total = 0;
+			for (int bin = 0; bin < BINS - 1; ++bin) {
+				if (binCounts[bin]) {
+					accumulated = total ? accumulated.merge(binBoxes[bin]) : binBoxes[bin];
+					total += binCounts[bin];
+				}
+				if (total == 0 || rightCount[bin + 1] == 0) {
+					continue;
+				}
+				float cost = total * accumulated.getSurfaceArea() + rightCount[bin + 1] * rightArea[bin + 1];
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+		if (bestAxis == -1) {
+			return begin;
+		}
+		float scale = BINS / extent[bestAxis];
+		auto middle = std::partition(triangles.begin() + begin, triangles.begin() + end, [&](uint32_t triangle) {
+			int bin = std::min(BINS - 1, static_cast<int>((centroids[triangle][bestAxis] - centroidBox.min[bestAxis]) * scale));
+			return bin <= bestBin;
+		});
+		return static_cast<uint32_t>(middle - triangles.begin());
+	}
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef __UCULL_HPP__
+#define __UCULL_HPP__
+#include "UGL.hpp"
+
+// Six planes (xyz normal pointing inside, w distance) of a view-projection matrix, Gribb/Hartmann
+struct FRUSTUM {
+	glm::vec4 planes[6];
+
+	static FRUSTUM FROM_MATRIX(const glm::mat4& viewProjection) {
+		glm::vec4 row[4];
+		for (int i = 0; i < 4; ++i) {
+			row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		FRUSTUM frustum;
+		frustum.planes[0] = row[3] + row[0]; // left
+		frustum.planes[1] = row[3] - row[0]; // right
+		frustum.planes[2] = row[3] + row[1]; // bottom
+		frustum.planes[3] = row[3] - row[1]; // top
+		frustum.planes[4] = row[3] + row[2]; // near
+		frustum.planes[5] = row[3] - row[2]; // far
+		for (glm::vec4& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	bool intersects(const glm::vec4& sphere) const {
+		return classify(sphere) != OUTSIDE;
+	}
+	enum : uint8_t { OUTSIDE = 0, INTERSECTING = 1, INSIDE = 2 };
+	uint8_t classify(const glm::vec4& sphere) const {
+		uint8_t result = INSIDE;
+		for (const glm::vec4& plane : planes) {
+			float distance = glm::dot(glm::vec3(plane), glm::vec3(sphere)) + plane.w;
+			if (distance < -sphere.w) {
+				return OUTSIDE;
+			}
+			if (distance < sphere.w) {
+				result = INTERSECTING;
+			}
+		}
+		return result;
+	}
+	// Tests the box corner furthest along each plane normal
+	bool intersects(const AABB& box) const {
+		for (const glm::vec4& plane : planes) {
+			glm::vec3 corner(plane.x >= 0.0f ? box.max.x : box.min.x, plane.y >= 0.0f ? box.max.y : box.min.y, plane.z >= 0.0f ? box.max.z : box.min.z);
+			if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+// Culls models against the camera frustum before submission. Bounding spheres are gathered into
+// aligned SoA arrays and tested 8 (AVX) or 4 (SSE) at a time; only spheres crossing a plane get the tighter AABB test.
+struct FRUSTUM_CULLER {
+	template<typename T>
+	using ARRAY = std::vector<T, ALIGNED_ALLOCATOR<T>>;
+
+	std::vector<MODEL*> visible;
+	size_t tested = 0;
+	size_t culled = 0;
+	double time = 0.0; // ms
+
+	const std::vector<MODEL*>& CULL(const std::vector<MODEL*>& models, const CAMERA& camera) {
+		auto start = std::chrono::high_resolution_clock::now();
+		FRUSTUM frustum = FRUSTUM::FROM_MATRIX(camera.getProjectionMatrix() * camera.getViewMatrix());
+		size_t count = models.size();
+		// Padded to the SIMD width with spheres that always pass, trimmed again below
+		size_t padded = (count + 7) & ~size_t(7);
+		cx.resize(padded); cy.resize(padded); cz.resize(padded); radius.resize(padded);
+		classes.resize(padded);
+		for (size_t i = 0; i < count; ++i) {
+			const glm::vec4& sphere = models[i]->getWorldSphere();
+			cx[i] = sphere.x; cy[i] = sphere.y; cz[i] = sphere.z; radius[i] = sphere.w;
+		}
+		for (size_t i = count; i < padded; ++i) {
+			cx[i] = cy[i] = cz[i] = 0.0f;
+			radius[i] = FLT_MAX;
+		}
+
+		size_t i = 0;
+#if defined(UBODY_AVX)
+		i = testSpheresAVX(frustum, padded);
+#elif defined(UBODY_SSE)
+		i = testSpheresSSE(frustum, padded);
+#endif
+		testSpheresScalar(frustum, i, padded);
+
+		visible.clear();
+		for (size_t m = 0; m < count; ++m) {
+			if (classes[m] == FRUSTUM::INSIDE || (classes[m] == FRUSTUM::INTERSECTING && frustum.intersects(models[m]->getWorldBounds()))) {
+				visible.push_back(models[m]);
+			}
+		}
+		tested = count;
+		culled = count - visible.size();
+		time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return visible;
+	}
+
+	void testSpheresScalar(const FRUSTUM& frustum, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			classes[i] = frustum.classify(glm::vec4(cx[i], cy[i], cz[i], radius[i]));
+		}
+	}
+
+private:
+	ARRAY<float> cx, cy, cz, radius;
+	std::vector<uint8_t> classes; // FRUSTUM::OUTSIDE, INTERSECTING or INSIDE per sphere
+
+	void storeClasses(size_t first, int lanes, int outside, int crossing) {
+		for (int lane = 0; lane < lanes; ++lane) {
+			classes[first + lane] = (outside >> lane) & 1 ? FRUSTUM::OUTSIDE : (crossing >> lane) & 1 ? FRUSTUM::INTERSECTING : FRUSTUM::INSIDE;
+		}
+	}
+
+#if defined(UBODY_AVX)
+	size_t testSpheresAVX(const FRUSTUM& frustum, size_t count) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 x = _mm256_load_ps(&cx[i]);
+			__m256 y = _mm256_load_ps(&cy[i]);
+			__m256 z = _mm256_load_ps(&cz[i]);
+			__m256 r = _mm256_load_ps(&radius[i]);
+			__m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), r);
+			__m256 outside = _mm256_setzero_ps();
+			__m256 crossing = _mm256_setzero_ps();
+			for (const glm::vec4& plane : frustum.planes) {
+				__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane.x)), _mm256_mul_ps(y, _mm256_set1_ps(plane.y))),
+					_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+				crossing = _mm256_or_ps(crossing, _mm256_cmp_ps(distance, r, _CMP_LT_OQ));
+			}
+			storeClasses(i, 8, _mm256_movemask_ps(outside), _mm256_movemask_ps(crossing));
+		}
+		return i;
+	}
+#elif defined(UBODY_SSE)
+	size_t testSpheresSSE(const FRUSTUM& frustum, size_t count) {
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128 x = _mm_load_ps(&cx[i]);
+			__m128 y = _mm_load_ps(&cy[i]);
+			__m128 z = _mm_load_ps(&cz[i]);
+			__m128 r = _mm_load_ps(&radius[i]);
+			__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+			__m128 outside = _mm_setzero_ps();
+			__m128 crossing = _mm_setzero_ps();
+			for (const glm::vec4& plane : frustum.planes) {
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+				crossing = _mm_or_ps(crossing, _mm_cmplt_ps(distance, r));
+			}
+			storeClasses(i, 4, _mm_movemask_ps(outside), _mm_movemask_ps(crossing));
+		}
+		return i;
+	}
+#endif
+};
+
+#endif
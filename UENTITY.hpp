@@ -0,0 +1,403 @@
+#ifndef __UENTITY_HPP__
+#define __UENTITY_HPP__
+#include "UGL.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Generational handle: stays valid while the entity lives, and detects use after DESTROY
+struct ENTITY_HANDLE {
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool isNull() const {
+		return index == UINT32_MAX;
+	}
+	bool operator==(const ENTITY_HANDLE& other) const {
+		return index == other.index && generation == other.generation;
+	}
+	bool operator!=(const ENTITY_HANDLE& other) const {
+		return !(*this == other);
+	}
+};
+
+// Optional components of an entity; every entity has a MODEL, which holds its mesh reference and transform
+enum ENTITY_COMPONENTS : uint32_t {
+	COMPONENT_BOX_COLLIDER = 1 << 0,
+	COMPONENT_SPHERE_COLLIDER = 1 << 1,
+	COMPONENT_BODY = 1 << 2,
+	COMPONENT_GIZMO = 1 << 3,
+	COMPONENT_COLLIDER = COMPONENT_BOX_COLLIDER | COMPONENT_SPHERE_COLLIDER
+};
+
+// Translation handles drawn on a model, one draggable arrow per axis
+struct GIZMO {
+	MODEL_AXIS x;
+	MODEL_AXIS y;
+	MODEL_AXIS z;
+
+	void SET(const glm::vec3& position) {
+		x.SET({ 1.0f, 0.0f, 0.0f }, position, glm::vec3(3.0f, 0.0f, 0.0f));
+		y.SET({ 0.0f, 1.0f, 0.0f }, position, glm::vec3(0.0f, 3.0f, 0.0f));
+		z.SET({ 0.0f, 0.0f, 1.0f }, position, glm::vec3(0.0f, 0.0f, 3.0f));
+	}
+	// The axis under the mouse, if any
+	MODEL_AXIS* getHovered(const glm::vec2& mousePos, CAMERA& camera) {
+		for (MODEL_AXIS* axis : { &x, &y, &z }) {
+			if (axis->isHovered(mousePos, camera)) {
+				return axis;
+			}
+		}
+		return nullptr;
+	}
+	void DRAW(const glm::vec3& position) {
+		for (MODEL_AXIS* axis : { &x, &y, &z }) {
+			axis->setStart(position);
+			axis->DRAW();
+		}
+	}
+};
+
+// Every entity with one component set. Each component is a dense column and row i of every column belongs
+// to entities[i]; columns of components the set lacks stay empty. Models are the one column held through
+// pointers, since transforms link to each other by address.
+struct ARCHETYPE {
+	uint32_t components = 0;
+	std::vector<ENTITY_HANDLE> entities;
+	std::vector<std::unique_ptr<MODEL>> models;
+	std::vector<BOX_COLLIDER> boxes;
+	std::vector<SPHERE_COLLIDER> spheres;
+	std::vector<BODY_HANDLE> bodies;
+	std::vector<GIZMO> gizmos;
+
+	size_t size() const {
+		return entities.size();
+	}
+	bool has(uint32_t mask) const {
+		return (components & mask) == mask;
+	}
+	bool hasAny(uint32_t mask) const {
+		return (components & mask) != 0;
+	}
+	COLLIDER* getCollider(size_t row) {
+		if (has(COMPONENT_BOX_COLLIDER)) {
+			return &boxes[row];
+		}
+		if (has(COMPONENT_SPHERE_COLLIDER)) {
+			return &spheres[row];
+		}
+		return nullptr;
+	}
+	const COLLIDER* getCollider(size_t row) const {
+		return const_cast<ARCHETYPE*>(this)->getCollider(row);
+	}
+
+	// Fills the hole at row with the last row; returns the entity that moved into it, null when row was last
+	ENTITY_HANDLE SWAP_REMOVE(size_t row) {
+		ENTITY_HANDLE moved;
+		size_t last = size() - 1;
+		if (row != last) {
+			moved = entities[last];
+			entities[row] = entities[last];
+			models[row] = std::move(models[last]);
+			if (has(COMPONENT_BOX_COLLIDER)) {
+				boxes[row] = boxes[last];
+			}
+			if (has(COMPONENT_SPHERE_COLLIDER)) {
+				spheres[row] = spheres[last];
+			}
+			if (has(COMPONENT_BODY)) {
+				bodies[row] = bodies[last];
+			}
+			if (has(COMPONENT_GIZMO)) {
+				gizmos[row] = gizmos[last];
+			}
+		}
+		entities.pop_back();
+		models.pop_back();
+		if (has(COMPONENT_BOX_COLLIDER)) {
+			boxes.pop_back();
+		}
+		if (has(COMPONENT_SPHERE_COLLIDER)) {
+			spheres.pop_back();
+		}
+		if (has(COMPONENT_BODY)) {
+			bodies.pop_back();
+		}
+		if (has(COMPONENT_GIZMO)) {
+			gizmos.pop_back();
+		}
+		return moved;
+	}
+};
+
+// The editor scene as an archetype store. An entity lives in the archetype of its component set, so systems
+// walk dense columns (FOR_EACH) instead of chasing per-model pointers. Handles map to an archetype row
+// through the slot table, like BODY_STORE; DESTROY and component changes swap-remove rows in O(1).
+// getModels() is the flat list of every entity's model that rendering, culling and picking take; it is
+// swap-removed too, so its order changes on DESTROY.
+struct ENTITY_STORE {
+	ENTITY_STORE() = default;
+	ENTITY_STORE(const ENTITY_STORE&) = delete;
+	ENTITY_STORE& operator=(const ENTITY_STORE&) = delete;
+	~ENTITY_STORE() {
+		CLEAR();
+	}
+
+	ENTITY_HANDLE CREATE(std::unique_ptr<MODEL> model) {
+		uint32_t slot;
+		if (!freeSlots.empty()) {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else {
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back({ 0, 0, 0, 0 });
+		}
+		ENTITY_HANDLE handle = { slot, slots[slot].generation };
+		uint32_t archetype = findArchetype(0);
+		ARCHETYPE& target = archetypes[archetype];
+		slots[slot].archetype = archetype;
+		slots[slot].row = static_cast<uint32_t>(target.size());
+		slots[slot].listIndex = static_cast<uint32_t>(modelList.size());
+		modelList.push_back(model.get());
+		listEntities.push_back(handle);
+		target.entities.push_back(handle);
+		target.models.push_back(std::move(model));
+		return handle;
+	}
+
+	void DESTROY(ENTITY_HANDLE handle) {
+		if (!isValid(handle)) {
+			return;
+		}
+		SLOT& slot = slots[handle.index];
+		ARCHETYPE& archetype = archetypes[slot.archetype];
+		if (archetype.has(COMPONENT_BODY)) {
+			getBodyStore().DESTROY(archetype.bodies[slot.row]);
+		}
+		uint32_t listIndex = slot.listIndex;
+		removeRow(slot.archetype, slot.row);
+		modelList[listIndex] = modelList.back();
+		listEntities[listIndex] = listEntities.back();
+		slots[listEntities[listIndex].index].listIndex = listIndex;
+		modelList.pop_back();
+		listEntities.pop_back();
+		slot.generation += 1;
+		freeSlots.push_back(handle.index);
+	}
+
+	// Destroys every entity; handles given out so far turn invalid
+	void CLEAR() {
+		BODY_STORE& bodies = getBodyStore();
+		for (ARCHETYPE& archetype : archetypes) {
+			for (BODY_HANDLE body : archetype.bodies) {
+				bodies.DESTROY(body);
+			}
+		}
+		archetypes.clear();
+		modelList.clear();
+		listEntities.clear();
+		freeSlots.clear();
+		for (uint32_t i = 0; i < slots.size(); ++i) {
+			slots[i].generation += 1;
+			freeSlots.push_back(i);
+		}
+	}
+
+	bool isValid(ENTITY_HANDLE handle) const {
+		return !handle.isNull() && handle.index < slots.size() && slots[handle.index].generation == handle.generation;
+	}
+	size_t size() const {
+		return modelList.size();
+	}
+
+	// Every entity's model, for the passes that walk the whole scene
+	const std::vector<MODEL*>& getModels() const {
+		return modelList;
+	}
+	// The entity owning getModels()[index]
+	ENTITY_HANDLE getEntity(size_t index) const {
+		return listEntities[index];
+	}
+
+	uint32_t getComponents(ENTITY_HANDLE handle) const {
+		return isValid(handle) ? archetypes[slots[handle.index].archetype].components : 0;
+	}
+	MODEL* getModel(ENTITY_HANDLE handle) const {
+		return isValid(handle) ? modelList[slots[handle.index].listIndex] : nullptr;
+	}
+	COLLIDER* getCollider(ENTITY_HANDLE handle) {
+		return isValid(handle) ? archetypes[slots[handle.index].archetype].getCollider(slots[handle.index].row) : nullptr;
+	}
+	const COLLIDER* getCollider(ENTITY_HANDLE handle) const {
+		return const_cast<ENTITY_STORE*>(this)->getCollider(handle);
+	}
+	COLLIDER_TYPE getColliderType(ENTITY_HANDLE handle) const {
+		uint32_t components = getComponents(handle);
+		return components & COMPONENT_BOX_COLLIDER ? COLLIDER_TYPE::BOX
+			: components & COMPONENT_SPHERE_COLLIDER ? COLLIDER_TYPE::SPHERE : COLLIDER_TYPE::NONE;
+	}
+	// Null without a body
+	BODY_HANDLE getBody(ENTITY_HANDLE handle) const {
+		if (!(getComponents(handle) & COMPONENT_BODY)) {
+			return BODY_HANDLE();
+		}
+		return archetypes[slots[handle.index].archetype].bodies[slots[handle.index].row];
+	}
+	GIZMO* getGizmo(ENTITY_HANDLE handle) {
+		if (!(getComponents(handle) & COMPONENT_GIZMO)) {
+			return nullptr;
+		}
+		return &archetypes[slots[handle.index].archetype].gizmos[slots[handle.index].row];
+	}
+
+	// Replaces the collider with a fresh one around the model; NONE removes it
+	void setCollider(ENTITY_HANDLE handle, COLLIDER_TYPE type) {
+		if (!isValid(handle)) {
+			return;
+		}
+		uint32_t components = getComponents(handle) & ~COMPONENT_COLLIDER;
+		changeComponents(handle, type == COLLIDER_TYPE::BOX ? components | COMPONENT_BOX_COLLIDER
+			: type == COLLIDER_TYPE::SPHERE ? components | COMPONENT_SPHERE_COLLIDER : components);
+		const SLOT& slot = slots[handle.index];
+		ARCHETYPE& archetype = archetypes[slot.archetype];
+		const MODEL& model = *archetype.models[slot.row];
+		if (type == COLLIDER_TYPE::BOX) {
+			archetype.boxes[slot.row] = BOX_COLLIDER();
+			archetype.boxes[slot.row].SET(model.getProperty_Position(), model.getProperty_Scale(),
+				TRANSFORM::rotationMatrix(model.getProperty_RotationAxis()));
+		}
+		else if (type == COLLIDER_TYPE::SPHERE) {
+			archetype.spheres[slot.row] = SPHERE_COLLIDER();
+			archetype.spheres[slot.row].SET(model.getProperty_Position());
+		}
+		// A sleeping body's bounds are not refreshed, so a new shape wakes it
+		if (archetype.has(COMPONENT_BODY)) {
+			getBodyStore().WAKE(archetype.bodies[slot.row]);
+		}
+	}
+	// A rigid body at the model's position, unless there is one already
+	BODY_HANDLE setBody(ENTITY_HANDLE handle) {
+		uint32_t components = getComponents(handle);
+		if (!isValid(handle) || (components & COMPONENT_BODY)) {
+			return getBody(handle);
+		}
+		changeComponents(handle, components | COMPONENT_BODY);
+		const SLOT& slot = slots[handle.index];
+		ARCHETYPE& archetype = archetypes[slot.archetype];
+		archetype.bodies[slot.row] = getBodyStore().CREATE(archetype.models[slot.row]->getProperty_Position(), 1.0f);
+		return archetype.bodies[slot.row];
+	}
+	void setGizmo(ENTITY_HANDLE handle) {
+		if (!isValid(handle)) {
+			return;
+		}
+		changeComponents(handle, getComponents(handle) | COMPONENT_GIZMO);
+		const SLOT& slot = slots[handle.index];
+		ARCHETYPE& archetype = archetypes[slot.archetype];
+		archetype.gizmos[slot.row].SET(archetype.models[slot.row]->getProperty_Position());
+	}
+
+	// Moves the model together with its collider and body
+	void setPosition(ENTITY_HANDLE handle, const glm::vec3& position) {
+		if (!isValid(handle)) {
+			return;
+		}
+		const SLOT& slot = slots[handle.index];
+		ARCHETYPE& archetype = archetypes[slot.archetype];
+		archetype.models[slot.row]->setProperty_Position(position);
+		if (COLLIDER* collider = archetype.getCollider(slot.row)) {
+			collider->position = position;
+		}
+		if (archetype.has(COMPONENT_BODY)) {
+			getBodyStore().setPosition(archetype.bodies[slot.row], position);
+		}
+	}
+
+	// Calls system(ARCHETYPE&) for every non-empty archetype holding all of components
+	template<typename SYSTEM>
+	void FOR_EACH(uint32_t components, SYSTEM&& system) {
+		for (ARCHETYPE& archetype : archetypes) {
+			if (archetype.has(components) && archetype.size() > 0) {
+				system(archetype);
+			}
+		}
+	}
+	template<typename SYSTEM>
+	void FOR_EACH(uint32_t components, SYSTEM&& system) const {
+		for (const ARCHETYPE& archetype : archetypes) {
+			if (archetype.has(components) && archetype.size() > 0) {
+				system(archetype);
+			}
+		}
+	}
+
+private:
+	struct SLOT {
+		uint32_t generation;
+		uint32_t archetype;
+		uint32_t row;
+		uint32_t listIndex; // into modelList
+	};
+
+	std::vector<SLOT> slots;
+	std::vector<uint32_t> freeSlots;
+	std::vector<ARCHETYPE> archetypes; // at most one per component set, never removed
+	std::vector<MODEL*> modelList;
+	std::vector<ENTITY_HANDLE> listEntities;
+
+	uint32_t findArchetype(uint32_t components) {
+		for (uint32_t i = 0; i < archetypes.size(); ++i) {
+			if (archetypes[i].components == components) {
+				return i;
+			}
+		}
+		archetypes.emplace_back();
+		archetypes.back().components = components;
+		return static_cast<uint32_t>(archetypes.size() - 1);
+	}
+
+	void removeRow(uint32_t archetype, uint32_t row) {
+		ENTITY_HANDLE moved = archetypes[archetype].SWAP_REMOVE(row);
+		if (!moved.isNull()) {
+			slots[moved.index].row = row;
+		}
+	}
+
+	// Moves the entity's row to the archetype of components, keeping the components both sets share.
+	// Added ones are default constructed; a dropped body is destroyed.
+	void changeComponents(ENTITY_HANDLE handle, uint32_t components) {
+		SLOT& slot = slots[handle.index];
+		uint32_t from = slot.archetype;
+		if (archetypes[from].components == components) {
+			return;
+		}
+		uint32_t to = findArchetype(components);
+		ARCHETYPE& source = archetypes[from];
+		ARCHETYPE& target = archetypes[to];
+		uint32_t row = slot.row;
+		target.entities.push_back(handle);
+		target.models.push_back(std::move(source.models[row]));
+		if (target.has(COMPONENT_BOX_COLLIDER)) {
+			target.boxes.push_back(source.has(COMPONENT_BOX_COLLIDER) ? source.boxes[row] : BOX_COLLIDER());
+		}
+		if (target.has(COMPONENT_SPHERE_COLLIDER)) {
+			target.spheres.push_back(source.has(COMPONENT_SPHERE_COLLIDER) ? source.spheres[row] : SPHERE_COLLIDER());
+		}
+		if (target.has(COMPONENT_BODY)) {
+			target.bodies.push_back(source.has(COMPONENT_BODY) ? source.bodies[row] : BODY_HANDLE());
+		}
+		else if (source.has(COMPONENT_BODY)) {
+			getBodyStore().DESTROY(source.bodies[row]);
+		}
+		if (target.has(COMPONENT_GIZMO)) {
+			target.gizmos.push_back(source.has(COMPONENT_GIZMO) ? source.gizmos[row] : GIZMO());
+		}
+		removeRow(from, row);
+		slot.archetype = to;
+		slot.row = static_cast<uint32_t>(target.size() - 1);
+	}
+};
+
+#endif
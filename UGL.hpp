@@ -1,7 +1,13 @@
 #ifndef __UGL_HPP__
 #define __UGL_HPP__
 #include "UPHYSIC.hpp"
+#include "URENDER.hpp"
+#include "UMESHCACHE.hpp"
+#include "USIMULATION.hpp"
+#include "UPROFILE.hpp"
+#include "UTRANSFORM.hpp"
 #include <corecrt_math_defines.h>
+#include <unordered_map>
 #define SELECTION_THRESHOLD 1.0f
 
 inline unsigned int compileShader(unsigned int type, const char* source) {
@@ -58,6 +64,102 @@ inline unsigned int createShader(const char* vertexShader, const char* fragmentS
 	return program;
 }
 
+enum class UNIFORM {
+	MODEL,
+	VIEW,
+	PROJECTION,
+	LIGHT_POS,
+	LIGHT_COLOR,
+	OBJECT_COLOR,
+	POSITION_OFFSET,
+	POSITION_SCALE,
+	NORMAL_MATRIX,
+	COUNT
+};
+
+inline const char* getUniformName(UNIFORM uniform) {
+	static const char* names[] = { "model", "view", "projection", "lightPos", "lightColor", "objectColor", "positionOffset", "positionScale", "normalMatrix" };
+	return names[static_cast<size_t>(uniform)];
+}
+
+// Linked program plus its uniform locations, resolved once at link time
+struct SHADER_PROGRAM {
+	unsigned int id = 0;
+	size_t sourceHash = 0;
+	int locations[static_cast<size_t>(UNIFORM::COUNT)] = {};
+
+	int getLocation(UNIFORM uniform) const {
+		return locations[static_cast<size_t>(uniform)];
+	}
+};
+
+// Programs keyed by the hash of their sources, so every model using the same shaders shares one program.
+// defines (e.g. VERTEX_FORMAT::getDefines()) are inserted after the #version line of both stages.
+struct SHADER_CACHE {
+	std::unordered_map<std::string, std::string> sources;
+	std::unordered_map<size_t, std::unique_ptr<SHADER_PROGRAM>> programs;
+
+	const SHADER_PROGRAM* GET(const std::string& vertexFile, const std::string& fragmentFile, const std::string& defines = "") {
+		std::string vertexSource = addDefines(readSource(vertexFile), defines);
+		std::string fragmentSource = addDefines(readSource(fragmentFile), defines);
+		size_t hash = std::hash<std::string>{}(vertexSource + '\0' + fragmentSource);
+
+		auto it = programs.find(hash);
+		if (it != programs.end()) {
+			return it->second.get();
+		}
+		std::unique_ptr<SHADER_PROGRAM> program = std::make_unique<SHADER_PROGRAM>();
+		program->id = createShader(vertexSource.c_str(), fragmentSource.c_str());
+		program->sourceHash = hash;
+		for (size_t i = 0; i < static_cast<size_t>(UNIFORM::COUNT); ++i) {
+			program->locations[i] = glGetUniformLocation(program->id, getUniformName(static_cast<UNIFORM>(i)));
+		}
+		return programs.emplace(hash, std::move(program)).first->second.get();
+	}
+
+	void CLEAR() {
+		for (auto& [hash, program] : programs) {
+			if (program->id != 0) {
+				getGlState().FORGET_PROGRAM(program->id);
+				glDeleteProgram(program->id);
+			}
+		}
+		programs.clear();
+		sources.clear();
+	}
+
+private:
+	static std::string addDefines(const std::string& source, const std::string& defines) {
+		if (defines.empty()) {
+			return source;
+		}
+		size_t version = source.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+		if (lineEnd == std::string::npos) {
+			return defines + source;
+		}
+		return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+	}
+	const std::string& readSource(const std::string& filename) {
+		auto it = sources.find(filename);
+		if (it != sources.end()) {
+			return it->second;
+		}
+		std::ifstream _file(filename);
+		if (!_file.is_open()) {
+			throw std::runtime_error("Failed to open shader file: " + filename);
+		}
+		std::stringstream _buffer;
+		_buffer << _file.rdbuf();
+		return sources.emplace(filename, _buffer.str()).first->second;
+	}
+};
+
+inline SHADER_CACHE& getShaderCache() {
+	static SHADER_CACHE cache;
+	return cache;
+}
+
 struct CAMERA {
 	glm::vec3 _eye = { 30.f, 30.0f, 30.0f };
 	glm::vec3 _front = { -1.0f, -1.0f, -1.0f };
@@ -174,8 +276,8 @@ struct LIGHT {
 	void SET() {
 		GLfloat lightPosition[] = { _pos.x, _pos.y, _pos.z, 1.0f };
 		GLfloat lightColor[] = { _color.x, _color.y, _color.z, 1.0f };
-		glLightfv(GL_LIGHT0, GL_POSITION, lightPosition);
-		glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);
+		getGlState().SET_LIGHT(GL_LIGHT0, GL_POSITION, lightPosition);
+		getGlState().SET_LIGHT(GL_LIGHT0, GL_DIFFUSE, lightColor);
 	}
 	void DRAW() {
 		glPushMatrix();
@@ -186,6 +288,89 @@ struct LIGHT {
 	}
 };
 
+// Ground grid kept in one line VBO, rebuilt only when its parameters change.
+// Drawn through the fixed function pipeline like the rest of the editor overlays.
+struct GRID {
+	int cellCount = 100; // cells per side, centered on the origin
+	float cellSize = 1.0f;
+	glm::vec3 _color = { 0.5f, 0.5f, 0.5f };
+
+	GRID() = default;
+	GRID(const GRID&) = delete;
+	GRID& operator=(const GRID&) = delete;
+	~GRID() {
+		RELEASE();
+	}
+
+	void SET(int cells, float size) {
+		cells = std::max(cells, 1);
+		size = std::max(size, 0.001f);
+		if (cells != cellCount || size != cellSize) {
+			cellCount = cells;
+			cellSize = size;
+			dirty = true;
+		}
+	}
+
+	void DRAW() {
+		if (dirty) {
+			UPLOAD();
+		}
+		// GLUT shapes toggle the vertex array and expect buffer 0, so both are put back afterwards
+		GL_STATE& state = getGlState();
+		state.USE_PROGRAM(0);
+		state.BIND_VERTEX_ARRAY(0);
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, VBO);
+		state.ENABLE_CLIENT_STATE(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, 0, (void*)0);
+		glColor3f(_color.x, _color.y, _color.z);
+		glDrawArrays(GL_LINES, 0, vertexCount);
+		state.DISABLE_CLIENT_STATE(GL_VERTEX_ARRAY);
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, 0);
+		getRenderStats().drawCalls += 1;
+	}
+
+	void RELEASE() {
+		if (VBO != 0) {
+			getGlState().FORGET_BUFFER(VBO);
+			glDeleteBuffers(1, &VBO);
+			getRenderStats().buffersDeleted += 1;
+			VBO = 0;
+		}
+		dirty = true;
+	}
+
+private:
+	GLuint VBO = 0;
+	GLsizei vertexCount = 0;
+	bool dirty = true;
+
+	// cellCount + 1 lines along each axis
+	void UPLOAD() {
+		float half = cellCount * cellSize * 0.5f;
+		std::vector<float> vertices;
+		vertices.reserve(static_cast<size_t>(cellCount + 1) * 12);
+		for (int i = 0; i <= cellCount; ++i) {
+			float offset = -half + i * cellSize;
+			float lines[12] = {
+				offset, 0.0f, -half, offset, 0.0f, half,
+				-half, 0.0f, offset, half, 0.0f, offset
+			};
+			vertices.insert(vertices.end(), lines, lines + 12);
+		}
+		if (VBO == 0) {
+			glGenBuffers(1, &VBO);
+			getRenderStats().buffersCreated += 1;
+		}
+		getGlState().BIND_BUFFER(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+		getGlState().BIND_BUFFER(GL_ARRAY_BUFFER, 0);
+		getRenderStats().bytesUploaded += vertices.size() * sizeof(float);
+		vertexCount = static_cast<GLsizei>(vertices.size() / 3);
+		dirty = false;
+	}
+};
+
 struct MODEL_AXIS {
 	glm::vec3 color;
 	glm::vec3 start;
@@ -274,12 +459,20 @@ struct MODEL_AXIS {
 struct MODEL {
 
 public:
-	COLLIDER_TYPE colliderType = COLLIDER_TYPE::NONE;
-	std::shared_ptr<COLLIDER> collider;
-	std::shared_ptr<PHYSICS> physics;
-	std::shared_ptr<MODEL_AXIS> axisX;
-	std::shared_ptr<MODEL_AXIS> axisY;
-	std::shared_ptr<MODEL_AXIS> axisZ;
+	// Set by SCENE_PICKER: the first drawn transform or mesh change after a refit pushes transformSlot here
+	std::shared_ptr<std::vector<uint32_t>> transformListener;
+	uint32_t transformSlot = 0;
+	bool transformQueued = false;
+	MODEL() {
+		transform.onWorldChanged = [this] { notifyTransformChanged(); };
+	}
+	// Starts from the given mesh instead of an empty one in the editor's default format
+	explicit MODEL(std::shared_ptr<MESH> mesh) : mesh(std::move(mesh)) {
+		transform.onWorldChanged = [this] { notifyTransformChanged(); };
+	}
+	virtual ~MODEL() {
+		transform.onWorldChanged = nullptr; // detaching below must not reach a half-destroyed model
+	}
 	virtual void Init(const std::string&) = 0;
 
 	std::string getName() const {
@@ -289,26 +482,52 @@ public:
 		return _pos;
 	}
 	glm::vec3 getProperty_RotationAxis() const {
-		return _rotationAxis;
+		return transform.getRotation();
 	}
 	glm::vec3 getProperty_Scale() const {
-		return _scale;
+		return transform.getScale();
 	}
 	glm::vec3 getColor() const {
 		return _color;
 	}
 
+	// The model alone; ENTITY_STORE::setPosition moves its collider and body along
 	void setProperty_Position(glm::vec3 position) {
 		_pos = position;
-		if (collider) {
-			collider->position = position;
-		}
+		transform.setPosition(position);
+	}
+	// Main thread side of a physics step: current is the latest simulated position, interpolated is drawn
+	void syncFromSnapshot(const glm::vec3& current, const glm::vec3& interpolated) {
+		_pos = current;
+		transform.setPosition(interpolated);
+	}
+	void syncFromSnapshot() {
+		transform.setPosition(_pos);
 	}
 	void setProperty_RotationAxis(glm::vec3 rotationAxis) {
-		_rotationAxis = rotationAxis;
+		transform.setRotation(rotationAxis);
 	}
 	void setProperty_Scale(glm::vec3 scale) {
-		_scale = scale;
+		transform.setScale(scale);
+	}
+	// Position, rotation and scale become relative to parent, the transform of another model or of one
+	// of its nodes. Bodies simulate in the parent's space, so physics is meant for root models.
+	// False for a parent inside this model's own subtree.
+	bool setParent(TRANSFORM* parent) {
+		return transform.setParent(parent);
+	}
+	TRANSFORM* getParent() const {
+		return transform.getParent();
+	}
+	TRANSFORM& getTransform() {
+		return transform;
+	}
+	const TRANSFORM& getTransform() const {
+		return transform;
+	}
+	// Attachment points below this model, one per node of its mesh
+	virtual TRANSFORM* getNodeTransform(size_t) {
+		return nullptr;
 	}
 	void setColor(glm::vec3 color) {
 		_color = color;
@@ -316,197 +535,156 @@ public:
 	void setName(std::string name) {
 		this->name = name;
 	}
+	// Call after editing vertices/normals so the next DRAW re-uploads them
+	void setMeshDirty() {
+		mesh->setGeometryDirty();
+		mesh->vertexData.clear();
+		// The chain was simplified from the old geometry
+		mesh->lods.clear();
+		mesh->lodIndices.clear();
+		mesh->bvhDirty = true;
+		notifyTransformChanged();
+	}
+	std::shared_ptr<MESH> getMesh() const {
+		return mesh;
+	}
+	// Mesh bounds under the drawn transform, cached until the transform or mesh changes
+	const AABB& getWorldBounds() {
+		updateWorldBounds();
+		return worldBounds;
+	}
+	// xyz center, w radius
+	const glm::vec4& getWorldSphere() {
+		updateWorldBounds();
+		return worldSphere;
+	}
+	size_t getLod() const {
+		return lod;
+	}
+	// Picks the level to draw from the share of the viewport height the bounding sphere covers
+	void UPDATE_LOD(const CAMERA& camera, const LOD_SETTINGS& settings) {
+		const glm::vec4& sphere = getWorldSphere();
+		float distance = glm::length(glm::vec3(sphere) - camera.getPosition());
+		float screenSize = distance > sphere.w
+			? sphere.w / (distance * std::tan(glm::radians(camera._fovy) * 0.5f))
+			: FLT_MAX;
+		lod = settings.SELECT(screenSize, lod, mesh->getLodCount());
+	}
 	void setShaderProgram() {
-		std::string vertexShaderSource = ReadShaderFile("VertexShader.vert");
-		std::string fragmentShaderSource = ReadShaderFile("FragmentShader.frag");
-		//std::string rayShaderSource = ReadShaderFile("ComputeShader.ray");
-		shaderProgram = createShader(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
-	}
-	void setCollision(bool collision) const {
-		if (collider != nullptr)
-			collider->collision = collision;
-	}
-	void setCollider() {
-		if (colliderType == COLLIDER_TYPE::BOX){
-			collider = std::make_shared<BOX_COLLIDER>();
-			std::static_pointer_cast<BOX_COLLIDER>(collider)->SET(_pos, _scale, glm::mat3(1.0f));
-		}
-		else if (colliderType == COLLIDER_TYPE::SPHERE) {
-			collider = std::make_shared<SPHERE_COLLIDER>();
-			std::static_pointer_cast<SPHERE_COLLIDER>(collider)->SET(_pos);
-		}
-	}
-	void setPhysics(){
-		physics = std::make_shared<PHYSICS>();
-	}
-	void setAxis() {
-		axisX = std::make_shared<MODEL_AXIS>();
-		axisY = std::make_shared<MODEL_AXIS>();
-		axisZ = std::make_shared<MODEL_AXIS>();
-		axisX->SET({ 1.0f, 0.0f, 0.0f }, _pos, glm::vec3(3.0f, 0.0f, 0.0f));
-		axisY->SET({ 0.0f, 1.0f, 0.0f }, _pos, glm::vec3(0.0f, 3.0f, 0.0f));
-		axisZ->SET({ 0.0f, 0.0f, 1.0f }, _pos, glm::vec3(0.0f, 0.0f, 3.0f));
-	}
-
-	void SAVE(const char* filename) {
-		std::ofstream file(filename);
-		file << "Name: " << name << std::endl;
-		file << "Color: " << _color.x << " " << _color.y << " " << _color.z << std::endl;
-		file << "Position: " << _pos.x << " " << _pos.y << " " << _pos.z << std::endl;
-		file << "RotationAxis: " << _rotationAxis.x << " " << _rotationAxis.y << " " << _rotationAxis.z << std::endl;
-		file << "Scale: " << _scale.x << " " << _scale.y << " " << _scale.z << std::endl;
-		file.close();
-	}
-	void LOAD(const char* filename) {
-		std::ifstream file(filename);
-		std::string line;
-		while (std::getline(file, line)) {
-			std::istringstream iss(line);
-			std::string type;
-			iss >> type;
-			if (type == "Name:") {
-				iss >> name;
-			}
-			else if (type == "Color:") {
-				iss >> _color.x >> _color.y >> _color.z;
-			}
-			else if (type == "Position:") {
-				iss >> _pos.x >> _pos.y >> _pos.z;
-			}
-			else if (type == "RotationAxis:") {
-				iss >> _rotationAxis.x >> _rotationAxis.y >> _rotationAxis.z;
-			}
-			else if (type == "Scale:") {
-				iss >> _scale.x >> _scale.y >> _scale.z;
-			}
-		}
-		file.close();
+		shaderFormat = mesh->format;
+		shaderProgram = getShaderCache().GET("VertexShader.vert", "FragmentShader.frag", shaderFormat.getDefines());
 	}
 
-	bool InterSection(glm::vec3 rayOrigin, glm::vec3 rayDirection) const {
-		glm::vec3 min = _pos;
-		glm::vec3 max = _pos + _scale;
-		float tmin = (min.x - rayOrigin.x) / rayDirection.x;
-		float tmax = (max.x - rayOrigin.x) / rayDirection.x;
-
-		if (tmin > tmax) std::swap(tmin, tmax);
-
-		float tymin = (min.y - rayOrigin.y) / rayDirection.y;
-		float tymax = (max.y - rayOrigin.y) / rayDirection.y;
-
-		if (tymin > tymax) std::swap(tymin, tymax);
-
-		if ((tmin > tymax) || (tymin > tmax)) return false;
-
-		if (tymin > tmin) tmin = tymin;
-		if (tymax < tmax) tmax = tymax;
-
-		float tzmin = (min.z - rayOrigin.z) / rayDirection.z;
-		float tzmax = (max.z - rayOrigin.z) / rayDirection.z;
-
-		if (tzmin > tzmax) std::swap(tzmin, tzmax);
-
-		if ((tmin > tzmax) || (tzmin > tmax)) return false;
-
-		if (tzmin > tmin) tmin = tzmin;
-		if (tzmax < tmax) tmax = tzmax;
-
-		return tmax >= 0;
+	// Drawn transform in world space, including every parent; cached until something on the way changes
+	const glm::mat4& getModelMatrix() const {
+		return transform.getWorldMatrix();
+	}
+	const glm::mat3& getNormalMatrix() const {
+		return transform.getNormalMatrix();
 	}
 	void DRAW(const LIGHT& light, const CAMERA& camera) {
-		GLuint VAO = 0, VBO = 0, CBO = 0, NBO = 0, TBO = 0;
-		glGenBuffers(1, &VBO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-		glGenBuffers(1, &NBO);
-		glBindBuffer(GL_ARRAY_BUFFER, NBO);
-		glBufferData(GL_ARRAY_BUFFER, normals.size() * sizeof(float), normals.data(), GL_STATIC_DRAW);
-
-		glGenVertexArrays(1, &VAO);
-		glBindVertexArray(VAO);
-
-		// vertices:
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-		glEnableVertexAttribArray(0);
-
-		//// normal:
-		glBindBuffer(GL_ARRAY_BUFFER, NBO);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-		glEnableVertexAttribArray(1);
+		UPROFILE_SCOPE("MODEL::DRAW");
+		mesh->BIND();
+		// Resolved here rather than in Init, so models can be created without a GL context
+		if (shaderFormat != mesh->format || shaderProgram == nullptr) {
+			setShaderProgram();
+		}
 
-		size_t vertexCount = vertices.size() / 3;
 		// 쉐이더 설정
-		glUseProgram(0);
-		glUseProgram(shaderProgram);
+		getGlState().USE_PROGRAM(shaderProgram->id);
 		// 모델 행렬 설정
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, _pos);
-		glm::mat4 rotationX = glm::rotate(glm::mat4(1.0f), glm::radians(_rotationAxis[0]), glm::vec3(1, 0, 0));
-		glm::mat4 rotationY = glm::rotate(glm::mat4(1.0f), glm::radians(_rotationAxis[1]), glm::vec3(0, 1, 0));
-		glm::mat4 rotationZ = glm::rotate(glm::mat4(1.0f), glm::radians(_rotationAxis[2]), glm::vec3(0, 0, 1));
-		glm::mat4 rotation = rotationZ * rotationY * rotationX;
-		model = model * rotation;
-		model = glm::scale(model, _scale);
-		int modelLocation = glGetUniformLocation(shaderProgram, "model");
-		glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(model));
+		glUniformMatrix4fv(shaderProgram->getLocation(UNIFORM::MODEL), 1, GL_FALSE, glm::value_ptr(getModelMatrix()));
+		glUniformMatrix3fv(shaderProgram->getLocation(UNIFORM::NORMAL_MATRIX), 1, GL_FALSE, glm::value_ptr(getNormalMatrix()));
 		// 뷰 행렬 설정
 		glm::mat4 view = camera.getViewMatrix();
-		int viewLocation = glGetUniformLocation(shaderProgram, "view");
-		glUniformMatrix4fv(viewLocation, 1, GL_FALSE, glm::value_ptr(view));
+		glUniformMatrix4fv(shaderProgram->getLocation(UNIFORM::VIEW), 1, GL_FALSE, glm::value_ptr(view));
 		// 투영 행렬 설정
 		glm::mat4 projection = camera.getProjectionMatrix();
-		int projectionLocation = glGetUniformLocation(shaderProgram, "projection");
-		glUniformMatrix4fv(projectionLocation, 1, GL_FALSE, glm::value_ptr(projection));
+		glUniformMatrix4fv(shaderProgram->getLocation(UNIFORM::PROJECTION), 1, GL_FALSE, glm::value_ptr(projection));
 		// Light position 설정
-		int lightPosLocation = glGetUniformLocation(shaderProgram, "lightPos");
-		glUniform3fv(lightPosLocation, 1, glm::value_ptr(light._pos));
+		glUniform3fv(shaderProgram->getLocation(UNIFORM::LIGHT_POS), 1, glm::value_ptr(light._pos));
 		// Light color 설정
-		int lightColorLocation = glGetUniformLocation(shaderProgram, "lightColor");
-		glUniform3fv(lightColorLocation, 1, glm::value_ptr(light._color));
+		glUniform3fv(shaderProgram->getLocation(UNIFORM::LIGHT_COLOR), 1, glm::value_ptr(light._color));
 		// Color 설정
-		int colorLocation = glGetUniformLocation(shaderProgram, "objectColor");
-		glUniform3fv(colorLocation, 1, glm::value_ptr(_color));
+		glUniform3fv(shaderProgram->getLocation(UNIFORM::OBJECT_COLOR), 1, glm::value_ptr(_color));
+		// Dequantization of 16-bit positions
+		glUniform3fv(shaderProgram->getLocation(UNIFORM::POSITION_OFFSET), 1, glm::value_ptr(mesh->getPositionOffset()));
+		glUniform3fv(shaderProgram->getLocation(UNIFORM::POSITION_SCALE), 1, glm::value_ptr(mesh->getPositionScale()));
 		// 그리기 실행
-		glBindVertexArray(VAO);
-		glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertexCount));
-		glBindVertexArray(0);
-		glUseProgram(0);
-		// 메모리 해제
-		glDeleteVertexArrays(1, &VAO);
-		glDeleteBuffers(1, &VBO);
-		glDeleteBuffers(1, &NBO);
+		RENDER_STATS& stats = getRenderStats();
+		if (mesh->indices.empty()) {
+			mesh->buffer.DRAW();
+			stats.trianglesDrawn += mesh->getTriangleCount();
+		}
+		else {
+			MESH_LOD range = mesh->getLod(lod);
+			mesh->buffer.DRAW(range.firstIndex, range.indexCount);
+			stats.trianglesDrawn += range.indexCount / 3;
+		}
+		// Program and VAO stay bound; the next model with the same ones skips both binds
+		stats.drawCalls += 1;
+		stats.instancesDrawn += 1;
 	}
 
 protected:
 	std::string name;
-	unsigned int shaderProgram = 0;
-	std::vector<float> vertices;
-	std::vector<float> normals;
-	std::vector<float> textures;
+	const SHADER_PROGRAM* shaderProgram = nullptr;
+	VERTEX_FORMAT shaderFormat; // vertex format shaderProgram was built for
+	std::shared_ptr<MESH> mesh = std::make_shared<MESH>();
 
 	glm::vec3 _color = { 1.0f, 1.0f, 1.0f };
 	glm::vec3 _pos = { 0.0f, 0.0f, 0.0f };
-	glm::vec3 _rotationAxis = { 0.0f, 0.0f, 0.0f };
-	glm::vec3 _scale = { 1.0f, 1.0f, 1.0f };
+	TRANSFORM transform; // drawn: position is _pos interpolated between physics steps
+	size_t lod = 0;
 
-	std::string ReadShaderFile(const std::string& filename) {
-		std::ifstream _file(filename);
-		if (!_file.is_open()) {
-			throw std::runtime_error("Failed to open shader file: " + filename);
+	AABB worldBounds;
+	glm::vec4 worldSphere = { 0.0f, 0.0f, 0.0f, 0.0f };
+	bool worldBoundsDirty = true;
+
+	// Box: center and absolute-value extent through the matrix. Sphere: around the local box, scaled by the longest axis.
+	void updateWorldBounds() {
+		if (!worldBoundsDirty) {
+			return;
+		}
+		AABB local = mesh->getTriangleBVH().getBounds();
+		const glm::mat4& matrix = getModelMatrix();
+		glm::vec3 center = glm::vec3(matrix * glm::vec4(local.getCenter(), 1.0f));
+		glm::vec3 halfExtent = (local.max - local.min) * 0.5f;
+		glm::vec3 extent(0.0f);
+		float maxScale = 0.0f;
+		for (int column = 0; column < 3; ++column) {
+			glm::vec3 axis = glm::vec3(matrix[column]);
+			extent += glm::abs(axis) * halfExtent[column];
+			maxScale = std::max(maxScale, glm::length(axis));
+		}
+		worldBounds = { center - extent, center + extent };
+		worldSphere = glm::vec4(center, glm::length(halfExtent) * maxScale);
+		worldBoundsDirty = false;
+	}
+
+	void notifyTransformChanged() {
+		worldBoundsDirty = true;
+		if (transformListener && !transformQueued) {
+			transformQueued = true;
+			transformListener->push_back(transformSlot);
 		}
-		std::stringstream _buffer;
-		_buffer << _file.rdbuf();
-		return _buffer.str();
 	}
 };
 
 struct CUBE : public MODEL
 {
 	void Init(const std::string&) final {
-		setShaderProgram();
-		vertices = {
+		mesh = getSharedMesh();
+		name = "Cube";
+	}
+
+	// Every cube draws the same unit geometry, so it is built once and shared
+	static std::shared_ptr<MESH> getSharedMesh() {
+		static std::shared_ptr<MESH> cubeMesh;
+		if (cubeMesh) {
+			return cubeMesh;
+		}
+		const std::vector<float> vertices = {
 			// Front face
 			-0.5f, -0.5f,  0.5f,  // Bottom-left
 			 0.5f, -0.5f,  0.5f,  // Bottom-right
@@ -555,7 +733,7 @@ struct CUBE : public MODEL
 			 -0.5f, -0.5f,  0.5f,  // Bottom-right
 			 -0.5f, -0.5f, -0.5f   // Top-right
 		};
-		normals = {
+		const std::vector<float> normals = {
 			// Front face normals (0.0, 0.0, 1.0)
 			0.0f,  0.0f,  1.0f,  // Bottom-left
 			0.0f,  0.0f,  1.0f,  // Bottom-right
@@ -604,21 +782,51 @@ struct CUBE : public MODEL
 			0.0f, -1.0f,  0.0f,  // Bottom-right
 			0.0f, -1.0f,  0.0f   // Top-right
 		};
-		name = "Cube";
+		// Welding leaves the 4 corners of each face: 24 vertices and 36 indices
+		cubeMesh = std::make_shared<MESH>();
+		getMeshLibrary().ADD("Cube", cubeMesh);
+		MESH_BUILDER builder(*cubeMesh);
+		const float uv[2] = { 0.0f, 0.0f };
+		for (size_t i = 0; i < vertices.size() / 3; ++i) {
+			builder.ADD_CORNER(&vertices[i * 3], &normals[i * 3], uv);
+		}
+		return cubeMesh;
 	}
 };
 
+// Shared between an import running on a worker thread and the editor showing it
+struct IMPORT_PROGRESS {
+	std::atomic<float> value{ 0.0f };
+	std::atomic<bool> cancelled{ false };
+};
+
 struct FBX : public MODEL
 {
-	void ProcessMesh(FbxMesh* mesh) {
+	IMPORT_PROGRESS* progress = nullptr; // set only while LOAD_MESH runs
+
+	FBX() = default;
+	// A loader for a worker thread, which must not read the editor's default format
+	explicit FBX(const VERTEX_FORMAT& format) : MODEL(std::make_shared<MESH>(format)) {}
+
+	// Bakes the node's global transform into positions and normals, so the whole file shares one space
+	void ProcessMesh(FbxMesh* mesh, MESH_BUILDER& builder, const glm::mat4& matrix) {
 		if (!mesh) return;
 
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t cornersBefore = builder.cornerCount;
+		size_t verticesBefore = this->mesh->getVertexCount();
+
 		FbxStringList uvSetNameList;
 		mesh->GetUVSetNames(uvSetNameList);
 		const char* uvSetName = uvSetNameList.GetCount() > 0 ? uvSetNameList.GetStringAt(0) : nullptr;
 
+		glm::mat3 normalMatrix = TRANSFORM::inverseTranspose(glm::mat3(matrix));
 		int polygonCount = mesh->GetPolygonCount();
 		for (int i = 0; i < polygonCount; i++) {
+			if ((i & 1023) == 0 && progress) {
+				if (isCancelled()) return;
+				reportProgress(polygonsDone + static_cast<size_t>(i));
+			}
 			int polygonSize = mesh->GetPolygonSize(i);
 
 			// Ensure the polygon is triangulated
@@ -632,48 +840,57 @@ struct FBX : public MODEL
 
 				// Process the vertex
 				FbxVector4 vertex = mesh->GetControlPointAt(controlPointIndex);
-				vertices.push_back(static_cast<float>(vertex[0]));
-				vertices.push_back(static_cast<float>(vertex[1]));
-				vertices.push_back(static_cast<float>(vertex[2]));
+				glm::vec3 point = glm::vec3(matrix * glm::vec4(static_cast<float>(vertex[0]), static_cast<float>(vertex[1]), static_cast<float>(vertex[2]), 1.0f));
+				float position[3] = { point.x, point.y, point.z };
 
 				// Process the normal
 				FbxVector4 normal;
 				mesh->GetPolygonVertexNormal(i, j, normal);
-				normals.push_back(static_cast<float>(normal[0]));
-				normals.push_back(static_cast<float>(normal[1]));
-				normals.push_back(static_cast<float>(normal[2]));
+				glm::vec3 direction = normalMatrix * glm::vec3(static_cast<float>(normal[0]), static_cast<float>(normal[1]), static_cast<float>(normal[2]));
+				float length = glm::length(direction);
+				if (length > 0.0f) {
+					direction /= length;
+				}
+				float normalValue[3] = { direction.x, direction.y, direction.z };
 
 				// Process the texture coordinates
+				float uvValue[2] = { 0.0f, 0.0f };
 				if (uvSetName) {
 					FbxVector2 uv;
 					bool unmappedUV;
 					if (mesh->GetPolygonVertexUV(i, j, uvSetName, uv, unmappedUV)) {
-						textures.push_back(static_cast<float>(uv[0]));
-						textures.push_back(1.0f - static_cast<float>(uv[1])); // Invert Y-axis for UV coordinates
+						uvValue[0] = static_cast<float>(uv[0]);
+						uvValue[1] = 1.0f - static_cast<float>(uv[1]); // Invert Y-axis for UV coordinates
 					}
-					else {
-						textures.push_back(0.0f);
-						textures.push_back(0.0f);
-					}
-				}
-				else {
-					textures.push_back(0.0f);
-					textures.push_back(0.0f);
 				}
+
+				builder.ADD_CORNER(position, normalValue, uvValue);
 			}
 		}
+		polygonsDone += static_cast<size_t>(polygonCount);
+
+		size_t corners = builder.cornerCount - cornersBefore;
+		size_t unique = this->mesh->getVertexCount() - verticesBefore;
+		size_t expandedBytes = corners * 8 * sizeof(float);
+		size_t indexedBytes = unique * 8 * sizeof(float) + corners * sizeof(uint32_t);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("[FBX] %s/%s: %zu corners -> %zu vertices, %.1f KB -> %.1f KB (%.1f KB saved), %.2f ms\n",
+			name.c_str(), mesh->GetName(), corners, unique, expandedBytes / 1024.0, indexedBytes / 1024.0,
+			(static_cast<double>(expandedBytes) - static_cast<double>(indexedBytes)) / 1024.0, ms);
 	}
 
-	void ProcessNode(FbxNode* node) {
-		if (!node) return;
+	// Records the node under parent in MESH::nodes, then its mesh and its children
+	void ProcessNode(FbxNode* node, MESH_BUILDER& builder, int32_t parent = -1) {
+		if (!node || isCancelled()) return;
 
+		int32_t index = addNode(node, parent);
 		FbxMesh* mesh = node->GetMesh();
 		if (mesh) {
 			FbxGeometryConverter geometryConverter(node->GetFbxManager());
 			FbxNodeAttribute* newAttribute = geometryConverter.Triangulate(mesh, true);
 			if (newAttribute && newAttribute->GetAttributeType() == FbxNodeAttribute::eMesh) {
 				FbxMesh* triangulatedMesh = static_cast<FbxMesh*>(newAttribute);
-				ProcessMesh(triangulatedMesh);
+				ProcessMesh(triangulatedMesh, builder, toMatrix(node->EvaluateGlobalTransform()));
 			}
 			else {
 				std::cerr << "Failed to triangulate mesh." << std::endl;
@@ -681,11 +898,12 @@ struct FBX : public MODEL
 		}
 
 		for (int i = 0; i < node->GetChildCount(); i++) {
-			ProcessNode(node->GetChild(i));
+			ProcessNode(node->GetChild(i), builder, index);
 		}
 	}
 
 	void LoadFbx(const std::string& filename) {
+		UPROFILE_SCOPE("FBX::LoadFbx");
 		FbxManager* manager = FbxManager::Create();
 		FbxIOSettings* ios = FbxIOSettings::Create(manager, IOSROOT);
 		manager->SetIOSettings(ios);
@@ -701,17 +919,373 @@ struct FBX : public MODEL
 		importer->Destroy();
 
 		FbxNode* rootNode = scene->GetRootNode();
-		if (rootNode) {
-			ProcessNode(rootNode);
+		polygonsTotal = countPolygons(rootNode);
+		polygonsDone = 0;
+		reportProgress(0);
+		if (rootNode && !isCancelled()) {
+			// One builder for the whole file, so vertices shared between nodes weld too
+			MESH_BUILDER builder(*mesh);
+			ProcessNode(rootNode, builder);
+			printf("[FBX] %s: %zu triangles, %zu vertices, %.1f KB (%.1f KB unindexed)\n", filename.c_str(),
+				mesh->getTriangleCount(), mesh->getVertexCount(), mesh->getMemoryBytes() / 1024.0, builder.getExpandedBytes() / 1024.0);
 		}
 
 		manager->Destroy();
 	}
 
+	// Reads the binary mesh cache when it is current, otherwise imports through the FBX SDK and writes it.
+	// Touches no GL state or editor settings, so it can run on a worker thread given copies of the LOD
+	// settings and vertex format; returns null when cancelled through importProgress.
+	std::shared_ptr<MESH> LOAD_MESH(const std::string& filename, IMPORT_PROGRESS* importProgress,
+		const LOD_SETTINGS& lodSettings, const VERTEX_FORMAT& format) {
+		name = filename;
+		progress = importProgress;
+		mesh = std::make_shared<MESH>(format);
+		if (!getMeshCache().LOAD(filename, *mesh)) {
+			LoadFbx(filename);
+			if (!isCancelled()) {
+				buildLods(lodSettings);
+				getMeshCache().SAVE(filename, *mesh);
+			}
+		}
+		bool cancelled = isCancelled();
+		progress = nullptr;
+		return cancelled ? nullptr : mesh;
+	}
+	// On the GL thread, with the editor's current settings
+	std::shared_ptr<MESH> LOAD_MESH(const std::string& filename) {
+		return LOAD_MESH(filename, nullptr, getLodSettings(), getDefaultVertexFormat());
+	}
+
 	void Init(const std::string& filename) final {
 		name = filename;
-		setShaderProgram();
-		LoadFbx(filename);
+		source = filename;
+		mesh = getMeshLibrary().FIND(filename);
+		if (!mesh) {
+			LOAD_MESH(filename);
+			getMeshLibrary().ADD(filename, mesh);
+		}
+		buildNodeTransforms();
+	}
+
+	size_t getNodeCount() const {
+		return nodeTransforms.size();
+	}
+	// Empty past the last node
+	const char* getNodeName(size_t index) const {
+		return index < mesh->nodes.size() ? mesh->nodes[index].name : "";
+	}
+	TRANSFORM* getNodeTransform(size_t index) final {
+		return index < nodeTransforms.size() ? nodeTransforms[index].get() : nullptr;
+	}
+
+	// File the mesh was imported from; the name starts out the same but can be edited
+	const std::string& getSource() const {
+		return source;
+	}
+
+private:
+	std::string source;
+	std::vector<std::unique_ptr<TRANSFORM>> nodeTransforms; // mirror mesh->nodes, roots under transform
+	size_t polygonsTotal = 0;
+	size_t polygonsDone = 0;
+
+	bool isCancelled() const {
+		return progress && progress->cancelled;
+	}
+	// The SDK import itself counts as the first 30%, welding the polygons as the next 60%, the LOD chain as the rest
+	void reportProgress(size_t polygons) {
+		if (progress) {
+			float welded = polygonsTotal > 0 ? static_cast<float>(polygons) / polygonsTotal : 1.0f;
+			progress->value = 0.3f + 0.6f * std::min(welded, 1.0f);
+		}
+	}
+	void buildLods(const LOD_SETTINGS& lodSettings) {
+		auto start = std::chrono::high_resolution_clock::now();
+		mesh->BUILD_LODS(lodSettings);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("[FBX] %s: %zu triangles, LODs", name.c_str(), mesh->getTriangleCount());
+		for (const MESH_LOD& lod : mesh->lods) {
+			printf(" %u (error %.4f)", lod.indexCount / 3, lod.error);
+		}
+		printf(", %.2f ms\n", ms);
+	}
+	int32_t addNode(FbxNode* node, int32_t parent) {
+		MESH_NODE record = {};
+		snprintf(record.name, sizeof(record.name), "%s", node->GetName());
+		record.parent = parent;
+		const FbxAMatrix& local = node->EvaluateLocalTransform();
+		FbxVector4 translation = local.GetT();
+		FbxVector4 rotation = local.GetR();
+		FbxVector4 scaling = local.GetS();
+		for (int i = 0; i < 3; ++i) {
+			record.position[i] = static_cast<float>(translation[i]);
+			record.rotation[i] = static_cast<float>(rotation[i]);
+			record.scale[i] = static_cast<float>(scaling[i]);
+		}
+		mesh->nodes.push_back(record);
+		return static_cast<int32_t>(mesh->nodes.size() - 1);
+	}
+	// FbxAMatrix rows are glm columns: both keep the translation in the fourth
+	static glm::mat4 toMatrix(const FbxAMatrix& matrix) {
+		glm::mat4 result(1.0f);
+		for (int column = 0; column < 4; ++column) {
+			for (int row = 0; row < 4; ++row) {
+				result[column][row] = static_cast<float>(matrix.Get(column, row));
+			}
+		}
+		return result;
+	}
+	void buildNodeTransforms() {
+		nodeTransforms.clear();
+		for (const MESH_NODE& node : mesh->nodes) {
+			auto nodeTransform = std::make_unique<TRANSFORM>();
+			nodeTransform->setPosition({ node.position[0], node.position[1], node.position[2] });
+			nodeTransform->setRotation({ node.rotation[0], node.rotation[1], node.rotation[2] });
+			nodeTransform->setScale({ node.scale[0], node.scale[1], node.scale[2] });
+			bool hasParent = node.parent >= 0 && static_cast<size_t>(node.parent) < nodeTransforms.size();
+			nodeTransform->setParent(hasParent ? nodeTransforms[node.parent].get() : &transform);
+			nodeTransforms.push_back(std::move(nodeTransform));
+		}
+	}
+	static size_t countPolygons(FbxNode* node) {
+		if (!node) return 0;
+		size_t count = node->GetMesh() ? static_cast<size_t>(node->GetMesh()->GetPolygonCount()) : 0;
+		for (int i = 0; i < node->GetChildCount(); i++) {
+			count += countPolygons(node->GetChild(i));
+		}
+		return count;
+	}
+};
+
+// Groups models by mesh and LOD level and submits each group as one instanced draw
+struct INSTANCED_RENDERER {
+	std::unordered_map<MESH*, std::vector<std::vector<INSTANCE_DATA>>> groups; // per mesh, instances per level
+
+	void DRAW(const std::vector<MODEL*>& models, const LIGHT& light, const CAMERA& camera) {
+		UPROFILE_SCOPE("INSTANCED_RENDERER::DRAW");
+		for (auto& [mesh, levels] : groups) {
+			for (auto& instances : levels) {
+				instances.clear();
+			}
+		}
+		for (MODEL* model : models) {
+			MESH* mesh = model->getMesh().get();
+			std::vector<std::vector<INSTANCE_DATA>>& levels = groups[mesh];
+			size_t level = std::min(model->getLod(), mesh->getLodCount() - 1);
+			if (levels.size() <= level) {
+				levels.resize(level + 1);
+			}
+			levels[level].push_back({ model->getModelMatrix(), model->getColor(), model->getNormalMatrix() });
+		}
+
+		// Meshes in different vertex formats need differently compiled programs
+		const SHADER_PROGRAM* program = nullptr;
+		glm::mat4 view = camera.getViewMatrix();
+		glm::mat4 projection = camera.getProjectionMatrix();
+		auto useProgram = [&](const VERTEX_FORMAT& format) {
+			const SHADER_PROGRAM* next = getShaderCache().GET("InstanceVertexShader.vert", "FragmentShader.frag", format.getDefines());
+			if (next == program) {
+				return;
+			}
+			program = next;
+			getGlState().USE_PROGRAM(program->id);
+			glUniformMatrix4fv(program->getLocation(UNIFORM::VIEW), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(program->getLocation(UNIFORM::PROJECTION), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3fv(program->getLocation(UNIFORM::LIGHT_POS), 1, glm::value_ptr(light._pos));
+			glUniform3fv(program->getLocation(UNIFORM::LIGHT_COLOR), 1, glm::value_ptr(light._color));
+		};
+
+		RENDER_STATS& stats = getRenderStats();
+		for (auto it = groups.begin(); it != groups.end();) {
+			MESH* mesh = it->first;
+			std::vector<std::vector<INSTANCE_DATA>>& levels = it->second;
+			// A mesh nobody drew this frame may already be destroyed, drop its group
+			if (std::all_of(levels.begin(), levels.end(), [](const auto& instances) { return instances.empty(); })) {
+				it = groups.erase(it);
+				continue;
+			}
+			mesh->BIND();
+			useProgram(mesh->format);
+			glUniform3fv(program->getLocation(UNIFORM::POSITION_OFFSET), 1, glm::value_ptr(mesh->getPositionOffset()));
+			glUniform3fv(program->getLocation(UNIFORM::POSITION_SCALE), 1, glm::value_ptr(mesh->getPositionScale()));
+			for (size_t level = 0; level < levels.size(); ++level) {
+				std::vector<INSTANCE_DATA>& instances = levels[level];
+				if (instances.empty()) {
+					continue;
+				}
+				mesh->buffer.UPLOAD_INSTANCES(instances);
+				GLsizei count = static_cast<GLsizei>(instances.size());
+				if (mesh->indices.empty()) {
+					mesh->buffer.DRAW_INSTANCED(count);
+					stats.trianglesDrawn += mesh->getTriangleCount() * instances.size();
+				}
+				else {
+					MESH_LOD range = mesh->getLod(level);
+					mesh->buffer.DRAW_INSTANCED(count, range.firstIndex, range.indexCount);
+					stats.trianglesDrawn += range.indexCount / 3 * instances.size();
+				}
+				stats.drawCalls += 1;
+				stats.instancesDrawn += instances.size();
+			}
+			++it;
+		}
+	}
+};
+
+// Draws the visible world out of the geometry arenas: one command per mesh and LOD level, instanced over the
+// models using it, and one glMultiDrawElementsIndirect per vertex format. Transforms and colors go to a
+// storage buffer the vertex shader indexes with the arena's draw index. Meshes without indices draw per model.
+struct INDIRECT_RENDERER {
+	std::unordered_map<MESH*, std::vector<std::vector<MODEL*>>> groups; // per mesh, models per level
+	std::vector<DRAW_ELEMENTS_INDIRECT_COMMAND> commands;
+	std::vector<DRAW_DATA> draws;
+	GLuint drawSSBO = 0;
+	GLuint commandBuffer = 0;
+
+	INDIRECT_RENDERER() = default;
+	INDIRECT_RENDERER(const INDIRECT_RENDERER&) = delete;
+	INDIRECT_RENDERER& operator=(const INDIRECT_RENDERER&) = delete;
+	~INDIRECT_RENDERER() {
+		RELEASE();
+	}
+
+	void DRAW(const std::vector<MODEL*>& models, const LIGHT& light, const CAMERA& camera) {
+		UPROFILE_SCOPE("INDIRECT_RENDERER::DRAW");
+		for (auto& [mesh, levels] : groups) {
+			for (auto& instances : levels) {
+				instances.clear();
+			}
+		}
+		for (MODEL* model : models) {
+			MESH* mesh = model->getMesh().get();
+			if (mesh->indices.empty()) {
+				model->DRAW(light, camera);
+				continue;
+			}
+			std::vector<std::vector<MODEL*>>& levels = groups[mesh];
+			size_t level = std::min(model->getLod(), mesh->getLodCount() - 1);
+			if (levels.size() <= level) {
+				levels.resize(level + 1);
+			}
+			levels[level].push_back(model);
+		}
+
+		// Uploads can grow an arena and move every range in it, so all of them come before the commands
+		GEOMETRY_ARENAS& arenas = getGeometryArenas();
+		arenas.COMPACT();
+		for (auto it = groups.begin(); it != groups.end();) {
+			// A mesh nobody drew this frame may already be destroyed, drop its group
+			if (std::all_of(it->second.begin(), it->second.end(), [](const auto& instances) { return instances.empty(); })) {
+				it = groups.erase(it);
+				continue;
+			}
+			it->first->BIND_ARENA();
+			++it;
+		}
+
+		struct BATCH {
+			GEOMETRY_ARENA* arena;
+			size_t firstCommand;
+			size_t commandCount;
+		};
+		std::vector<BATCH> batches;
+		commands.clear();
+		draws.clear();
+		RENDER_STATS& stats = getRenderStats();
+		for (auto& arena : arenas.arenas) {
+			size_t firstCommand = commands.size();
+			for (auto& [mesh, levels] : groups) {
+				const ARENA_RANGE& range = mesh->arenaRange;
+				if (range.arena != arena.get()) {
+					continue;
+				}
+				glm::vec3 offset = mesh->getPositionOffset();
+				glm::vec3 scale = mesh->getPositionScale();
+				for (size_t level = 0; level < levels.size(); ++level) {
+					const std::vector<MODEL*>& instances = levels[level];
+					if (instances.empty()) {
+						continue;
+					}
+					MESH_LOD lod = mesh->getLod(level);
+					commands.push_back({ lod.indexCount, static_cast<uint32_t>(instances.size()), range.firstIndex + lod.firstIndex,
+						static_cast<int32_t>(range.firstVertex), static_cast<uint32_t>(draws.size()) });
+					for (MODEL* model : instances) {
+						draws.push_back(makeDrawData(*model, offset, scale));
+					}
+					stats.trianglesDrawn += lod.indexCount / 3 * instances.size();
+					stats.instancesDrawn += instances.size();
+				}
+			}
+			if (commands.size() > firstCommand) {
+				batches.push_back({ arena.get(), firstCommand, commands.size() - firstCommand });
+			}
+		}
+		if (batches.empty()) {
+			return;
+		}
+
+		GL_STATE& state = getGlState();
+		if (drawSSBO == 0) {
+			glGenBuffers(1, &drawSSBO);
+			glGenBuffers(1, &commandBuffer);
+			stats.buffersCreated += 2;
+		}
+		// Orphaned every frame, the driver hands out fresh storage instead of waiting on last frame's draws
+		state.BIND_BUFFER(GL_SHADER_STORAGE_BUFFER, drawSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(draws.size() * sizeof(DRAW_DATA)), draws.data(), GL_STREAM_DRAW);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, drawSSBO);
+		state.BIND_BUFFER(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBufferData(GL_DRAW_INDIRECT_BUFFER, static_cast<GLsizeiptr>(commands.size() * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND)), commands.data(), GL_STREAM_DRAW);
+		stats.bytesUploaded += draws.size() * sizeof(DRAW_DATA) + commands.size() * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND);
+
+		glm::mat4 view = camera.getViewMatrix();
+		glm::mat4 projection = camera.getProjectionMatrix();
+		for (const BATCH& batch : batches) {
+			const SHADER_PROGRAM* program = getShaderCache().GET("IndirectVertexShader.vert", "FragmentShader.frag", batch.arena->format.getDefines());
+			state.USE_PROGRAM(program->id);
+			glUniformMatrix4fv(program->getLocation(UNIFORM::VIEW), 1, GL_FALSE, glm::value_ptr(view));
+			glUniformMatrix4fv(program->getLocation(UNIFORM::PROJECTION), 1, GL_FALSE, glm::value_ptr(projection));
+			glUniform3fv(program->getLocation(UNIFORM::LIGHT_POS), 1, glm::value_ptr(light._pos));
+			glUniform3fv(program->getLocation(UNIFORM::LIGHT_COLOR), 1, glm::value_ptr(light._color));
+			batch.arena->RESERVE_DRAW_INDICES(static_cast<uint32_t>(draws.size()));
+			state.BIND_VERTEX_ARRAY(batch.arena->VAO);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(batch.firstCommand * sizeof(DRAW_ELEMENTS_INDIRECT_COMMAND)),
+				static_cast<GLsizei>(batch.commandCount), 0);
+			stats.drawCalls += 1;
+		}
+	}
+
+	// Before the context goes away
+	void RELEASE() {
+		groups.clear();
+		if (drawSSBO == 0) {
+			return;
+		}
+		GL_STATE& state = getGlState();
+		state.FORGET_BUFFER(drawSSBO);
+		state.FORGET_BUFFER(commandBuffer);
+		glDeleteBuffers(1, &drawSSBO);
+		glDeleteBuffers(1, &commandBuffer);
+		getRenderStats().buffersDeleted += 2;
+		drawSSBO = commandBuffer = 0;
+	}
+
+private:
+	// model * translate(offset) * scale(scale), so positions are read exactly as the arena stores them
+	static DRAW_DATA makeDrawData(const MODEL& model, const glm::vec3& offset, const glm::vec3& scale) {
+		const glm::mat4& matrix = model.getModelMatrix();
+		const glm::mat3& normal = model.getNormalMatrix();
+		DRAW_DATA data;
+		data.model[0] = matrix[0] * scale.x;
+		data.model[1] = matrix[1] * scale.y;
+		data.model[2] = matrix[2] * scale.z;
+		data.model[3] = matrix * glm::vec4(offset, 1.0f);
+		for (int column = 0; column < 3; ++column) {
+			data.normalMatrix[column] = glm::vec4(normal[column], 0.0f);
+		}
+		data.color = glm::vec4(model.getColor(), 1.0f);
+		return data;
 	}
 };
 
@@ -0,0 +1,222 @@
+#ifndef __UGLSTATE_HPP__
+#define __UGLSTATE_HPP__
+#include "UPHYSIC.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+enum class GL_CALL : uint8_t {
+	USE_PROGRAM,
+	BIND_VERTEX_ARRAY,
+	BIND_BUFFER,
+	CAPABILITY,   // glEnable / glDisable
+	CLIENT_STATE, // glEnableClientState / glDisableClientState
+	LIGHT,        // glLightfv
+	COUNT
+};
+
+inline const char* getGlCallName(GL_CALL call) {
+	switch (call) {
+	case GL_CALL::USE_PROGRAM: return "UseProgram";
+	case GL_CALL::BIND_VERTEX_ARRAY: return "BindVertexArray";
+	case GL_CALL::BIND_BUFFER: return "BindBuffer";
+	case GL_CALL::CAPABILITY: return "Enable/Disable";
+	case GL_CALL::CLIENT_STATE: return "ClientState";
+	case GL_CALL::LIGHT: return "Light";
+	default: return "Unknown";
+	}
+}
+
+// Calls that reached the driver and calls the cache dropped, per type
+struct GL_CALL_COUNTS {
+	size_t issued[static_cast<size_t>(GL_CALL::COUNT)] = {};
+	size_t skipped[static_cast<size_t>(GL_CALL::COUNT)] = {};
+
+	void RESET() {
+		*this = GL_CALL_COUNTS();
+	}
+	size_t getIssued() const {
+		size_t total = 0;
+		for (size_t count : issued) {
+			total += count;
+		}
+		return total;
+	}
+	size_t getSkipped() const {
+		size_t total = 0;
+		for (size_t count : skipped) {
+			total += count;
+		}
+		return total;
+	}
+	GL_CALL_COUNTS& operator+=(const GL_CALL_COUNTS& other) {
+		for (size_t i = 0; i < static_cast<size_t>(GL_CALL::COUNT); ++i) {
+			issued[i] += other.issued[i];
+			skipped[i] += other.skipped[i];
+		}
+		return *this;
+	}
+};
+
+// Shadow of the binds and switches the engine makes every frame; a call that would leave GL as it is
+// never reaches the driver. Only the thread owning the context may use it. Code that changes this state
+// behind the cache (ImGui, GLUT shapes, a new context) must FORGET or INVALIDATE what it touched.
+struct GL_STATE {
+	static constexpr GLuint UNKNOWN = ~0u;
+
+	GL_CALL_COUNTS calls; // cleared with the render stats every frame
+
+	void USE_PROGRAM(GLuint id) {
+		if (change(program, id, GL_CALL::USE_PROGRAM)) {
+			glUseProgram(id);
+		}
+	}
+	void BIND_VERTEX_ARRAY(GLuint id) {
+		if (change(vertexArray, id, GL_CALL::BIND_VERTEX_ARRAY)) {
+			glBindVertexArray(id);
+		}
+	}
+	// The element array binding belongs to the bound VAO, so it is passed through rather than cached
+	void BIND_BUFFER(GLenum target, GLuint id) {
+		if (target == GL_ELEMENT_ARRAY_BUFFER) {
+			count(GL_CALL::BIND_BUFFER, true);
+			glBindBuffer(target, id);
+		}
+		else if (change(find(buffers, target, UNKNOWN), id, GL_CALL::BIND_BUFFER)) {
+			glBindBuffer(target, id);
+		}
+	}
+	void ENABLE(GLenum capability) {
+		if (change(find(capabilities, capability, UNKNOWN), GL_TRUE, GL_CALL::CAPABILITY)) {
+			glEnable(capability);
+		}
+	}
+	void DISABLE(GLenum capability) {
+		if (change(find(capabilities, capability, UNKNOWN), GL_FALSE, GL_CALL::CAPABILITY)) {
+			glDisable(capability);
+		}
+	}
+	void ENABLE_CLIENT_STATE(GLenum array) {
+		if (change(find(clientStates, array, UNKNOWN), GL_TRUE, GL_CALL::CLIENT_STATE)) {
+			glEnableClientState(array);
+		}
+	}
+	void DISABLE_CLIENT_STATE(GLenum array) {
+		if (change(find(clientStates, array, UNKNOWN), GL_FALSE, GL_CALL::CLIENT_STATE)) {
+			glDisableClientState(array);
+		}
+	}
+	// Positions and spot directions are stored in eye space through the current modelview, so they are
+	// always issued; colors and attenuation are cached. Spot cutoff, spot exponent and the attenuations
+	// read a single float, the colors four
+	static size_t getLightValueCount(GLenum parameter) {
+		switch (parameter) {
+		case GL_SPOT_EXPONENT:
+		case GL_SPOT_CUTOFF:
+		case GL_CONSTANT_ATTENUATION:
+		case GL_LINEAR_ATTENUATION:
+		case GL_QUADRATIC_ATTENUATION:
+			return 1;
+		default:
+			return 4;
+		}
+	}
+	void SET_LIGHT(GLenum light, GLenum parameter, const GLfloat* value) {
+		if (parameter != GL_POSITION && parameter != GL_SPOT_DIRECTION) {
+			size_t size = getLightValueCount(parameter) * sizeof(GLfloat);
+			GLuint key = light * 0x10000u + parameter;
+			auto it = std::find_if(lights.begin(), lights.end(), [key](const LIGHT_VALUE& entry) { return entry.key == key; });
+			if (it != lights.end() && std::memcmp(it->value, value, size) == 0) {
+				count(GL_CALL::LIGHT, false);
+				return;
+			}
+			if (it == lights.end()) {
+				lights.push_back({ key });
+				it = lights.end() - 1;
+			}
+			std::memcpy(it->value, value, size);
+		}
+		count(GL_CALL::LIGHT, true);
+		glLightfv(light, parameter, value);
+	}
+
+	// Immediate mode, client arrays and GLUT shapes need no program, no VAO and no array buffer
+	void USE_FIXED_FUNCTION() {
+		USE_PROGRAM(0);
+		BIND_VERTEX_ARRAY(0);
+		BIND_BUFFER(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Deleting a bound VAO or buffer reverts its binding to 0; a deleted program stays in use until replaced
+	void FORGET_VERTEX_ARRAY(GLuint id) {
+		if (vertexArray == id) {
+			vertexArray = 0;
+		}
+	}
+	void FORGET_BUFFER(GLuint id) {
+		for (auto& [target, bound] : buffers) {
+			if (bound == id) {
+				bound = 0;
+			}
+		}
+	}
+	void FORGET_PROGRAM(GLuint id) {
+		if (program == id) {
+			program = UNKNOWN;
+		}
+	}
+	void FORGET_CAPABILITY(GLenum capability) {
+		find(capabilities, capability, UNKNOWN) = UNKNOWN;
+	}
+	void INVALIDATE() {
+		program = vertexArray = UNKNOWN;
+		buffers.clear();
+		capabilities.clear();
+		clientStates.clear();
+		lights.clear();
+	}
+
+private:
+	using STATE_LIST = std::vector<std::pair<GLenum, GLuint>>;
+	struct LIGHT_VALUE {
+		GLuint key;
+		GLfloat value[4] = {};
+	};
+
+	GLuint program = UNKNOWN;
+	GLuint vertexArray = UNKNOWN;
+	STATE_LIST buffers;      // target -> buffer
+	STATE_LIST capabilities; // capability -> GL_TRUE / GL_FALSE
+	STATE_LIST clientStates;
+	std::vector<LIGHT_VALUE> lights;
+
+	// A handful of entries each, a linear scan beats hashing
+	static GLuint& find(STATE_LIST& list, GLenum key, GLuint initial) {
+		for (auto& [entry, value] : list) {
+			if (entry == key) {
+				return value;
+			}
+		}
+		list.emplace_back(key, initial);
+		return list.back().second;
+	}
+	bool change(GLuint& current, GLuint value, GL_CALL call) {
+		bool changed = current != value;
+		count(call, changed);
+		current = value;
+		return changed;
+	}
+	void count(GL_CALL call, bool issued) {
+		size_t index = static_cast<size_t>(call);
+		issued ? ++calls.issued[index] : ++calls.skipped[index];
+	}
+};
+
+inline GL_STATE& getGlState() {
+	static GL_STATE state;
+	return state;
+}
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef __UHEADLESS_HPP__
+#define __UHEADLESS_HPP__
+#include "UGL.hpp"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#if defined(UHEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(UHEADLESS_OSMESA)
+#include <GL/osmesa.h>
+#endif
+
+enum class FRAME_PHASE {
+	SYNC,    // physics snapshot interpolation
+	HELPERS, // axis, grid and collider overlays
+	WORLD,   // culling, LOD selection and model submission
+	IMPORT,  // finishing background imports
+	GUI,     // editor windows, interactive only
+	GPU,     // waiting for the GPU (headless) or the buffer swap
+	COUNT
+};
+
+inline const char* getFramePhaseName(FRAME_PHASE phase) {
+	static const char* names[] = { "sync", "helpers", "world", "import", "gui", "gpu" };
+	return names[static_cast<size_t>(phase)];
+}
+
+// Lap timer over the phases of engineLoop. Every frame is timed; samples are only kept while recording,
+// so the interactive editor does not grow them forever.
+struct FRAME_TIMINGS {
+	bool recording = false;
+	std::vector<double> samples[static_cast<size_t>(FRAME_PHASE::COUNT) + 1]; // ms, the last one is the frame total
+
+	void BEGIN() {
+		std::fill(std::begin(current), std::end(current), 0.0);
+		last = std::chrono::high_resolution_clock::now();
+		frameStart = last;
+	}
+	// Charges the time since the previous LAP (or BEGIN) to phase
+	void LAP(FRAME_PHASE phase) {
+		auto now = std::chrono::high_resolution_clock::now();
+		current[static_cast<size_t>(phase)] += std::chrono::duration<double, std::milli>(now - last).count();
+		last = now;
+	}
+	void END() {
+		current[static_cast<size_t>(FRAME_PHASE::COUNT)] = std::chrono::duration<double, std::milli>(last - frameStart).count();
+		if (recording) {
+			for (size_t i = 0; i <= static_cast<size_t>(FRAME_PHASE::COUNT); ++i) {
+				samples[i].push_back(current[i]);
+			}
+		}
+	}
+	void CLEAR() {
+		for (auto& phase : samples) {
+			phase.clear();
+		}
+	}
+	double getLast(FRAME_PHASE phase) const {
+		return current[static_cast<size_t>(phase)];
+	}
+
+	// Nearest rank percentile, p in [0, 100]
+	static double getPercentile(std::vector<double> values, double p) {
+		if (values.empty()) {
+			return 0.0;
+		}
+		size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * values.size()));
+		size_t index = std::min(std::max<size_t>(rank, 1), values.size()) - 1;
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	// {"sync": {"mean": .., "p50": .., "p90": .., "p99": .., "max": ..}, ..., "frame": {...}}
+	std::string TO_JSON(int indent) const {
+		std::string pad(indent, ' ');
+		std::ostringstream out;
+		out << "{\n";
+		for (size_t i = 0; i <= static_cast<size_t>(FRAME_PHASE::COUNT); ++i) {
+			const std::vector<double>& values = samples[i];
+			double sum = 0.0;
+			for (double value : values) {
+				sum += value;
+			}
+			char line[256];
+			snprintf(line, sizeof(line), "%s  \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+				pad.c_str(), i < static_cast<size_t>(FRAME_PHASE::COUNT) ? getFramePhaseName(static_cast<FRAME_PHASE>(i)) : "frame",
+				values.empty() ? 0.0 : sum / values.size(), getPercentile(values, 50.0), getPercentile(values, 90.0),
+				getPercentile(values, 99.0), getPercentile(values, 100.0), i < static_cast<size_t>(FRAME_PHASE::COUNT) ? "," : "");
+			out << line;
+		}
+		out << pad << "}";
+		return out.str();
+	}
+
+private:
+	double current[static_cast<size_t>(FRAME_PHASE::COUNT) + 1] = {};
+	std::chrono::high_resolution_clock::time_point last;
+	std::chrono::high_resolution_clock::time_point frameStart;
+};
+
+// --headless [frames] options
+struct HEADLESS_OPTIONS {
+	int frames = 300;
+	int warmupFrames = 10;
+	int width = 1280;
+	int height = 720;
+	int cubes = 0;                  // grid of cubes added to the scene
+	std::vector<std::string> files; // FBX files imported into the scene
+	std::string jsonPath;           // stdout when empty
+	std::string imagePath;          // final framebuffer as binary PPM, skipped when empty
+	std::string tracePath;          // Chrome trace of the profiler markers, skipped when empty
+	bool physics = false;           // run the physics thread during the frames
+	RENDER_MODE mode = RENDER_MODE::INDIRECT;
+
+	// Reads the options following --headless at argv[first]; false on a malformed option
+	bool PARSE(int argc, char** argv, int first) {
+		int i = first + 1;
+		if (i < argc && argv[i][0] != '-') {
+			frames = std::max(std::atoi(argv[i++]), 1);
+		}
+		for (; i < argc; ++i) {
+			std::string option = argv[i];
+			bool hasValue = i + 1 < argc;
+			if (option == "--size" && hasValue && std::sscanf(argv[i + 1], "%dx%d", &width, &height) == 2) {
+				++i;
+			}
+			else if (option == "--warmup" && hasValue) {
+				warmupFrames = std::max(std::atoi(argv[++i]), 0);
+			}
+			else if (option == "--cubes" && hasValue) {
+				cubes = std::max(std::atoi(argv[++i]), 0);
+			}
+			else if (option == "--fbx" && hasValue) {
+				files.push_back(argv[++i]);
+			}
+			else if (option == "--json" && hasValue) {
+				jsonPath = argv[++i];
+			}
+			else if (option == "--dump" && hasValue) {
+				imagePath = argv[++i];
+			}
+			else if (option == "--trace" && hasValue) {
+				tracePath = argv[++i];
+			}
+			else if (option == "--physics") {
+				physics = true;
+			}
+			else if (option == "--mode" && hasValue && parseMode(argv[i + 1])) {
+				++i;
+			}
+			else {
+				std::cerr << "Unknown headless option " << option << std::endl;
+				return false;
+			}
+		}
+		return width > 0 && height > 0;
+	}
+
+private:
+	bool parseMode(const std::string& name) {
+		for (int i = 0; i < static_cast<int>(RENDER_MODE::COUNT); ++i) {
+			if (name == getRenderModeName(static_cast<RENDER_MODE>(i))) {
+				mode = static_cast<RENDER_MODE>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+// Camera orbiting the scene bounds once over the run, the same path every run so frames compare across builds
+struct HEADLESS_CAMERA_PATH {
+	glm::vec3 center = glm::vec3(0.0f);
+	float radius = 10.0f;
+
+	void SET(const std::vector<MODEL*>& models) {
+		if (models.empty()) {
+			return;
+		}
+		AABB bounds = models[0]->getWorldBounds();
+		for (auto& model : models) {
+			bounds = bounds.merge(model->getWorldBounds());
+		}
+		center = bounds.getCenter();
+		radius = std::max(glm::length(bounds.max - bounds.min) * 0.5f, 1.0f);
+	}
+	void APPLY(CAMERA& camera, int frame, int frames) const {
+		float angle = 2.0f * static_cast<float>(M_PI) * frame / std::max(frames, 1);
+		// Far enough for the bounding sphere to fit the vertical field of view
+		float distance = radius / std::sin(glm::radians(camera._fovy) * 0.5f);
+		camera._eye = center + glm::vec3(std::cos(angle), 0.5f, std::sin(angle)) * distance;
+		camera._front = glm::normalize(center - camera._eye);
+	}
+};
+
+// Offscreen GL context for machines without a display or GPU. Built with UHEADLESS_EGL (link EGL; Mesa's
+// surfaceless platform runs on llvmpipe) or UHEADLESS_OSMESA (link OSMesa); without either CREATE fails.
+// Both render into an FBO of the requested size, read back by SAVE_IMAGE.
+struct HEADLESS_CONTEXT {
+	int width = 0;
+	int height = 0;
+	GLuint framebuffer = 0;
+	GLuint colorBuffer = 0;
+	GLuint depthBuffer = 0;
+
+	HEADLESS_CONTEXT() = default;
+	HEADLESS_CONTEXT(const HEADLESS_CONTEXT&) = delete;
+	HEADLESS_CONTEXT& operator=(const HEADLESS_CONTEXT&) = delete;
+	~HEADLESS_CONTEXT() {
+		DESTROY();
+	}
+
+	bool CREATE(int width, int height) {
+		this->width = width;
+		this->height = height;
+		if (!createContext()) {
+			return false;
+		}
+		glewExperimental = GL_TRUE;
+		GLenum status = glewInit();
+		// GLEW built for GLX still loads the core entry points, then fails looking for a GLX display
+		if (status != GLEW_OK && status != GLEW_ERROR_NO_GLX_DISPLAY) {
+			std::cerr << "glewInit failed: " << glewGetErrorString(status) << std::endl;
+			return false;
+		}
+		glGenFramebuffers(1, &framebuffer);
+		glGenRenderbuffers(1, &colorBuffer);
+		glGenRenderbuffers(1, &depthBuffer);
+		glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Offscreen framebuffer incomplete" << std::endl;
+			return false;
+		}
+		glViewport(0, 0, width, height);
+		// Whatever the cache holds belongs to another context
+		getGlState().INVALIDATE();
+		return true;
+	}
+
+	void DESTROY() {
+		if (framebuffer != 0) {
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteRenderbuffers(1, &colorBuffer);
+			glDeleteRenderbuffers(1, &depthBuffer);
+			framebuffer = colorBuffer = depthBuffer = 0;
+		}
+#if defined(UHEADLESS_EGL)
+		if (display != EGL_NO_DISPLAY) {
+			eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+			if (context != EGL_NO_CONTEXT) {
+				eglDestroyContext(display, context);
+			}
+			eglTerminate(display);
+			display = EGL_NO_DISPLAY;
+			context = EGL_NO_CONTEXT;
+		}
+#elif defined(UHEADLESS_OSMESA)
+		if (context) {
+			OSMesaDestroyContext(context);
+			context = nullptr;
+		}
+#endif
+	}
+
+	std::string getRenderer() const {
+		const GLubyte* renderer = glGetString(GL_RENDERER);
+		const GLubyte* version = glGetString(GL_VERSION);
+		return std::string(renderer ? reinterpret_cast<const char*>(renderer) : "?") + " / " + (version ? reinterpret_cast<const char*>(version) : "?");
+	}
+
+	// Binary PPM, top row first
+	bool SAVE_IMAGE(const std::string& path) const {
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 3);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+		std::ofstream out(path, std::ios::binary);
+		if (!out) {
+			std::cerr << "Failed to write " << path << std::endl;
+			return false;
+		}
+		out << "P6\n" << width << " " << height << "\n255\n";
+		size_t row = static_cast<size_t>(width) * 3;
+		for (int y = height - 1; y >= 0; --y) {
+			out.write(reinterpret_cast<const char*>(&pixels[y * row]), static_cast<std::streamsize>(row));
+		}
+		return static_cast<bool>(out);
+	}
+
+private:
+#if defined(UHEADLESS_EGL)
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	bool createContext() {
+		auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+		if (getPlatformDisplay) {
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+		if (display == EGL_NO_DISPLAY) {
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		}
+		EGLint major = 0, minor = 0;
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+			std::cerr << "No EGL display" << std::endl;
+			display = EGL_NO_DISPLAY;
+			return false;
+		}
+		// Desktop GL without a profile request: the compatibility context the fixed function overlays need
+		eglBindAPI(EGL_OPENGL_API);
+		const EGLint configAttributes[] = { EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			std::cerr << "No EGL config with desktop OpenGL" << std::endl;
+			return false;
+		}
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+		if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+			std::cerr << "Failed to create a surfaceless EGL context" << std::endl;
+			return false;
+		}
+		return true;
+	}
+#elif defined(UHEADLESS_OSMESA)
+	OSMesaContext context = nullptr;
+	std::vector<uint8_t> osmesaBuffer; // OSMesa's own surface, unused behind the FBO but required by MakeCurrent
+
+	bool createContext() {
+		context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, nullptr);
+		osmesaBuffer.resize(static_cast<size_t>(width) * height * 4);
+		if (!context || !OSMesaMakeCurrent(context, osmesaBuffer.data(), GL_UNSIGNED_BYTE, width, height)) {
+			std::cerr << "Failed to create an OSMesa context" << std::endl;
+			return false;
+		}
+		return true;
+	}
+#else
+	bool createContext() {
+		std::cerr << "Built without headless support; define UHEADLESS_EGL or UHEADLESS_OSMESA" << std::endl;
+		return false;
+	}
+#endif
+};
+
+#endif
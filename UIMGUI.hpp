@@ -4,19 +4,43 @@
 #include "backends/imgui_impl_glut.h"
 #include "backends/imgui_impl_opengl3.h"
 #include "UGL.hpp"
+#include "UENTITY.hpp"
+#include "UIMPORT.hpp"
+#include "UPICK.hpp"
+#include "UCULL.hpp"
+#include "UNARROWPHASE.hpp"
+#include "UISLAND.hpp"
+#include "USOLVER.hpp"
+#include "USCENE.hpp"
 
 
 struct EDITOR {
 	std::vector<LIGHT> lights = {LIGHT()};
-	std::vector<std::shared_ptr<MODEL>> models;
-	std::shared_ptr<MODEL> selectedModel = nullptr;
+	ENTITY_STORE entities;
+	ENTITY_HANDLE selected; // null when nothing is selected
 	std::string currentPath;
 	std::shared_ptr<CAMERA> camera;
+	INSTANCED_RENDERER instancedRenderer;
+	INDIRECT_RENDERER indirectRenderer;
+	RENDER_BENCHMARK renderBenchmark;
+	std::unique_ptr<BROADPHASE> broadphase = createBroadphase(BROADPHASE_TYPE::SWEEP_AND_PRUNE);
+	NARROWPHASE narrowphase;
+	SIMULATION_ISLANDS islands;
+	CONTACT_SOLVER solver;
+	IMPORT_QUEUE importQueue;
+	GRID grid;
+	SCENE_PICKER picker;
+	FRUSTUM_CULLER culler;
 	bool fileBrowser = false;
 	bool colliderView = true;
 	bool axisView = true;
 	bool gridView = true;
 	bool modelView = true;
+	RENDER_MODE renderMode = RENDER_MODE::INDIRECT;
+	bool culling = true;
+	bool profilerView = false;
+	// Last member, so the thread is joined before anything it touches is destroyed
+	PHYSICS_THREAD physicsThread;
 };
 
 struct KEYBOARD {
@@ -77,21 +101,10 @@ struct MOUSE {
 		else if (button == GLUT_LEFT_BUTTON) {
 			if (state == GLUT_DOWN) {
 				select(x, y, editor);
-				for (auto& model : editor.models) {
-					if (model != editor.selectedModel)
-						continue;
+				if (GIZMO* gizmo = editor.entities.getGizmo(editor.selected)) {
 					glm::vec2 mousePos = glm::vec2(x, y);
-					if (model->axisX->isHovered(mousePos, *editor.camera)) {
-						glm::vec3 pos = model->axisX->drag(mousePos, *editor.camera);
-						model->setProperty_Position(pos);
-					}
-					else if (model->axisY->isHovered(mousePos, *editor.camera)) {
-						glm::vec3 pos = model->axisY->drag(mousePos, *editor.camera);
-						model->setProperty_Position(pos);
-					}
-					else if (model->axisZ->isHovered(mousePos, *editor.camera)) {
-						glm::vec3 pos = model->axisZ->drag(mousePos, *editor.camera);
-						model->setProperty_Position(pos);
+					if (MODEL_AXIS* axis = gizmo->getHovered(mousePos, *editor.camera)) {
+						editor.entities.setPosition(editor.selected, axis->drag(mousePos, *editor.camera));
 					}
 				}
 			}
@@ -110,11 +123,12 @@ struct MOUSE {
 		glm::vec3 rayDirection = glm::vec3(glm::inverse(editor.camera->getViewMatrix()) * rayEye);
 		rayDirection = glm::normalize(rayDirection);
 
-		for (auto& model : editor.models) {
-			if (model->InterSection(rayOrigin, rayDirection)) {
-				editor.selectedModel = model;
-				break;
-			}
+		PICK_RESULT hit = editor.picker.PICK(editor.entities.getModels(), rayOrigin, rayDirection);
+		if (hit.isHit()) {
+			editor.selected = editor.entities.getEntity(hit.model);
+			printf("Picked %s: distance %.3f, triangle %u, barycentric (%.2f, %.2f, %.2f), %.3f ms\n",
+				editor.entities.getModels()[hit.model]->getName().c_str(), hit.distance, hit.triangle,
+				hit.barycentric.x, hit.barycentric.y, hit.barycentric.z, editor.picker.time);
 		}
 	}
 
@@ -153,6 +167,10 @@ struct IMGUI {
 
     float buttonWidth = 150;
     float buttonHeight = 25;
+	PROFILE_HISTORY profileHistory;
+	std::string traceStatus;
+	char scenePath[256] = "scene.uscn";
+	std::string sceneStatus;
 
 	~IMGUI() {
 		ImGui_ImplOpenGL3_Shutdown();
@@ -175,8 +193,234 @@ struct IMGUI {
 		ImGui::Checkbox("Model View", &editor.modelView);
 		ImGui::Checkbox("Collider View", &editor.colliderView);
 		ImGui::Checkbox("Grid View", &editor.gridView);
+		if (editor.gridView) {
+			int cells = editor.grid.cellCount;
+			float size = editor.grid.cellSize;
+			bool changed = ImGui::SliderInt("Grid Cells", &cells, 1, 1000);
+			changed |= ImGui::InputFloat("Grid Spacing", &size);
+			if (changed) {
+				editor.grid.SET(cells, size);
+			}
+		}
 		ImGui::Checkbox("Axis View", &editor.axisView);
+		drawRenderMode(editor);
+		ImGui::Checkbox("Frustum Culling", &editor.culling);
+		if (editor.culling) {
+			ImGui::Text("Visible: %zu / %zu, culled %zu (%.3f ms)", editor.culler.visible.size(), editor.culler.tested, editor.culler.culled, editor.culler.time);
+		}
+		drawVertexFormat();
+		drawLod();
+		ImGui::Checkbox("Profiler", &editor.profilerView);
     }
+	void drawRenderMode(EDITOR& editor) {
+		const char* names[] = { "Per Model", "Instanced", "Multi-Draw Indirect" };
+		int current = static_cast<int>(editor.renderMode);
+		if (ImGui::Combo("Submission", &current, names, static_cast<int>(RENDER_MODE::COUNT))) {
+			editor.renderMode = static_cast<RENDER_MODE>(current);
+		}
+		if (editor.renderMode != RENDER_MODE::INDIRECT) {
+			return;
+		}
+		if (!GEOMETRY_ARENAS::isSupported()) {
+			ImGui::Text("Needs OpenGL 4.3, drawing instanced");
+			return;
+		}
+		for (auto& arena : getGeometryArenas().arenas) {
+			ImGui::Text("Arena %zu B/vertex: %zu meshes, %.1f / %.1f KB, %zu + %zu holes", arena->format.getStride(), arena->getRangeCount(),
+				arena->getUsedBytes() / 1024.0, arena->getCapacityBytes() / 1024.0, arena->vertexSpace.blocks.size(), arena->indexSpace.blocks.size());
+		}
+		if (ImGui::Button("Defragment")) {
+			for (auto& arena : getGeometryArenas().arenas) {
+				arena->DEFRAGMENT();
+			}
+		}
+	}
+	void drawLod() {
+		LOD_SETTINGS& settings = getLodSettings();
+		ImGui::Checkbox("LOD", &settings.enabled);
+		if (!settings.enabled) {
+			return;
+		}
+		ImGui::SliderFloat("LOD Hysteresis", &settings.hysteresis, 0.0f, 0.5f);
+		for (size_t i = 0; i < settings.screenSizes.size(); ++i) {
+			std::string label = "LOD " + std::to_string(i + 1) + " below";
+			ImGui::SliderFloat(label.c_str(), &settings.screenSizes[i], 0.0f, 1.0f);
+		}
+	}
+	void drawVertexFormat() {
+		const char* names[] = { "Float32 (32 B/vertex)", "Compact (16 B/vertex)" };
+		const VERTEX_FORMAT formats[] = { VERTEX_FORMAT::FULL(), VERTEX_FORMAT::COMPACT() };
+		int current = getDefaultVertexFormat() == formats[1] ? 1 : 0;
+		if (ImGui::Combo("Vertex Format", &current, names, 2)) {
+			getDefaultVertexFormat() = formats[current];
+			getMeshLibrary().FOR_EACH([&](const std::string&, MESH& mesh) {
+				mesh.setFormat(formats[current]);
+			});
+		}
+		size_t residentBytes = 0;
+		size_t floatBytes = 0;
+		getMeshLibrary().FOR_EACH([&](const std::string&, MESH& mesh) {
+			residentBytes += mesh.buffer.getResidentBytes();
+			floatBytes += mesh.getVertexCount() * VERTEX_FORMAT::FULL().getStride() + mesh.indices.size() * sizeof(uint32_t);
+		});
+		for (auto& arena : getGeometryArenas().arenas) {
+			residentBytes += arena->getCapacityBytes();
+		}
+		ImGui::Text("Mesh memory: %.1f KB (%.1f KB as float)", residentBytes / 1024.0, floatBytes / 1024.0);
+	}
+	void drawRenderStats() {
+		const RENDER_STATS& stats = getRenderStats();
+		ImGui::Text("Render Stats");
+		ImGui::Text("Uploaded: %zu bytes", stats.bytesUploaded);
+		ImGui::Text("Buffers created: %zu deleted: %zu", stats.buffersCreated, stats.buffersDeleted);
+		ImGui::Text("Draw calls: %zu instances: %zu", stats.drawCalls, stats.instancesDrawn);
+		ImGui::Text("Triangles: %zu", stats.trianglesDrawn);
+		ImGui::Text("Submit: %.3f ms", stats.submitTime);
+		const GL_CALL_COUNTS& calls = getGlState().calls;
+		ImGui::Text("GL state calls: %zu issued, %zu skipped", calls.getIssued(), calls.getSkipped());
+		for (size_t i = 0; i < static_cast<size_t>(GL_CALL::COUNT); ++i) {
+			ImGui::BulletText("%s: %zu / %zu", getGlCallName(static_cast<GL_CALL>(i)), calls.issued[i], calls.issued[i] + calls.skipped[i]);
+		}
+	}
+	void drawBroadphase(EDITOR& editor) {
+		const char* names[static_cast<size_t>(BROADPHASE_TYPE::COUNT)];
+		for (size_t i = 0; i < static_cast<size_t>(BROADPHASE_TYPE::COUNT); ++i) {
+			names[i] = getBroadphaseName(static_cast<BROADPHASE_TYPE>(i));
+		}
+		int type = static_cast<int>(editor.broadphase->getType());
+		if (ImGui::Combo("Broadphase", &type, names, static_cast<int>(BROADPHASE_TYPE::COUNT))) {
+			editor.broadphase = createBroadphase(static_cast<BROADPHASE_TYPE>(type));
+		}
+		ImGui::Text("Candidate pairs: %zu (%.3f ms)", editor.broadphase->pairCount, editor.broadphase->time);
+		int threads = static_cast<int>(editor.narrowphase.getThreadCount());
+		int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+		if (ImGui::SliderInt("Physics Threads", &threads, 1, maxThreads)) {
+			editor.narrowphase.setThreadCount(static_cast<size_t>(threads));
+		}
+		ImGui::Text("Collisions: %zu (%.3f ms)", editor.narrowphase.hits.size(), editor.narrowphase.time);
+		CONTACT_SOLVER& solver = editor.solver;
+		ImGui::SliderInt("Solver Iterations", &solver.iterations, 1, 50);
+		ImGui::SliderInt("Position Iterations", &solver.positionIterations, 0, 10);
+		ImGui::Checkbox("Warm Starting", &solver.warmStarting);
+		ImGui::SliderFloat("Friction", &solver.friction, 0.0f, 1.0f, "%.2f");
+		ImGui::SliderFloat("Restitution", &solver.restitution, 0.0f, 1.0f, "%.2f");
+		ImGui::InputFloat3("Gravity", glm::value_ptr(solver.gravity));
+		ImGui::Text("Contacts: %zu, %zu warm started (%.3f ms)", solver.contacts.size(), solver.warmStarted, solver.time);
+		ImGui::Text("Max penetration: %.4f", solver.maxPenetration);
+		ImGui::Checkbox("Sleeping", &editor.islands.sleeping);
+		ImGui::SliderFloat("Sleep Speed", &editor.islands.sleepSpeed, 0.0f, 1.0f, "%.3f");
+		ImGui::SliderFloat("Sleep Delay", &editor.islands.sleepDelay, 0.0f, 5.0f, "%.2f s");
+		const BODY_STORE& bodies = getBodyStore();
+		ImGui::Text("Awake bodies: %zu / %zu", bodies.getAwakeCount(), bodies.size());
+		ImGui::Text("Islands: %zu awake, %zu asleep (%.3f ms)", editor.islands.islandCount, bodies.getIslandCount(), editor.islands.time);
+		float stepRate = 1.0f / editor.physicsThread.fixedStep.load();
+		if (ImGui::SliderFloat("Physics Hz", &stepRate, 10.0f, 240.0f, "%.0f")) {
+			editor.physicsThread.fixedStep = 1.0f / stepRate;
+		}
+		ImGui::Text("Physics steps: %llu", static_cast<unsigned long long>(editor.physicsThread.stepCount.load()));
+	}
+	// Separate window: rolling per-marker times and a flame graph of the last frame on this thread
+	void drawProfiler(EDITOR& editor) {
+#if UPROFILE_ENABLED
+		profileHistory.UPDATE();
+#endif
+		if (!editor.profilerView) {
+			return;
+		}
+		ImGuiIO& io = ImGui::GetIO();
+		ImGui::SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.25f, 0));
+		ImGui::SetNextWindowSize({ io.DisplaySize.x * 0.75f, io.DisplaySize.y * 0.4f });
+		if (ImGui::Begin("Profiler", &editor.profilerView)) {
+#if UPROFILE_ENABLED
+			ImGui::Checkbox("Pause", &profileHistory.paused);
+			ImGui::SameLine();
+			if (ImGui::Button("Save trace")) {
+				traceStatus = getProfiler().EXPORT_CHROME_TRACE("trace.json") ? "Saved trace.json" : "Could not write trace.json";
+			}
+			ImGui::SameLine();
+			ImGui::Text("%s", traceStatus.c_str());
+			drawFlameGraph();
+			for (const PROFILE_HISTORY::SERIES& entry : profileHistory.series) {
+				char overlay[32];
+				snprintf(overlay, sizeof(overlay), "%.3f ms", entry.ms[profileHistory.column]);
+				ImGui::PlotHistogram(entry.name, entry.ms.data(), static_cast<int>(PROFILE_HISTORY::FRAMES), static_cast<int>((profileHistory.column + 1) % PROFILE_HISTORY::FRAMES),
+					overlay, 0.0f, std::max(profileHistory.getMax(entry), 0.001f), ImVec2(0, 40));
+			}
+#else
+			ImGui::Text("Profiler markers are compiled out, build with UPROFILE_ENABLED=1");
+#endif
+		}
+		ImGui::End();
+	}
+	void drawFlameGraph() {
+		const std::vector<PROFILE_EVENT>& events = profileHistory.lastFrame;
+		if (events.empty()) {
+			return;
+		}
+		const PROFILE_EVENT& root = events.front();
+		const float rowHeight = 18.0f;
+		uint32_t maxDepth = 0;
+		for (const PROFILE_EVENT& event : events) {
+			maxDepth = std::max(maxDepth, event.depth - root.depth);
+		}
+		ImVec2 origin = ImGui::GetCursorScreenPos();
+		float width = ImGui::GetContentRegionAvail().x;
+		float scale = width / std::max<float>(static_cast<float>(root.end - root.start), 1.0f);
+		auto* drawList = ImGui::GetWindowDrawList();
+		for (const PROFILE_EVENT& event : events) {
+			float y = origin.y + (event.depth - root.depth) * rowHeight;
+			ImVec2 min(origin.x + (event.start - root.start) * scale, y);
+			ImVec2 max(std::max(origin.x + (event.end - root.start) * scale, min.x + 1.0f), y + rowHeight - 1.0f);
+			// Colour from the name pointer, so a marker keeps its colour between frames
+			uint32_t hash = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(event.name) * 2654435761u);
+			drawList->AddRectFilled(min, max, IM_COL32(96 + (hash >> 8) % 128, 96 + (hash >> 16) % 128, 96 + (hash >> 24) % 128, 255));
+			if (ImGui::CalcTextSize(event.name).x < max.x - min.x - 4.0f) {
+				drawList->AddText(ImVec2(min.x + 2.0f, min.y + 2.0f), IM_COL32(0, 0, 0, 255), event.name);
+			}
+			if (ImGui::IsMouseHoveringRect(min, max)) {
+				ImGui::SetTooltip("%s: %.3f ms", event.name, (event.end - event.start) / 1e6);
+			}
+		}
+		ImGui::Dummy(ImVec2(width, (maxDepth + 1) * rowHeight));
+		ImGui::Text("Frame: %.3f ms", (root.end - root.start) / 1e6);
+	}
+	// Binary save/load, plus the text form of the same scene next to it for diffs
+	void drawScene(EDITOR& editor) {
+		ImGui::InputText("Scene", scenePath, sizeof(scenePath));
+		std::string path = scenePath;
+		std::string textPath = path + ".txt";
+		SCENE_FILE scene;
+		auto report = [&](const char* action, const std::string& file, bool ok, std::chrono::high_resolution_clock::time_point start) {
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			char text[512];
+			snprintf(text, sizeof(text), "%s %s: %s (%.2f ms)", action, file.c_str(), ok ? "done" : "failed", ms);
+			sceneStatus = text;
+		};
+		auto loaded = [&](bool ok) {
+			if (ok) {
+				editor.selected = ENTITY_HANDLE();
+			}
+			return ok;
+		};
+		auto start = std::chrono::high_resolution_clock::now();
+		if (ImGui::Button("Save Scene")) {
+			report("Save", path, scene.SAVE(path, editor.entities, editor.lights), start);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Load Scene")) {
+			report("Load", path, loaded(scene.LOAD(path, editor.entities, editor.lights)), start);
+		}
+		if (ImGui::Button("Export Text")) {
+			report("Export", textPath, scene.EXPORT_TEXT(textPath, editor.entities, editor.lights), start);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Import Text")) {
+			report("Import", textPath, loaded(scene.IMPORT_TEXT(textPath, editor.entities, editor.lights)), start);
+		}
+		if (!sceneStatus.empty()) {
+			ImGui::Text("%s", sceneStatus.c_str());
+		}
+	}
 	void drawLightProperty(EDITOR& editor) {
 		ImGui::Text("Light Properties");
 		for (auto& light : editor.lights) {
@@ -193,53 +437,67 @@ struct IMGUI {
 	void drawObjectList(EDITOR& editor) {
         if (ImGui::BeginListBox("##models_list"))
         {
-            for (auto& model : editor.models)
+            const std::vector<MODEL*>& models = editor.entities.getModels();
+            for (size_t i = 0; i < models.size(); ++i)
             {
+                MODEL* model = models[i];
+                ENTITY_HANDLE entity = editor.entities.getEntity(i);
                 std::string modelName = model->getName();
                 if (modelName.empty()) {
                     modelName = "##empty_id";
                 }
-                bool isSelected = (model == editor.selectedModel);
+                ImGui::PushID(static_cast<int>(entity.index));
+                bool isSelected = (entity == editor.selected);
                 if (ImGui::Selectable(modelName.c_str(), isSelected))
                 {
                     printf("Selected %s\n", modelName.c_str());
                     if (isSelected) {
-                        editor.selectedModel = nullptr;
+                        editor.selected = ENTITY_HANDLE();
                         model->setColor({ 1.0, 1.0, 1.0 });
                     }
                     else {
-                        if (editor.selectedModel != nullptr) {
-                            editor.selectedModel->setColor({ 1.0, 1.0, 1.0 });
+                        if (MODEL* previous = editor.entities.getModel(editor.selected)) {
+                            previous->setColor({ 1.0, 1.0, 1.0 });
                         }
-                        editor.selectedModel = model;
+                        editor.selected = entity;
                         model->setColor({ 1.0, 0.0, 0.0 });
                     }
                     glutPostRedisplay();
                 }
+                ImGui::PopID();
+            }
+            // Imports still on the workers, shown in place of the models they will become
+            for (auto& job : editor.importQueue.getJobs())
+            {
+                ImGui::PushID(job.get());
+                ImGui::Text("%s (%s)", job->getDisplayName().c_str(), getImportStateName(job->state));
+                ImGui::ProgressBar(job->progress.value, ImVec2(-60.0f, 0.0f));
+                ImGui::SameLine();
+                if (ImGui::SmallButton("Cancel")) {
+                    editor.importQueue.CANCEL(*job);
+                }
+                ImGui::PopID();
             }
             ImGui::EndListBox();
         }
 	}
     void drawAddCubeBtn(EDITOR& editor) {
         if (ImGui::Button("Object Cube Add", ImVec2(buttonWidth, buttonHeight))) {
-            std::shared_ptr<CUBE> cube = std::make_shared<CUBE>();
+            std::unique_ptr<CUBE> cube = std::make_unique<CUBE>();
             cube->Init("");
-			cube->colliderType = COLLIDER_TYPE::BOX;
-			cube->setCollider();
-			cube->setPhysics();
-			cube->setAxis();
-            editor.models.push_back(cube);
+			ENTITY_HANDLE entity = editor.entities.CREATE(std::move(cube));
+			editor.entities.setCollider(entity, COLLIDER_TYPE::BOX);
+			editor.entities.setBody(entity);
+			editor.entities.setGizmo(entity);
         }
 	}
     void drawAddSphereBtn(EDITOR& editor) {
         if (ImGui::Button("Object Sphere Add", ImVec2(buttonWidth, buttonHeight))) {
-            std::shared_ptr<FBX> sphere = std::make_shared<FBX>();
-            sphere->Init("D:\\projects\\OpenGL\\OpenGL\\Resource\\sphere.fbx");
-            sphere->colliderType = COLLIDER_TYPE::SPHERE;
-            sphere->setCollider();
-			sphere->setPhysics();
-			sphere->setAxis();
-            editor.models.push_back(sphere);
+            editor.importQueue.ADD("D:\\projects\\OpenGL\\OpenGL\\Resource\\sphere.fbx", [](ENTITY_STORE& entities, ENTITY_HANDLE sphere) {
+                entities.setCollider(sphere, COLLIDER_TYPE::SPHERE);
+                entities.setBody(sphere);
+                entities.setGizmo(sphere);
+            });
         }
     }
     void drawFileExplorer(EDITOR& editor) {
@@ -257,10 +515,7 @@ struct IMGUI {
                 {
                     if (entry.path().extension() == ".fbx" && ImGui::Selectable(entry.path().filename().string().c_str()))
                     {
-                        std::shared_ptr<FBX> fbx = std::make_shared<FBX>();
-                        fbx->Init(entry.path().string());
-                        fbx->setCollider();
-                        editor.models.push_back(fbx);
+                        editor.importQueue.ADD(entry.path().string());
                         editor.fileBrowser = false;
                         break;
                     }
@@ -271,75 +526,124 @@ struct IMGUI {
         }
 	}
     void drawObjectProperty(EDITOR& editor) {
-        if (editor.selectedModel != nullptr)
+        MODEL* selected = editor.entities.getModel(editor.selected);
+        if (selected != nullptr)
         {
             ImGui::Text("Selected Model's Properties");
-            glm::vec3 pos = editor.selectedModel->getProperty_Position();
-            glm::vec3 rot_axis = editor.selectedModel->getProperty_RotationAxis();
-            glm::vec3 scale = editor.selectedModel->getProperty_Scale();
+            glm::vec3 pos = selected->getProperty_Position();
+            glm::vec3 rot_axis = selected->getProperty_RotationAxis();
+            glm::vec3 scale = selected->getProperty_Scale();
 			char nameBuffer[256];
-			strncpy_s(nameBuffer, sizeof(nameBuffer), editor.selectedModel->getName().c_str(), _TRUNCATE);
+			strncpy_s(nameBuffer, sizeof(nameBuffer), selected->getName().c_str(), _TRUNCATE);
 			if (ImGui::InputText("Name", nameBuffer, sizeof(nameBuffer))) {
-				editor.selectedModel->setName(nameBuffer);
+				selected->setName(nameBuffer);
 			}
             if (ImGui::InputFloat3("Position", glm::value_ptr(pos))) {
                 printf("pos changed\n");
-                editor.selectedModel->setProperty_Position(pos);
+                editor.entities.setPosition(editor.selected, pos);
             }
             if (ImGui::InputFloat3("RotationAxis", glm::value_ptr(rot_axis))) {
                 printf("rot_axis changed\n");
-                editor.selectedModel->setProperty_RotationAxis(rot_axis);
+                selected->setProperty_RotationAxis(rot_axis);
+                getBodyStore().WAKE(editor.entities.getBody(editor.selected));
             }
             if (ImGui::InputFloat3("Scale", glm::value_ptr(scale))) {
                 printf("scale changed\n");
-                editor.selectedModel->setProperty_Scale(scale);
+                selected->setProperty_Scale(scale);
             }
-			if (editor.selectedModel->collider != nullptr)
+			drawParent(editor);
+			if (COLLIDER* collider = editor.entities.getCollider(editor.selected))
 			{
-				glm::vec3 relative_pos = editor.selectedModel->collider->getRelativePosition();
-				glm::vec3 collider_scale = editor.selectedModel->collider->getScale();
+				glm::vec3 relative_pos = collider->getRelativePosition();
+				glm::vec3 collider_scale = collider->getScale();
 				if (ImGui::InputFloat3("Collider Position", glm::value_ptr(relative_pos))) {
 					printf("collider pos changed\n");
-					editor.selectedModel->collider->setRelativePosition(relative_pos);
+					collider->setRelativePosition(relative_pos);
+					getBodyStore().WAKE(editor.entities.getBody(editor.selected));
 				}
 				if (ImGui::InputFloat3("Collider Scale", glm::value_ptr(collider_scale))) {
 					printf("collider scale changed\n");
-					editor.selectedModel->collider->setScale(collider_scale);
+					collider->setScale(collider_scale);
+					getBodyStore().WAKE(editor.entities.getBody(editor.selected));
 				}
 			}
-			if (editor.selectedModel->physics != nullptr)
+			BODY_HANDLE body = editor.entities.getBody(editor.selected);
+			if (!body.isNull())
 			{
-				glm::vec3 force = editor.selectedModel->physics->getForce();
-				glm::vec3 velocity = editor.selectedModel->physics->getVelocity();
-				if (ImGui::InputFloat("Mass", &editor.selectedModel->physics->mass)) {
+				BODY_STORE& bodies = getBodyStore();
+				float mass = bodies.getMass(body);
+				glm::vec3 force = bodies.getForce(body);
+				glm::vec3 velocity = bodies.getVelocity(body);
+				if (ImGui::InputFloat("Mass", &mass)) {
 					printf("Mass changed\n");
-					editor.selectedModel->physics->mass = std::max(0.0f, editor.selectedModel->physics->mass);
+					bodies.setMass(body, std::max(0.0f, mass));
 				}
 				if (ImGui::InputFloat3("Force", glm::value_ptr(force))) {
 					printf("Force changed\n");
-					editor.selectedModel->physics->setForce(force);
+					bodies.setForce(body, force);
 				}
 				if (ImGui::InputFloat3("Velocity", glm::value_ptr(velocity))) {
 					printf("Velocity changed\n");
-					editor.selectedModel->physics->setVelocity(velocity);
+					bodies.setVelocity(body, velocity);
 				}
 			}
 			if (ImGui::Button("Object Delete", ImVec2(buttonWidth, buttonHeight))) 
 			{
-				if (editor.selectedModel != nullptr) {
-					auto it = std::find(editor.models.begin(), editor.models.end(), editor.selectedModel);
-					if (it != editor.models.end()) {
-						it->reset();
-						editor.models.erase(it);
-						editor.selectedModel = nullptr;
+				editor.entities.DESTROY(editor.selected);
+				editor.selected = ENTITY_HANDLE();
+			}
+        }
+	}
+	// Parent as an index into the model list (-1 for none) and optionally one of that model's nodes.
+	// Position, rotation and scale above are relative to it.
+	void drawParent(EDITOR& editor) {
+		MODEL& selected = *editor.entities.getModel(editor.selected);
+		const std::vector<MODEL*>& models = editor.entities.getModels();
+		int parentModel = -1;
+		int parentNode = -1;
+		if (TRANSFORM* parent = selected.getParent()) {
+			for (size_t i = 0; i < models.size() && parentModel < 0; ++i) {
+				if (&models[i]->getTransform() == parent) {
+					parentModel = static_cast<int>(i);
+				}
+				for (int node = 0; TRANSFORM* transform = models[i]->getNodeTransform(node); ++node) {
+					if (transform == parent) {
+						parentModel = static_cast<int>(i);
+						parentNode = node;
+						break;
 					}
 				}
 			}
-        }
+		}
+		bool changed = ImGui::InputInt("Parent", &parentModel);
+		changed |= ImGui::InputInt("Parent Node", &parentNode);
+		if (changed) {
+			TRANSFORM* parent = nullptr;
+			if (parentModel >= 0 && parentModel < static_cast<int>(models.size())) {
+				MODEL& model = *models[parentModel];
+				parent = parentNode >= 0 ? model.getNodeTransform(parentNode) : nullptr;
+				if (!parent) {
+					parent = &model.getTransform();
+				}
+			}
+			if (!selected.setParent(parent)) {
+				printf("Parent rejected: it hangs below the selected model\n");
+			}
+		}
+		if (parentModel >= 0 && parentModel < static_cast<int>(models.size())) {
+			// A node index past the file's nodes fell back to the model itself above
+			const FBX* fbx = dynamic_cast<const FBX*>(models[parentModel]);
+			bool hasNode = fbx && parentNode >= 0 && static_cast<size_t>(parentNode) < fbx->getNodeCount();
+			ImGui::TextDisabled("Child of %s%s%s", models[parentModel]->getName().c_str(),
+				hasNode ? " / " : "", hasNode ? fbx->getNodeName(parentNode) : "");
+		}
 	}
 	void draw(EDITOR& editor) {
         ImGui::Text("Models:");
         drawMenu(editor);
+		drawRenderStats();
+		drawBroadphase(editor);
+		drawScene(editor);
 		drawLightProperty(editor);
         drawObjectList(editor);
         drawAddCubeBtn(editor);
@@ -347,10 +651,13 @@ struct IMGUI {
         drawFileExplorer(editor);
 		ImGui::Text("Property");
         drawObjectProperty(editor);
+		drawProfiler(editor);
 	}
 	void end() {
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		// The backend binds its own program, buffers and blend state
+		getGlState().INVALIDATE();
 	}
 };
 #endif
\ No newline at end of file
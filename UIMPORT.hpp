@@ -0,0 +1,189 @@
+#ifndef __UIMPORT_HPP__
+#define __UIMPORT_HPP__
+#include "UENTITY.hpp"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+enum class IMPORT_STATE {
+	QUEUED,
+	LOADING,
+	DONE,
+	FAILED,
+	CANCELLED
+};
+
+inline const char* getImportStateName(IMPORT_STATE state) {
+	static const char* names[] = { "queued", "loading", "done", "failed", "cancelled" };
+	return names[static_cast<size_t>(state)];
+}
+
+// One file on its way into the scene. Workers fill mesh; the GL thread turns it into a model.
+struct IMPORT_JOB {
+	std::string filename;
+	std::function<void(ENTITY_STORE&, ENTITY_HANDLE)> setup; // collider/body/gizmo setup, run on the GL thread once loaded
+	IMPORT_PROGRESS progress;
+	std::atomic<IMPORT_STATE> state{ IMPORT_STATE::QUEUED };
+	LOD_SETTINGS lodSettings; // copied from the editor's on the GL thread in ADD, the worker reads only these
+	VERTEX_FORMAT format;
+	std::shared_ptr<MESH> mesh;
+	double time = 0.0; // ms spent loading on the worker
+
+	std::string getDisplayName() const {
+		return std::filesystem::path(filename).filename().string();
+	}
+};
+
+// FBX imports off the GL thread. ADD queues a file and returns at once; workers run FBX::LOAD_MESH
+// (mesh cache or SDK import, welding) and POLL, called once per frame on the GL thread, uploads
+// finished meshes and adds their entities, at most maxFinishPerFrame at a time so frame time stays flat.
+struct IMPORT_QUEUE {
+	size_t maxFinishPerFrame = 1;
+
+	IMPORT_QUEUE(size_t threadCount = 2) {
+		threadCount = std::max<size_t>(threadCount, 1);
+		for (size_t i = 0; i < threadCount; ++i) {
+			threads.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	IMPORT_QUEUE(const IMPORT_QUEUE&) = delete;
+	IMPORT_QUEUE& operator=(const IMPORT_QUEUE&) = delete;
+	~IMPORT_QUEUE() {
+		STOP();
+	}
+
+	std::shared_ptr<IMPORT_JOB> ADD(const std::string& filename, std::function<void(ENTITY_STORE&, ENTITY_HANDLE)> setup = nullptr) {
+		std::shared_ptr<IMPORT_JOB> job = std::make_shared<IMPORT_JOB>();
+		job->filename = filename;
+		job->setup = std::move(setup);
+		job->lodSettings = getLodSettings();
+		job->format = getDefaultVertexFormat();
+		// Already resident: no work for the workers, POLL finishes it next frame
+		if ((job->mesh = getMeshLibrary().FIND(filename))) {
+			job->progress.value = 1.0f;
+			job->state = IMPORT_STATE::DONE;
+		}
+		jobs.push_back(job);
+		if (job->state == IMPORT_STATE::QUEUED) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending.push_back(job);
+			}
+			wake.notify_one();
+		}
+		return job;
+	}
+
+	void CANCEL(IMPORT_JOB& job) {
+		job.progress.cancelled = true;
+	}
+
+	void STOP() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			for (auto& job : jobs) {
+				job->progress.cancelled = true;
+			}
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	// GL thread only, with the entity store not in use by the physics thread
+	void POLL(ENTITY_STORE& entities) {
+		size_t finished = 0;
+		for (auto it = jobs.begin(); it != jobs.end();) {
+			IMPORT_JOB& job = **it;
+			IMPORT_STATE state = job.state;
+			if (state == IMPORT_STATE::CANCELLED || state == IMPORT_STATE::FAILED) {
+				printf("[IMPORT] %s %s\n", job.getDisplayName().c_str(), getImportStateName(state));
+				it = jobs.erase(it);
+				continue;
+			}
+			if (state != IMPORT_STATE::DONE || finished >= maxFinishPerFrame) {
+				++it;
+				continue;
+			}
+			if (job.progress.cancelled) {
+				it = jobs.erase(it);
+				continue;
+			}
+			// Another import of the same file may have finished first; share its mesh
+			std::shared_ptr<MESH> mesh = getMeshLibrary().FIND(job.filename);
+			if (!mesh) {
+				mesh = job.mesh;
+				getMeshLibrary().ADD(job.filename, mesh);
+			}
+			mesh->BIND();
+			getGlState().BIND_VERTEX_ARRAY(0);
+
+			std::unique_ptr<FBX> fbx = std::make_unique<FBX>();
+			fbx->Init(job.filename);
+			ENTITY_HANDLE entity = entities.CREATE(std::move(fbx));
+			if (job.setup) {
+				job.setup(entities, entity);
+			}
+			printf("[IMPORT] %s loaded in %.2f ms\n", job.getDisplayName().c_str(), job.time);
+			++finished;
+			it = jobs.erase(it);
+		}
+	}
+
+	// Jobs not yet turned into models, for the editor's placeholders
+	const std::vector<std::shared_ptr<IMPORT_JOB>>& getJobs() const {
+		return jobs;
+	}
+
+private:
+	std::vector<std::shared_ptr<IMPORT_JOB>> jobs; // GL thread only
+	std::deque<std::shared_ptr<IMPORT_JOB>> pending;
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void workerLoop() {
+		UPROFILE_THREAD("Import");
+		while (true) {
+			std::shared_ptr<IMPORT_JOB> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = pending.front();
+				pending.pop_front();
+			}
+			if (job->progress.cancelled) {
+				job->state = IMPORT_STATE::CANCELLED;
+				continue;
+			}
+			job->state = IMPORT_STATE::LOADING;
+			auto start = std::chrono::high_resolution_clock::now();
+			FBX loader(job->format);
+			job->mesh = loader.LOAD_MESH(job->filename, &job->progress, job->lodSettings, job->format);
+			job->time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			if (!job->mesh) {
+				job->state = IMPORT_STATE::CANCELLED;
+			}
+			else if (job->mesh->vertices.empty()) {
+				job->state = IMPORT_STATE::FAILED;
+			}
+			else {
+				// Encoding the vertex stream here leaves only the upload for the GL thread
+				job->mesh->INTERLEAVE();
+				job->progress.value = 1.0f;
+				job->state = IMPORT_STATE::DONE;
+			}
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __UISLAND_HPP__
+#define __UISLAND_HPP__
+#include "UBODY.hpp"
+#include <cfloat>
+#include <chrono>
+
+// Sleep tracking over simulation islands: awake bodies joined by contacts form an island, and an
+// island falls asleep once every body in it has rested for sleepDelay seconds, so a pile sleeps and
+// wakes as one. Static bodies (mass 0) and colliders without a body do not join islands, or a whole
+// scene resting on one floor would be a single island.
+struct SIMULATION_ISLANDS {
+	bool sleeping = true;
+	float sleepSpeed = 0.05f; // a body slower than this is resting
+	float sleepDelay = 0.5f;
+	size_t islandCount = 0; // awake islands found by the last UPDATE
+	double time = 0.0;
+
+	// Each step before CONTACT: forgets the last step's contacts
+	void BEGIN() {
+		contacts.clear();
+	}
+
+	// A touching pair from the narrowphase, either body may be null. An awake dynamic body wakes a sleeping
+	// one it touches; static and sleeping bodies wake nothing, so a pile on the floor stays asleep.
+	void CONTACT(BODY_STORE& bodies, BODY_HANDLE a, BODY_HANDLE b) {
+		bool awakeA = !a.isNull() && bodies.isAwake(a);
+		bool awakeB = !b.isNull() && bodies.isAwake(b);
+		if (awakeA && !awakeB && !b.isNull() && isDynamic(bodies, a) && isDynamic(bodies, b)) {
+			bodies.WAKE(b);
+		}
+		else if (awakeB && !awakeA && !a.isNull() && isDynamic(bodies, b) && isDynamic(bodies, a)) {
+			bodies.WAKE(a);
+		}
+		if (!a.isNull() && !b.isNull()) {
+			contacts.push_back({ a, b });
+		}
+	}
+
+	// After INTEGRATE: advances the rest timers of the awake bodies and puts islands that rested long enough to sleep
+	void UPDATE(BODY_STORE& bodies, float dt) {
+		auto start = std::chrono::high_resolution_clock::now();
+		if (!sleeping) {
+			bodies.WAKE_ALL();
+			islandCount = 0;
+			time = 0.0;
+			return;
+		}
+		uint32_t count = static_cast<uint32_t>(bodies.getAwakeCount());
+		float speedSquared = sleepSpeed * sleepSpeed;
+		for (uint32_t i = 0; i < count; ++i) {
+			float speed = bodies.vx[i] * bodies.vx[i] + bodies.vy[i] * bodies.vy[i] + bodies.vz[i] * bodies.vz[i];
+			bodies.restTime[i] = speed < speedSquared ? bodies.restTime[i] + dt : 0.0f;
+		}
+
+		parent.resize(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			parent[i] = i;
+		}
+		for (const std::pair<BODY_HANDLE, BODY_HANDLE>& contact : contacts) {
+			if (!bodies.isValid(contact.first) || !bodies.isValid(contact.second)) {
+				continue;
+			}
+			uint32_t a = bodies.getDenseIndex(contact.first);
+			uint32_t b = bodies.getDenseIndex(contact.second);
+			if (a < count && b < count && bodies.invMass[a] > 0.0f && bodies.invMass[b] > 0.0f) {
+				parent[find(a)] = find(b);
+			}
+		}
+
+		// An island rests as long as its least rested body
+		restTime.assign(count, FLT_MAX);
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t root = find(i);
+			parent[i] = root;
+			restTime[root] = std::min(restTime[root], bodies.restTime[i]);
+		}
+		members.resize(count);
+		islandCount = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			members[i].clear();
+			islandCount += parent[i] == i ? 1 : 0;
+		}
+		for (uint32_t i = 0; i < count; ++i) {
+			uint32_t root = parent[i];
+			if (restTime[root] >= sleepDelay) {
+				members[root].push_back(bodies.getHandle(i));
+			}
+		}
+		// SLEEP reorders the dense arrays, so the handles are all gathered first
+		for (uint32_t i = 0; i < count; ++i) {
+			if (!members[i].empty()) {
+				bodies.SLEEP(members[i]);
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+private:
+	std::vector<std::pair<BODY_HANDLE, BODY_HANDLE>> contacts;
+	std::vector<uint32_t> parent;
+	std::vector<float> restTime;
+	std::vector<std::vector<BODY_HANDLE>> members;
+
+	static bool isDynamic(const BODY_STORE& bodies, BODY_HANDLE handle) {
+		return bodies.invMass[bodies.getDenseIndex(handle)] > 0.0f;
+	}
+	// Path halving; the restTime pass then points every body straight at its root
+	uint32_t find(uint32_t i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+};
+
+#endif
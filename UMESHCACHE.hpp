@@ -0,0 +1,334 @@
+#ifndef __UMESHCACHE_HPP__
+#define __UMESHCACHE_HPP__
+#include "URENDER.hpp"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only view of a whole file through the OS page cache
+struct MAPPED_FILE {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+	MAPPED_FILE() = default;
+	MAPPED_FILE(const MAPPED_FILE&) = delete;
+	MAPPED_FILE& operator=(const MAPPED_FILE&) = delete;
+	~MAPPED_FILE() {
+		CLOSE();
+	}
+
+	bool OPEN(const std::string& path) {
+		CLOSE();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			CLOSE();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			CLOSE();
+			return false;
+		}
+		data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		size = static_cast<size_t>(fileSize.QuadPart);
+#else
+		fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			CLOSE();
+			return false;
+		}
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		data = view == MAP_FAILED ? nullptr : static_cast<const uint8_t*>(view);
+		size = static_cast<size_t>(info.st_size);
+#endif
+		if (!data) {
+			CLOSE();
+			return false;
+		}
+		return true;
+	}
+
+	void CLOSE() {
+#ifdef _WIN32
+		if (data) UnmapViewOfFile(data);
+		if (mapping) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data) munmap(const_cast<uint8_t*>(data), size);
+		if (fd >= 0) close(fd);
+		fd = -1;
+#endif
+		data = nullptr;
+		size = 0;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Imported meshes stored as the raw arrays of MESH, so a warm load is a few memcpys out of a mapped file.
+// Files live in MeshCache/<hash of source path>.umesh and are reused while the source keeps its
+// mtime and size; when those changed but the content hash did not (a copy, a touch), the entry is kept.
+//
+// Layout: MESH_CACHE_HEADER, vertices[3n], normals[3n], textures[2n], indices[m], lods[l], lodIndices[k],
+// nodes[j], in the writer's native byte order and struct layout, which LOAD does not check: a cache belongs
+// to the machine that wrote it and is not meant to be shared. The LOD chain and the node tree are stored too, so simplification runs
+// once per asset and a warm load still knows the hierarchy.
+struct MESH_CACHE_HEADER {
+	char magic[4];
+	uint32_t version;
+	uint64_t pathHash;
+	uint64_t contentHash;
+	int64_t sourceTime;
+	uint64_t sourceSize;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t lodIndexCount;
+	uint32_t nodeCount;
+	uint32_t reserved;
+};
+
+struct MESH_CACHE {
+	static constexpr char MAGIC[4] = { 'U', 'M', 'S', 'H' };
+	static constexpr uint32_t VERSION = 3;
+
+	std::string directory = "MeshCache";
+	bool enabled = true;
+
+	std::string getCachePath(const std::string& source) const {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.umesh", static_cast<unsigned long long>(hashPath(source)));
+		return (std::filesystem::path(directory) / name).string();
+	}
+
+	// Fills an empty mesh from the cache, false when there is no usable entry
+	bool LOAD(const std::string& source, MESH& mesh) const {
+		if (!enabled) {
+			return false;
+		}
+		SOURCE_INFO info;
+		if (!getSourceInfo(source, info)) {
+			return false;
+		}
+		std::string cachePath = getCachePath(source);
+		MESH_CACHE_HEADER header;
+		{
+			MAPPED_FILE file;
+			if (!file.OPEN(cachePath) || file.size < sizeof(MESH_CACHE_HEADER)) {
+				return false;
+			}
+			std::memcpy(&header, file.data, sizeof(header));
+			if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.pathHash != hashPath(source)) {
+				return false;
+			}
+			// Counts widen before they add up, so a corrupt header cannot wrap the sum into a matching size
+			size_t floats = static_cast<size_t>(header.vertexCount) * 8;
+			uint64_t expected = sizeof(MESH_CACHE_HEADER) + static_cast<uint64_t>(header.vertexCount) * 8 * sizeof(float)
+				+ (static_cast<uint64_t>(header.indexCount) + header.lodIndexCount) * sizeof(uint32_t)
+				+ static_cast<uint64_t>(header.lodCount) * sizeof(MESH_LOD) + static_cast<uint64_t>(header.nodeCount) * sizeof(MESH_NODE);
+			if (file.size != expected) {
+				std::cerr << "Truncated mesh cache " << cachePath << std::endl;
+				return false;
+			}
+			bool fresh = header.sourceTime == info.time && header.sourceSize == info.size;
+			if (!fresh && header.contentHash != hashFile(source)) {
+				return false;
+			}
+			const float* streams = reinterpret_cast<const float*>(file.data + sizeof(MESH_CACHE_HEADER));
+			const uint32_t* indices = reinterpret_cast<const uint32_t*>(streams + floats);
+			const MESH_LOD* lods = reinterpret_cast<const MESH_LOD*>(indices + header.indexCount);
+			const uint32_t* lodIndices = reinterpret_cast<const uint32_t*>(lods + header.lodCount);
+			const MESH_NODE* nodes = reinterpret_cast<const MESH_NODE*>(lodIndices + header.lodIndexCount);
+			if (!isConsistent(header, indices, lods, lodIndices, nodes)) {
+				std::cerr << "Corrupt mesh cache " << cachePath << std::endl;
+				return false;
+			}
+			size_t n = header.vertexCount;
+			mesh.vertices.assign(streams, streams + n * 3);
+			mesh.normals.assign(streams + n * 3, streams + n * 6);
+			mesh.textures.assign(streams + n * 6, streams + n * 8);
+			mesh.indices.assign(indices, indices + header.indexCount);
+			mesh.lods.assign(lods, lods + header.lodCount);
+			mesh.lodIndices.assign(lodIndices, lodIndices + header.lodIndexCount);
+			mesh.nodes.assign(nodes, nodes + header.nodeCount);
+			for (MESH_NODE& node : mesh.nodes) {
+				node.name[sizeof(node.name) - 1] = '\0';
+			}
+			mesh.setGeometryDirty();
+			if (fresh) {
+				return true;
+			}
+		}
+		// Same content under a new mtime: remember the new stamp so the next load skips hashing
+		header.sourceTime = info.time;
+		header.sourceSize = info.size;
+		std::fstream patch(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		patch.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		return true;
+	}
+
+	void SAVE(const std::string& source, const MESH& mesh) const {
+		if (!enabled || mesh.vertices.empty()) {
+			return;
+		}
+		SOURCE_INFO info;
+		if (!getSourceInfo(source, info)) {
+			return;
+		}
+		MESH_CACHE_HEADER header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.pathHash = hashPath(source);
+		header.contentHash = hashFile(source);
+		header.sourceTime = info.time;
+		header.sourceSize = info.size;
+		header.vertexCount = static_cast<uint32_t>(mesh.getVertexCount());
+		header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+		header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+		header.lodIndexCount = static_cast<uint32_t>(mesh.lodIndices.size());
+		header.nodeCount = static_cast<uint32_t>(mesh.nodes.size());
+
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		std::string cachePath = getCachePath(source);
+		// Per thread, in case two imports of the same file finish together
+		std::string tempPath = cachePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			if (!out) {
+				std::cerr << "Failed to write mesh cache " << tempPath << std::endl;
+				return;
+			}
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			writeArray(out, mesh.vertices);
+			writeArray(out, mesh.normals);
+			writeArray(out, mesh.textures);
+			writeArray(out, mesh.indices);
+			writeArray(out, mesh.lods);
+			writeArray(out, mesh.lodIndices);
+			writeArray(out, mesh.nodes);
+			out.close();
+			if (!out) {
+				std::cerr << "Failed to write mesh cache " << tempPath << std::endl;
+				std::filesystem::remove(tempPath, error);
+				return;
+			}
+		}
+		// Readers only ever see a complete file
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error) {
+			std::cerr << "Failed to write mesh cache " << cachePath << ": " << error.message() << std::endl;
+			std::filesystem::remove(tempPath, error);
+		}
+	}
+
+	void REMOVE(const std::string& source) const {
+		std::error_code error;
+		std::filesystem::remove(getCachePath(source), error);
+	}
+
+private:
+	struct SOURCE_INFO {
+		int64_t time;
+		uint64_t size;
+	};
+
+	static bool getSourceInfo(const std::string& source, SOURCE_INFO& info) {
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(source, error);
+		if (error) {
+			return false;
+		}
+		info.size = std::filesystem::file_size(source, error);
+		info.time = static_cast<int64_t>(time.time_since_epoch().count());
+		return !error;
+	}
+	// Everything the renderer and the node tree index with: a size-correct file can still hold
+	// garbage, and a bad index would only show up as an out-of-bounds read at draw time
+	static bool isConsistent(const MESH_CACHE_HEADER& header, const uint32_t* indices, const MESH_LOD* lods,
+		const uint32_t* lodIndices, const MESH_NODE* nodes) {
+		for (uint32_t i = 0; i < header.indexCount; ++i) {
+			if (indices[i] >= header.vertexCount) {
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header.lodIndexCount; ++i) {
+			if (lodIndices[i] >= header.vertexCount) {
+				return false;
+			}
+		}
+		for (uint32_t i = 0; i < header.lodCount; ++i) {
+			if (static_cast<uint64_t>(lods[i].firstIndex) + lods[i].indexCount > header.lodIndexCount) {
+				return false;
+			}
+		}
+		// Parents come before children, which also rules out cycles
+		for (uint32_t i = 0; i < header.nodeCount; ++i) {
+			if (nodes[i].parent < -1 || nodes[i].parent >= static_cast<int64_t>(i)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	static uint64_t hashPath(const std::string& source) {
+		std::error_code error;
+		std::string path = std::filesystem::weakly_canonical(source, error).generic_string();
+		if (error) {
+			path = source;
+		}
+		return hashBytes(path.data(), path.size());
+	}
+	static uint64_t hashFile(const std::string& source) {
+		MAPPED_FILE file;
+		return file.OPEN(source) ? hashBytes(file.data, file.size) : 0;
+	}
+	template<typename T>
+	static void writeArray(std::ofstream& out, const std::vector<T>& values) {
+		out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+	}
+};
+
+inline MESH_CACHE& getMeshCache() {
+	static MESH_CACHE cache;
+	return cache;
+}
+
+#endif
@@ -0,0 +1,473 @@
+#ifndef __UNARROWPHASE_HPP__
+#define __UNARROWPHASE_HPP__
+#include "UBROADPHASE.hpp"
+#include "UBODY.hpp"
+#include "UTHREAD.hpp"
+#include <array>
+#include <cstring>
+
+// One collider shape in a cache line, so the narrowphase reaches a proxy's shape with one miss. A box
+// is oriented: half extents along the columns of its axes. A sphere keeps its radius in extent.x.
+struct NARROWPHASE_SHAPE {
+	enum FIELD { CENTER = 0, EXTENT = 3, AXES = 6, FIELDS = 16 }; // as floats; AXES + 3 * k + i: component i of axis k
+
+	glm::vec3 center;
+	glm::vec3 extent;
+	glm::mat3 axes;
+	uint32_t sphere;
+};
+static_assert(sizeof(NARROWPHASE_SHAPE) == 16 * sizeof(float), "NARROWPHASE_SHAPE is read as 16 floats");
+
+// Collider shapes by broadphase proxy for NARROWPHASE::RUN_BATCHED
+struct NARROWPHASE_SHAPES {
+	std::vector<NARROWPHASE_SHAPE, ALIGNED_ALLOCATOR<NARROWPHASE_SHAPE, 64>> shapes;
+
+	size_t size() const {
+		return shapes.size();
+	}
+	const NARROWPHASE_SHAPE& operator[](size_t proxy) const {
+		return shapes[proxy];
+	}
+	const float* getFloats(size_t proxy) const {
+		return reinterpret_cast<const float*>(&shapes[proxy]);
+	}
+	void CLEAR() {
+		shapes.clear();
+	}
+	void ADD_BOX(const glm::vec3& center, const glm::vec3& halfExtents, const glm::mat3& orientation) {
+		shapes.push_back({ center, halfExtents, orientation, 0 });
+	}
+	void ADD_SPHERE(const glm::vec3& center, float radius) {
+		shapes.push_back({ center, glm::vec3(radius), glm::mat3(1.0f), 1 });
+	}
+	// The editor's reading of a collider, as makeContact builds its contact: the scale is the size of the box
+	// and its largest component the diameter of the sphere. COLLIDER does not give back the orientation a box
+	// was SET with, so the caller passes it (the editor's is its model's rotation) and hands the same axes
+	// to CONTACT_SOLVER::ADD.
+	void ADD(const COLLIDER& collider, const glm::mat3& orientation = glm::mat3(1.0f)) {
+		glm::vec3 center = collider.position + collider.getRelativePosition();
+		glm::vec3 scale = collider.getScale();
+		if (collider.type == COLLIDER_TYPE::SPHERE) {
+			ADD_SPHERE(center, 0.5f * std::max(scale.x, std::max(scale.y, scale.z)));
+		}
+		else {
+			ADD_BOX(center, 0.5f * scale, orientation);
+		}
+	}
+};
+
+// Scalar reference tests, touching counts as overlapping
+inline bool testSphereSphere(const glm::vec3& centerA, float radiusA, const glm::vec3& centerB, float radiusB) {
+	glm::vec3 delta = centerB - centerA;
+	float radii = radiusA + radiusB;
+	return glm::dot(delta, delta) <= radii * radii;
+}
+inline bool testSphereBox(const glm::vec3& center, float radius, const glm::vec3& boxCenter, const glm::vec3& extent, const glm::mat3& axes) {
+	glm::vec3 local = glm::transpose(axes) * (center - boxCenter);
+	glm::vec3 outside = local - glm::clamp(local, -extent, extent);
+	return glm::dot(outside, outside) <= radius * radius;
+}
+// Separating axis test over the 3 + 3 face normals and 9 edge cross products, in A's frame. Near
+// parallel edges give near zero cross products, so their absolute rotation terms get an epsilon.
+inline bool testBoxBox(const glm::vec3& centerA, const glm::vec3& extentA, const glm::mat3& axesA,
+	const glm::vec3& centerB, const glm::vec3& extentB, const glm::mat3& axesB) {
+	glm::mat3 rotation = glm::transpose(axesA) * axesB; // rotation[j][i]: axis i of A against axis j of B
+	glm::mat3 absolute;
+	for (int j = 0; j < 3; ++j) {
+		absolute[j] = glm::abs(rotation[j]) + glm::vec3(1e-6f);
+	}
+	glm::vec3 t = glm::transpose(axesA) * (centerB - centerA);
+	for (int i = 0; i < 3; ++i) {
+		float rb = extentB.x * absolute[0][i] + extentB.y * absolute[1][i] + extentB.z * absolute[2][i];
+		if (std::abs(t[i]) > extentA[i] + rb) {
+			return false;
+		}
+	}
+	for (int j = 0; j < 3; ++j) {
+		float ra = glm::dot(extentA, absolute[j]);
+		if (std::abs(glm::dot(t, rotation[j])) > ra + extentB[j]) {
+			return false;
+		}
+	}
+	for (int i = 0; i < 3; ++i) {
+		int i1 = (i + 1) % 3;
+		int i2 = (i + 2) % 3;
+		for (int j = 0; j < 3; ++j) {
+			int j1 = (j + 1) % 3;
+			int j2 = (j + 2) % 3;
+			float ra = extentA[i1] * absolute[j][i2] + extentA[i2] * absolute[j][i1];
+			float rb = extentB[j1] * absolute[j2][i] + extentB[j2] * absolute[j1][i];
+			if (std::abs(t[i2] * rotation[j][i1] - t[i1] * rotation[j][i2]) > ra + rb) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+inline bool testShapes(const NARROWPHASE_SHAPE& a, const NARROWPHASE_SHAPE& b) {
+	if (a.sphere && b.sphere) {
+		return testSphereSphere(a.center, a.extent.x, b.center, b.extent.x);
+	}
+	if (a.sphere || b.sphere) {
+		const NARROWPHASE_SHAPE& sphere = a.sphere ? a : b;
+		const NARROWPHASE_SHAPE& box = a.sphere ? b : a;
+		return testSphereBox(sphere.center, sphere.extent.x, box.center, box.extent, box.axes);
+	}
+	return testBoxBox(a.center, a.extent, a.axes, b.center, b.extent, b.axes);
+}
+inline bool testShapes(const NARROWPHASE_SHAPES& shapes, uint32_t a, uint32_t b) {
+	return testShapes(shapes[a], shapes[b]);
+}
+
+enum class PAIR_KIND {
+	BOX_BOX,
+	SPHERE_SPHERE,
+	SPHERE_BOX, // the sphere is A
+	COUNT
+};
+
+// A block of pairs of one kind from one worker: the kernels take 8 (AVX) or 4 (SSE) of its pairs at a time
+// and load their shapes straight into registers, so nothing but the proxies is copied. Tests run up to a
+// multiple of 8; PAD repeats the last pair into the padding lanes, whose results are ignored.
+struct PAIR_BATCH {
+	static constexpr size_t CAPACITY = 32;
+
+	alignas(32) float hit[CAPACITY] = {}; // any set bit where the shapes overlap
+	uint32_t pairs[CAPACITY] = {}; // indices into the broadphase pair list
+	uint32_t proxyA[CAPACITY] = {};
+	uint32_t proxyB[CAPACITY] = {};
+	size_t count = 0;
+
+	bool isFull() const {
+		return count == CAPACITY;
+	}
+	size_t getPadded() const {
+		return (count + 7) & ~size_t(7);
+	}
+	void PUSH(uint32_t pair, uint32_t first, uint32_t second) {
+		pairs[count] = pair;
+		proxyA[count] = first;
+		proxyB[count] = second;
+		++count;
+	}
+	void PAD() {
+		for (size_t i = count; i < getPadded(); ++i) {
+			proxyA[i] = proxyA[count - 1];
+			proxyB[i] = proxyB[count - 1];
+		}
+	}
+	bool isHit(size_t i) const {
+		uint32_t bits;
+		std::memcpy(&bits, &hit[i], sizeof(bits));
+		return bits != 0;
+	}
+};
+
+// One SIMD register of lanes with the few operations the batched tests need, so each test is written
+// once for AVX and SSE. Comparisons give all-bits masks. LOAD_SHAPES transposes the shape records of
+// one register of proxies into its 16 fields, field f holding float f of every record.
+#if defined(UBODY_AVX)
+struct LANES {
+	static constexpr size_t WIDTH = 8;
+	__m256 v;
+
+	static LANES set(float x) {
+		return { _mm256_set1_ps(x) };
+	}
+	void store(float* p) const {
+		_mm256_store_ps(p, v);
+	}
+	static void LOAD_SHAPES(const NARROWPHASE_SHAPES& shapes, const uint32_t* proxies, LANES* fields) {
+		for (int half = 0; half < 2; ++half) {
+			__m256 r0 = _mm256_load_ps(shapes.getFloats(proxies[0]) + 8 * half);
+			__m256 r1 = _mm256_load_ps(shapes.getFloats(proxies[1]) + 8 * half);
+			__m256 r2 = _mm256_load_ps(shapes.getFloats(proxies[2]) + 8 * half);
+			__m256 r3 = _mm256_load_ps(shapes.getFloats(proxies[3]) + 8 * half);
+			__m256 r4 = _mm256_load_ps(shapes.getFloats(proxies[4]) + 8 * half);
+			__m256 r5 = _mm256_load_ps(shapes.getFloats(proxies[5]) + 8 * half);
+			__m256 r6 = _mm256_load_ps(shapes.getFloats(proxies[6]) + 8 * half);
+			__m256 r7 = _mm256_load_ps(shapes.getFloats(proxies[7]) + 8 * half);
+			__m256 t0 = _mm256_unpacklo_ps(r0, r1);
+			__m256 t1 = _mm256_unpackhi_ps(r0, r1);
+			__m256 t2 = _mm256_unpacklo_ps(r2, r3);
+			__m256 t3 = _mm256_unpackhi_ps(r2, r3);
+			__m256 t4 = _mm256_unpacklo_ps(r4, r5);
+			__m256 t5 = _mm256_unpackhi_ps(r4, r5);
+			__m256 t6 = _mm256_unpacklo_ps(r6, r7);
+			__m256 t7 = _mm256_unpackhi_ps(r6, r7);
+			r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+			r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+			r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+			r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+			r4 = _mm256_shuffle_ps(t4, t6, 0x44);
+			r5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+			r6 = _mm256_shuffle_ps(t5, t7, 0x44);
+			r7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+			LANES* out = fields + 8 * half;
+			out[0] = { _mm256_permute2f128_ps(r0, r4, 0x20) };
+			out[1] = { _mm256_permute2f128_ps(r1, r5, 0x20) };
+			out[2] = { _mm256_permute2f128_ps(r2, r6, 0x20) };
+			out[3] = { _mm256_permute2f128_ps(r3, r7, 0x20) };
+			out[4] = { _mm256_permute2f128_ps(r0, r4, 0x31) };
+			out[5] = { _mm256_permute2f128_ps(r1, r5, 0x31) };
+			out[6] = { _mm256_permute2f128_ps(r2, r6, 0x31) };
+			out[7] = { _mm256_permute2f128_ps(r3, r7, 0x31) };
+		}
+	}
+	friend LANES operator+(LANES a, LANES b) { return { _mm256_add_ps(a.v, b.v) }; }
+	friend LANES operator-(LANES a, LANES b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	friend LANES operator*(LANES a, LANES b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	friend LANES operator|(LANES a, LANES b) { return { _mm256_or_ps(a.v, b.v) }; }
+	friend LANES operator>(LANES a, LANES b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	friend LANES operator<=(LANES a, LANES b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	friend LANES abs(LANES a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+	friend LANES min(LANES a, LANES b) { return { _mm256_min_ps(a.v, b.v) }; }
+	friend LANES max(LANES a, LANES b) { return { _mm256_max_ps(a.v, b.v) }; }
+	friend LANES andNot(LANES mask, LANES a) { return { _mm256_andnot_ps(mask.v, a.v) }; }
+};
+#elif defined(UBODY_SSE)
+struct LANES {
+	static constexpr size_t WIDTH = 4;
+	__m128 v;
+
+	static LANES set(float x) {
+		return { _mm_set1_ps(x) };
+	}
+	void store(float* p) const {
+		_mm_store_ps(p, v);
+	}
+	static void LOAD_SHAPES(const NARROWPHASE_SHAPES& shapes, const uint32_t* proxies, LANES* fields) {
+		for (int quarter = 0; quarter < 4; ++quarter) {
+			__m128 r0 = _mm_load_ps(shapes.getFloats(proxies[0]) + 4 * quarter);
+			__m128 r1 = _mm_load_ps(shapes.getFloats(proxies[1]) + 4 * quarter);
+			__m128 r2 = _mm_load_ps(shapes.getFloats(proxies[2]) + 4 * quarter);
+			__m128 r3 = _mm_load_ps(shapes.getFloats(proxies[3]) + 4 * quarter);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			fields[4 * quarter] = { r0 };
+			fields[4 * quarter + 1] = { r1 };
+			fields[4 * quarter + 2] = { r2 };
+			fields[4 * quarter + 3] = { r3 };
+		}
+	}
+	friend LANES operator+(LANES a, LANES b) { return { _mm_add_ps(a.v, b.v) }; }
+	friend LANES operator-(LANES a, LANES b) { return { _mm_sub_ps(a.v, b.v) }; }
+	friend LANES operator*(LANES a, LANES b) { return { _mm_mul_ps(a.v, b.v) }; }
+	friend LANES operator|(LANES a, LANES b) { return { _mm_or_ps(a.v, b.v) }; }
+	friend LANES operator>(LANES a, LANES b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	friend LANES operator<=(LANES a, LANES b) { return { _mm_cmple_ps(a.v, b.v) }; }
+	friend LANES abs(LANES a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+	friend LANES min(LANES a, LANES b) { return { _mm_min_ps(a.v, b.v) }; }
+	friend LANES max(LANES a, LANES b) { return { _mm_max_ps(a.v, b.v) }; }
+	friend LANES andNot(LANES mask, LANES a) { return { _mm_andnot_ps(mask.v, a.v) }; }
+};
+#endif
+
+#if defined(UBODY_AVX) || defined(UBODY_SSE)
+#define UNARROWPHASE_LANES 1
+// The batched tests follow the scalar references above, a register of lanes at a time over the block
+inline void testSphereSphereLanes(const NARROWPHASE_SHAPES& shapes, PAIR_BATCH& batch) {
+	using F = NARROWPHASE_SHAPE::FIELD;
+	for (size_t i = 0; i < batch.getPadded(); i += LANES::WIDTH) {
+		LANES a[F::FIELDS], b[F::FIELDS];
+		LANES::LOAD_SHAPES(shapes, &batch.proxyA[i], a);
+		LANES::LOAD_SHAPES(shapes, &batch.proxyB[i], b);
+		LANES dx = b[F::CENTER] - a[F::CENTER];
+		LANES dy = b[F::CENTER + 1] - a[F::CENTER + 1];
+		LANES dz = b[F::CENTER + 2] - a[F::CENTER + 2];
+		LANES radii = a[F::EXTENT] + b[F::EXTENT];
+		((dx * dx + dy * dy + dz * dz) <= radii * radii).store(&batch.hit[i]);
+	}
+}
+inline void testSphereBoxLanes(const NARROWPHASE_SHAPES& shapes, PAIR_BATCH& batch) {
+	using F = NARROWPHASE_SHAPE::FIELD;
+	for (size_t i = 0; i < batch.getPadded(); i += LANES::WIDTH) {
+		LANES a[F::FIELDS], b[F::FIELDS];
+		LANES::LOAD_SHAPES(shapes, &batch.proxyA[i], a);
+		LANES::LOAD_SHAPES(shapes, &batch.proxyB[i], b);
+		LANES dx = a[F::CENTER] - b[F::CENTER];
+		LANES dy = a[F::CENTER + 1] - b[F::CENTER + 1];
+		LANES dz = a[F::CENTER + 2] - b[F::CENTER + 2];
+		LANES distance = LANES::set(0.0f);
+		for (int k = 0; k < 3; ++k) {
+			LANES local = dx * b[F::AXES + 3 * k] + dy * b[F::AXES + 3 * k + 1] + dz * b[F::AXES + 3 * k + 2];
+			LANES extent = b[F::EXTENT + k];
+			LANES outside = local - min(max(local, LANES::set(0.0f) - extent), extent);
+			distance = distance + outside * outside;
+		}
+		(distance <= a[F::EXTENT] * a[F::EXTENT]).store(&batch.hit[i]);
+	}
+}
+// One of the nine edge cross product axes, axis i of A against axis j of B with i1, i2 and j1, j2 the
+// other two axes of each in cyclic order
+template<int I, int J>
+inline LANES separatedOnEdges(const LANES (&rotation)[3][3], const LANES (&absolute)[3][3], const LANES* t,
+	const LANES* extentA, const LANES* extentB) {
+	constexpr int I1 = (I + 1) % 3, I2 = (I + 2) % 3, J1 = (J + 1) % 3, J2 = (J + 2) % 3;
+	LANES ra = extentA[I1] * absolute[I2][J] + extentA[I2] * absolute[I1][J];
+	LANES rb = extentB[J1] * absolute[I][J2] + extentB[J2] * absolute[I][J1];
+	return abs(t[I2] * rotation[I1][J] - t[I1] * rotation[I2][J]) > ra + rb;
+}
+inline void testBoxBoxLanes(const NARROWPHASE_SHAPES& shapes, PAIR_BATCH& batch) {
+	using F = NARROWPHASE_SHAPE::FIELD;
+	for (size_t i = 0; i < batch.getPadded(); i += LANES::WIDTH) {
+		LANES a[F::FIELDS], b[F::FIELDS];
+		LANES::LOAD_SHAPES(shapes, &batch.proxyA[i], a);
+		LANES::LOAD_SHAPES(shapes, &batch.proxyB[i], b);
+		const LANES* extentA = &a[F::EXTENT];
+		const LANES* extentB = &b[F::EXTENT];
+		LANES d[3] = { b[F::CENTER] - a[F::CENTER], b[F::CENTER + 1] - a[F::CENTER + 1], b[F::CENTER + 2] - a[F::CENTER + 2] };
+		// rotation[r][c]: axis r of A against axis c of B
+		LANES rotation[3][3], absolute[3][3], t[3];
+		LANES epsilon = LANES::set(1e-6f);
+		for (int r = 0; r < 3; ++r) {
+			const LANES* axisA = &a[F::AXES + 3 * r];
+			for (int c = 0; c < 3; ++c) {
+				const LANES* axisB = &b[F::AXES + 3 * c];
+				rotation[r][c] = axisA[0] * axisB[0] + axisA[1] * axisB[1] + axisA[2] * axisB[2];
+				absolute[r][c] = abs(rotation[r][c]) + epsilon;
+			}
+			t[r] = axisA[0] * d[0] + axisA[1] * d[1] + axisA[2] * d[2];
+		}
+		LANES separated = LANES::set(0.0f);
+		for (int r = 0; r < 3; ++r) {
+			LANES rb = extentB[0] * absolute[r][0] + extentB[1] * absolute[r][1] + extentB[2] * absolute[r][2];
+			separated = separated | (abs(t[r]) > extentA[r] + rb);
+		}
+		for (int c = 0; c < 3; ++c) {
+			LANES ra = extentA[0] * absolute[0][c] + extentA[1] * absolute[1][c] + extentA[2] * absolute[2][c];
+			LANES projected = t[0] * rotation[0][c] + t[1] * rotation[1][c] + t[2] * rotation[2][c];
+			separated = separated | (abs(projected) > ra + extentB[c]);
+		}
+		separated = separated | separatedOnEdges<0, 0>(rotation, absolute, t, extentA, extentB)
+			| separatedOnEdges<0, 1>(rotation, absolute, t, extentA, extentB) | separatedOnEdges<0, 2>(rotation, absolute, t, extentA, extentB)
+			| separatedOnEdges<1, 0>(rotation, absolute, t, extentA, extentB) | separatedOnEdges<1, 1>(rotation, absolute, t, extentA, extentB)
+			| separatedOnEdges<1, 2>(rotation, absolute, t, extentA, extentB) | separatedOnEdges<2, 0>(rotation, absolute, t, extentA, extentB)
+			| separatedOnEdges<2, 1>(rotation, absolute, t, extentA, extentB) | separatedOnEdges<2, 2>(rotation, absolute, t, extentA, extentB);
+		andNot(separated, LANES::set(0.0f) <= LANES::set(0.0f)).store(&batch.hit[i]);
+	}
+}
+#endif
+
+// Runs the exact test on broadphase pairs across the thread pool. Every participant appends
+// hits to its own buffer; the buffers are merged and sorted by pair index, so the result is
+// identical for any thread count.
+struct NARROWPHASE {
+	THREAD_POOL pool;
+	size_t grain = 256;
+	std::vector<std::vector<uint32_t>> threadHits;
+	std::vector<uint32_t> hits; // indices into the pair list, ascending
+	double time = 0.0;
+
+	size_t getThreadCount() const {
+		return pool.getThreadCount();
+	}
+	void setThreadCount(size_t threadCount) {
+		pool.RESIZE(threadCount);
+	}
+
+	template<typename TEST>
+	const std::vector<uint32_t>& RUN(const std::vector<BROADPHASE_PAIR>& pairs, TEST&& test) {
+		auto start = std::chrono::high_resolution_clock::now();
+		threadHits.resize(pool.getThreadCount());
+		for (auto& buffer : threadHits) {
+			buffer.clear();
+		}
+		pool.PARALLEL_FOR(pairs.size(), grain, [&](size_t begin, size_t end, size_t worker) {
+			std::vector<uint32_t>& buffer = threadHits[worker];
+			for (size_t i = begin; i < end; ++i) {
+				if (test(pairs[i])) {
+					buffer.push_back(static_cast<uint32_t>(i));
+				}
+			}
+		});
+		hits.clear();
+		for (auto& buffer : threadHits) {
+			hits.insert(hits.end(), buffer.begin(), buffer.end());
+		}
+		std::sort(hits.begin(), hits.end());
+		auto end = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<double, std::milli>(end - start).count();
+		return hits;
+	}
+
+	// RUN over the shapes by proxy: each worker sorts its pairs by kind into blocks and tests a block 8 or
+	// 4 pairs at a time once it fills. Gives the same hits as RUN with testShapes.
+	const std::vector<uint32_t>& RUN_BATCHED(const std::vector<BROADPHASE_PAIR>& pairs, const NARROWPHASE_SHAPES& shapes) {
+		auto start = std::chrono::high_resolution_clock::now();
+		threadHits.resize(pool.getThreadCount());
+		threadBatches.resize(pool.getThreadCount());
+		for (auto& buffer : threadHits) {
+			buffer.clear();
+		}
+		pool.PARALLEL_FOR(pairs.size(), grain, [&](size_t begin, size_t end, size_t worker) {
+			std::vector<uint32_t>& buffer = threadHits[worker];
+			std::array<PAIR_BATCH, static_cast<size_t>(PAIR_KIND::COUNT)>& batches = threadBatches[worker];
+			for (size_t i = begin; i < end; ++i) {
+#if defined(UNARROWPHASE_LANES)
+				// The broadphase pairs reach their second shapes in no particular order
+				if (i + PREFETCH_DISTANCE < end) {
+					_mm_prefetch(reinterpret_cast<const char*>(&shapes[pairs[i + PREFETCH_DISTANCE].b]), _MM_HINT_T0);
+				}
+#endif
+				const BROADPHASE_PAIR& pair = pairs[i];
+				bool sphereA = shapes[pair.a].sphere != 0;
+				bool sphereB = shapes[pair.b].sphere != 0;
+				PAIR_KIND kind = sphereA && sphereB ? PAIR_KIND::SPHERE_SPHERE
+					: sphereA || sphereB ? PAIR_KIND::SPHERE_BOX : PAIR_KIND::BOX_BOX;
+				PAIR_BATCH& batch = batches[static_cast<size_t>(kind)];
+				batch.PUSH(static_cast<uint32_t>(i), sphereB && !sphereA ? pair.b : pair.a, sphereB && !sphereA ? pair.a : pair.b);
+				if (batch.isFull()) {
+					testBatch(kind, batch, shapes, buffer);
+				}
+			}
+			for (size_t kind = 0; kind < batches.size(); ++kind) {
+				if (batches[kind].count > 0) {
+					testBatch(static_cast<PAIR_KIND>(kind), batches[kind], shapes, buffer);
+				}
+			}
+		});
+		hits.clear();
+		for (auto& buffer : threadHits) {
+			hits.insert(hits.end(), buffer.begin(), buffer.end());
+		}
+		std::sort(hits.begin(), hits.end());
+		auto end = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<double, std::milli>(end - start).count();
+		return hits;
+	}
+
+private:
+	static constexpr size_t PREFETCH_DISTANCE = 16;
+	std::vector<std::array<PAIR_BATCH, static_cast<size_t>(PAIR_KIND::COUNT)>> threadBatches;
+
+	// Tests and empties a block, adding its hits to the worker's buffer
+	static void testBatch(PAIR_KIND kind, PAIR_BATCH& batch, const NARROWPHASE_SHAPES& shapes, std::vector<uint32_t>& buffer) {
+#if defined(UNARROWPHASE_LANES)
+		batch.PAD();
+		switch (kind) {
+		case PAIR_KIND::SPHERE_SPHERE:
+			testSphereSphereLanes(shapes, batch);
+			break;
+		case PAIR_KIND::SPHERE_BOX:
+			testSphereBoxLanes(shapes, batch);
+			break;
+		default:
+			testBoxBoxLanes(shapes, batch);
+			break;
+		}
+#else
+		(void)kind;
+		for (size_t i = 0; i < batch.count; ++i) {
+			batch.hit[i] = testShapes(shapes, batch.proxyA[i], batch.proxyB[i]) ? 1.0f : 0.0f;
+		}
+#endif
+		for (size_t i = 0; i < batch.count; ++i) {
+			if (batch.isHit(i)) {
+				buffer.push_back(batch.pairs[i]);
+			}
+		}
+		batch.count = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef __UPICK_HPP__
+#define __UPICK_HPP__
+#include "UGL.hpp"
+
+struct PICK_RESULT : public RAY_HIT {
+	size_t model = SIZE_MAX;  // index into the models passed to PICK
+	glm::vec3 point = { 0.0f, 0.0f, 0.0f }; // world space
+};
+
+// Ray picking over the scene: a dynamic AABB tree over every model's world bounds finds candidates
+// nearest first, and each candidate's mesh TRIANGLE_BVH gives the exact hit in model space.
+// Models report their own transform changes, so a PICK only refits those instead of scanning the scene.
+struct SCENE_PICKER {
+	AABB_TREE_BROADPHASE tree;
+	double time = 0.0;      // ms of the last PICK, refit included
+	size_t refitCount = 0;  // models refit by the last PICK
+	size_t candidates = 0;  // meshes ray cast by the last PICK
+
+	void UPDATE(const std::vector<MODEL*>& models) {
+		refitCount = 0;
+		size_t kept = std::min(proxies.size(), models.size());
+		for (size_t i = 0; i < kept; ++i) {
+			if (proxies[i] != models[i]) {
+				kept = i;
+				break;
+			}
+		}
+		// Anything but appending renumbers the proxies
+		if (kept < proxies.size()) {
+			REBUILD(models);
+			return;
+		}
+		for (uint32_t slot : *changed) {
+			MODEL& model = *models[slot];
+			model.transformQueued = false;
+			bounds[slot] = model.getWorldBounds();
+			tree.UPDATE_PROXY(slot, bounds[slot]);
+			++refitCount;
+		}
+		changed->clear();
+		for (size_t i = kept; i < models.size(); ++i) {
+			track(*models[i], static_cast<uint32_t>(i));
+			bounds.push_back(models[i]->getWorldBounds());
+			tree.ADD_PROXY(bounds.back());
+			++refitCount;
+		}
+	}
+
+	void REBUILD(const std::vector<MODEL*>& models) {
+		// Models dropped from the scene keep the old list; a new one leaves their late pushes behind
+		changed = std::make_shared<std::vector<uint32_t>>();
+		proxies.clear();
+		bounds.clear();
+		for (size_t i = 0; i < models.size(); ++i) {
+			track(*models[i], static_cast<uint32_t>(i));
+			bounds.push_back(models[i]->getWorldBounds());
+		}
+		tree.REBUILD(bounds);
+		refitCount = models.size();
+	}
+
+	// Nearest triangle hit along the ray, with the model it belongs to
+	PICK_RESULT PICK(const std::vector<MODEL*>& models, const glm::vec3& origin, const glm::vec3& direction) {
+		auto start = std::chrono::high_resolution_clock::now();
+		UPDATE(models);
+		candidates = 0;
+
+		PICK_RESULT result;
+		RAY ray(origin, glm::normalize(direction));
+		tree.RAYCAST(FLT_MAX,
+			[&](const AABB& box, float maxDistance) {
+				return ray.intersect(box, maxDistance);
+			},
+			[&](uint32_t proxy, float maxDistance) {
+				// The tree holds fattened boxes; the exact bounds cull most of the slack
+				if (ray.intersect(bounds[proxy], maxDistance) == FLT_MAX) {
+					return maxDistance;
+				}
+				++candidates;
+				RAY_HIT hit;
+				hit.distance = maxDistance;
+				if (RAYCAST_MODEL(*models[proxy], ray, hit)) {
+					static_cast<RAY_HIT&>(result) = hit;
+					result.model = proxy;
+				}
+				return hit.distance;
+			});
+		if (result.isHit()) {
+			result.point = ray.origin + ray.direction * result.distance;
+		}
+		time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		return result;
+	}
+
+	// Exact test against one model's triangles. The ray is moved into model space without renormalizing,
+	// so distances along it stay world distances.
+	static bool RAYCAST_MODEL(const MODEL& model, const RAY& ray, RAY_HIT& hit) {
+		glm::mat4 matrix = model.getModelMatrix();
+		if (std::fabs(glm::determinant(matrix)) < 1e-12f) {
+			return false;
+		}
+		glm::mat4 inverse = glm::inverse(matrix);
+		RAY local(glm::vec3(inverse * glm::vec4(ray.origin, 1.0f)), glm::vec3(inverse * glm::vec4(ray.direction, 0.0f)));
+		return model.getMesh()->getTriangleBVH().RAYCAST(local, hit);
+	}
+
+private:
+	std::vector<MODEL*> proxies; // proxy i is models[i] as of the last UPDATE
+	std::vector<AABB> bounds;
+	std::shared_ptr<std::vector<uint32_t>> changed = std::make_shared<std::vector<uint32_t>>(); // proxies to refit
+
+	void track(MODEL& model, uint32_t slot) {
+		proxies.push_back(&model);
+		model.transformListener = changed;
+		model.transformSlot = slot;
+		model.transformQueued = false;
+	}
+};
+
+#endif
@@ -0,0 +1,282 @@
+#ifndef __UPROFILE_HPP__
+#define __UPROFILE_HPP__
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU markers. On by default in debug builds; release builds compile every marker out unless built
+// with UPROFILE_ENABLED=1.
+#ifndef UPROFILE_ENABLED
+#ifdef NDEBUG
+#define UPROFILE_ENABLED 0
+#else
+#define UPROFILE_ENABLED 1
+#endif
+#endif
+
+#if UPROFILE_ENABLED
+#define UPROFILE_CONCAT_(a, b) a##b
+#define UPROFILE_CONCAT(a, b) UPROFILE_CONCAT_(a, b)
+// name must outlive the program (a string literal); events keep the pointer
+#define UPROFILE_SCOPE(name) PROFILE_SCOPE UPROFILE_CONCAT(profileScope, __LINE__)(name)
+#define UPROFILE_FRAME() UPROFILE_SCOPE(PROFILE_FRAME)
+#define UPROFILE_THREAD(name) getProfiler().setThreadName(name)
+#else
+#define UPROFILE_SCOPE(name) ((void)0)
+#define UPROFILE_FRAME() ((void)0)
+#define UPROFILE_THREAD(name) ((void)0)
+#endif
+
+// Name of the scope around one engineLoop; the overlay cuts its flame graph at these
+inline constexpr const char* PROFILE_FRAME = "Frame";
+
+struct PROFILE_EVENT {
+	const char* name;
+	uint64_t start; // ns since the profiler epoch
+	uint64_t end;
+	uint32_t depth; // enclosing scopes on the same thread
+};
+
+// One thread's events. Only the owning thread writes, so PUSH is a few stores and a release increment; readers
+// copy behind it and throw away whatever the writer may have lapped while they were copying. Slot fields are
+// relaxed atomics, so a copy racing an overwrite is torn rather than undefined, and the fences pair up like a
+// seqlock's: a reader that saw any field of an overwrite also sees the head that makes it discard the slot.
+struct PROFILE_RING {
+	static constexpr uint64_t CAPACITY = 1 << 15;
+
+	std::string threadName;
+	uint32_t threadIndex = 0;
+	uint32_t depth = 0; // owning thread only
+
+	PROFILE_RING() : slots(new SLOT[CAPACITY]) {}
+
+	void PUSH(const PROFILE_EVENT& event) {
+		uint64_t index = head.load(std::memory_order_relaxed);
+		SLOT& slot = slots[index & (CAPACITY - 1)];
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.name.store(event.name, std::memory_order_relaxed);
+		slot.start.store(event.start, std::memory_order_relaxed);
+		slot.end.store(event.end, std::memory_order_relaxed);
+		slot.depth.store(event.depth, std::memory_order_relaxed);
+		head.store(index + 1, std::memory_order_release);
+	}
+
+	// Appends the events written since cursor that are still in the ring, and moves cursor past them
+	void READ(uint64_t& cursor, std::vector<PROFILE_EVENT>& out) const {
+		uint64_t end = head.load(std::memory_order_acquire);
+		uint64_t first = std::max(cursor, end > CAPACITY ? end - CAPACITY : 0);
+		size_t begin = out.size();
+		for (uint64_t i = first; i < end; ++i) {
+			const SLOT& slot = slots[i & (CAPACITY - 1)];
+			out.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+				slot.end.load(std::memory_order_relaxed), slot.depth.load(std::memory_order_relaxed) });
+		}
+		// Slots the writer reached meanwhile, plus the one it may be filling right now, are not trustworthy
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t after = head.load(std::memory_order_relaxed) + 1;
+		uint64_t valid = after > CAPACITY ? after - CAPACITY : 0;
+		if (valid > first) {
+			size_t lapped = static_cast<size_t>(std::min(valid, end) - first);
+			out.erase(out.begin() + begin, out.begin() + begin + lapped);
+		}
+		cursor = end;
+	}
+
+private:
+	struct SLOT {
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t> start{ 0 };
+		std::atomic<uint64_t> end{ 0 };
+		std::atomic<uint32_t> depth{ 0 };
+	};
+	std::atomic<uint64_t> head{ 0 }; // events ever pushed
+	std::unique_ptr<SLOT[]> slots;
+};
+
+// Owns one ring per thread that ever recorded a marker. Rings live until exit, so events of finished
+// threads (import workers, a restarted physics thread) can still be read and exported.
+struct PROFILER {
+	PROFILER() : epoch(std::chrono::steady_clock::now()) {}
+
+	uint64_t now() const {
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+	}
+
+	PROFILE_RING& getThreadRing() {
+		thread_local PROFILE_RING* ring = nullptr;
+		if (!ring) {
+			std::lock_guard<std::mutex> lock(mutex);
+			rings.push_back(std::make_unique<PROFILE_RING>());
+			ring = rings.back().get();
+			ring->threadIndex = static_cast<uint32_t>(rings.size() - 1);
+			ring->threadName = "Thread " + std::to_string(ring->threadIndex);
+		}
+		return *ring;
+	}
+	void setThreadName(const char* name) {
+		PROFILE_RING& ring = getThreadRing();
+		std::lock_guard<std::mutex> lock(mutex);
+		ring.threadName = name;
+	}
+
+	std::vector<PROFILE_RING*> getRings() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<PROFILE_RING*> result;
+		for (auto& ring : rings) {
+			result.push_back(ring.get());
+		}
+		return result;
+	}
+
+	// Everything still in the rings as Chrome trace JSON (chrome://tracing, Perfetto)
+	bool EXPORT_CHROME_TRACE(const std::string& path) {
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		std::fprintf(file, "{\"traceEvents\":[\n");
+		bool first = true;
+		std::vector<PROFILE_EVENT> events;
+		for (PROFILE_RING* ring : getRings()) {
+			std::string threadName;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				threadName = ring->threadName;
+			}
+			std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", ring->threadIndex, threadName.c_str());
+			first = false;
+			uint64_t cursor = 0;
+			events.clear();
+			ring->READ(cursor, events);
+			for (const PROFILE_EVENT& event : events) {
+				std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, ring->threadIndex, event.start / 1000.0, (event.end - event.start) / 1000.0);
+			}
+		}
+		std::fprintf(file, "\n]}\n");
+		return std::fclose(file) == 0;
+	}
+
+private:
+	std::chrono::steady_clock::time_point epoch;
+	std::mutex mutex; // rings and thread names
+	std::vector<std::unique_ptr<PROFILE_RING>> rings;
+};
+
+inline PROFILER& getProfiler() {
+	static PROFILER profiler;
+	return profiler;
+}
+
+struct PROFILE_SCOPE {
+	explicit PROFILE_SCOPE(const char* name) : name(name), ring(getProfiler().getThreadRing()), start(getProfiler().now()) {
+		++ring.depth;
+	}
+	PROFILE_SCOPE(const PROFILE_SCOPE&) = delete;
+	PROFILE_SCOPE& operator=(const PROFILE_SCOPE&) = delete;
+	~PROFILE_SCOPE() {
+		--ring.depth;
+		ring.PUSH({ name, start, getProfiler().now(), ring.depth });
+	}
+
+private:
+	const char* name;
+	PROFILE_RING& ring;
+	uint64_t start;
+};
+
+// Rolling per-marker totals and the last complete frame of the calling thread, fed once per GUI frame
+struct PROFILE_HISTORY {
+	static constexpr size_t FRAMES = 240;
+
+	struct SERIES {
+		const char* name;
+		std::vector<float> ms = std::vector<float>(FRAMES, 0.0f); // summed over all threads, one slot per UPDATE
+	};
+
+	std::vector<SERIES> series;
+	size_t column = 0;                    // slot written by the last UPDATE
+	std::vector<PROFILE_EVENT> lastFrame; // a PROFILE_FRAME event first, then the events nested in it
+	bool paused = false;
+
+	// Drains every ring; while paused the events are consumed but the history is kept as it is
+	void UPDATE() {
+		PROFILE_RING& own = getProfiler().getThreadRing();
+		std::vector<PROFILE_RING*> rings = getProfiler().getRings();
+		cursors.resize(rings.size(), 0);
+		if (!paused) {
+			column = (column + 1) % FRAMES;
+			for (SERIES& entry : series) {
+				entry.ms[column] = 0.0f;
+			}
+		}
+		for (size_t r = 0; r < rings.size(); ++r) {
+			events.clear();
+			rings[r]->READ(cursors[r], events);
+			if (paused) {
+				continue;
+			}
+			for (const PROFILE_EVENT& event : events) {
+				getSeries(event.name).ms[column] += (event.end - event.start) / 1e6f;
+			}
+			if (rings[r] == &own) {
+				collectFrame();
+			}
+		}
+	}
+
+	float getMax(const SERIES& entry) const {
+		return *std::max_element(entry.ms.begin(), entry.ms.end());
+	}
+
+private:
+	std::vector<uint64_t> cursors;        // per ring, in getRings order
+	std::vector<PROFILE_EVENT> events;    // scratch
+	std::vector<PROFILE_EVENT> pending;   // own events after the last complete frame
+
+	SERIES& getSeries(const char* name) {
+		for (SERIES& entry : series) {
+			if (entry.name == name || std::strcmp(entry.name, name) == 0) {
+				return entry;
+			}
+		}
+		series.push_back({ name });
+		return series.back();
+	}
+
+	// Scopes are pushed when they close, so a frame arrives after everything nested in it
+	void collectFrame() {
+		pending.insert(pending.end(), events.begin(), events.end());
+		size_t frame = pending.size();
+		for (size_t i = pending.size(); i-- > 0;) {
+			if (std::strcmp(pending[i].name, PROFILE_FRAME) == 0) {
+				frame = i;
+				break;
+			}
+		}
+		if (frame == pending.size()) {
+			if (pending.size() > PROFILE_RING::CAPACITY) {
+				pending.clear(); // no frame markers on this thread
+			}
+			return;
+		}
+		const PROFILE_EVENT& root = pending[frame];
+		lastFrame.assign(1, root);
+		for (size_t i = 0; i < frame; ++i) {
+			if (pending[i].start >= root.start && pending[i].end <= root.end) {
+				lastFrame.push_back(pending[i]);
+			}
+		}
+		pending.erase(pending.begin(), pending.begin() + frame + 1);
+	}
+};
+
+#endif
@@ -0,0 +1,1094 @@
+#ifndef __URENDER_HPP__
+#define __URENDER_HPP__
+#include "UPHYSIC.hpp"
+#include "UBVH.hpp"
+#include "USIMPLIFY.hpp"
+#include "UGLSTATE.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Per-frame GPU traffic counters, reset at the start of every engineLoop
+struct RENDER_STATS {
+	size_t bytesUploaded = 0;
+	size_t buffersCreated = 0;
+	size_t buffersDeleted = 0;
+	size_t drawCalls = 0;
+	size_t instancesDrawn = 0;
+	size_t trianglesDrawn = 0;
+	double submitTime = 0.0; // ms of CPU time spent in DRAW_WORLD
+
+	void RESET() {
+		bytesUploaded = 0;
+		buffersCreated = 0;
+		buffersDeleted = 0;
+		drawCalls = 0;
+		instancesDrawn = 0;
+		trianglesDrawn = 0;
+		submitTime = 0.0;
+		getGlState().calls.RESET();
+	}
+};
+
+inline RENDER_STATS& getRenderStats() {
+	static RENDER_STATS stats;
+	return stats;
+}
+
+// Per-instance attributes in InstanceVertexShader.vert: locations 2-5 (model matrix columns), 6 (color)
+// and 8-10 (normal matrix columns)
+struct INSTANCE_DATA {
+	glm::mat4 model;
+	glm::vec3 color;
+	glm::mat3 normalMatrix;
+};
+
+// Per-instance record of the indirect path, the std430 layout of DrawData in IndirectVertexShader.vert.
+// The model matrix has the dequantization of 16-bit positions folded in.
+struct DRAW_DATA {
+	glm::mat4 model;
+	glm::vec4 normalMatrix[3]; // mat3 columns, padded to vec4 as std430 lays them out
+	glm::vec4 color;
+};
+static_assert(sizeof(DRAW_DATA) == 128, "DRAW_DATA is read by the vertex shader as is");
+
+// GL's DrawElementsIndirectCommand
+struct DRAW_ELEMENTS_INDIRECT_COMMAND {
+	uint32_t count;
+	uint32_t instanceCount;
+	uint32_t firstIndex;
+	int32_t baseVertex;
+	uint32_t baseInstance;
+};
+
+enum class POSITION_ENCODING {
+	FLOAT32, // 12 bytes
+	UNORM16  // 8 bytes (3 used), dequantized in the vertex shader by the mesh bounds
+};
+enum class NORMAL_ENCODING {
+	FLOAT32, // 12 bytes
+	OCT16    // 4 bytes, octahedral mapped, decoded in the vertex shader
+};
+enum class UV_ENCODING {
+	FLOAT32, // 8 bytes
+	HALF16   // 4 bytes
+};
+
+// Layout of one interleaved vertex: position (location 0), normal (1), uv (7).
+// Shaders get the matching inputs from getDefines().
+struct VERTEX_FORMAT {
+	POSITION_ENCODING position = POSITION_ENCODING::FLOAT32;
+	NORMAL_ENCODING normal = NORMAL_ENCODING::FLOAT32;
+	UV_ENCODING uv = UV_ENCODING::FLOAT32;
+
+	static VERTEX_FORMAT FULL() {
+		return {};
+	}
+	static VERTEX_FORMAT COMPACT() {
+		return { POSITION_ENCODING::UNORM16, NORMAL_ENCODING::OCT16, UV_ENCODING::HALF16 };
+	}
+
+	bool operator==(const VERTEX_FORMAT& other) const {
+		return position == other.position && normal == other.normal && uv == other.uv;
+	}
+	bool operator!=(const VERTEX_FORMAT& other) const {
+		return !(*this == other);
+	}
+
+	size_t getNormalOffset() const {
+		return position == POSITION_ENCODING::FLOAT32 ? 12 : 8;
+	}
+	size_t getUvOffset() const {
+		return getNormalOffset() + (normal == NORMAL_ENCODING::FLOAT32 ? 12 : 4);
+	}
+	size_t getStride() const {
+		return getUvOffset() + (uv == UV_ENCODING::FLOAT32 ? 8 : 4);
+	}
+	std::string getDefines() const {
+		return normal == NORMAL_ENCODING::OCT16 ? "#define OCT_NORMALS\n" : "";
+	}
+
+	// Points attributes 0, 1 and 7 of the bound VAO into the bound GL_ARRAY_BUFFER
+	void SET_ATTRIBUTES() const {
+		GLsizei stride = static_cast<GLsizei>(getStride());
+		if (position == POSITION_ENCODING::FLOAT32) {
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		}
+		else {
+			glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)0);
+		}
+		if (normal == NORMAL_ENCODING::FLOAT32) {
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)getNormalOffset());
+		}
+		else {
+			glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)getNormalOffset());
+		}
+		if (uv == UV_ENCODING::FLOAT32) {
+			glVertexAttribPointer(7, 2, GL_FLOAT, GL_FALSE, stride, (void*)getUvOffset());
+		}
+		else {
+			glVertexAttribPointer(7, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)getUvOffset());
+		}
+		glEnableVertexAttribArray(0);
+		glEnableVertexAttribArray(1);
+		glEnableVertexAttribArray(7);
+	}
+};
+
+// Format new meshes are interleaved in
+inline VERTEX_FORMAT& getDefaultVertexFormat() {
+	static VERTEX_FORMAT format = VERTEX_FORMAT::COMPACT();
+	return format;
+}
+
+inline uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t rawExponent = (bits >> 23) & 0xffu;
+	int32_t exponent = static_cast<int32_t>(rawExponent) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffffu;
+	if (rawExponent == 0xffu) {
+		return static_cast<uint16_t>(sign | 0x7c00u | (mantissa ? 0x200u : 0u));
+	}
+	if (exponent >= 31) {
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	}
+	if (exponent <= 0) {
+		// Subnormal half, or zero below its range
+		if (exponent < -10) {
+			return static_cast<uint16_t>(sign);
+		}
+		mantissa |= 0x800000u;
+		uint32_t shift = static_cast<uint32_t>(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1u) {
+			half += 1;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+	uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000u) {
+		half += 1; // round to nearest, a carry moves into the exponent correctly
+	}
+	return static_cast<uint16_t>(half);
+}
+
+// Octahedral normal encoding: the unit sphere folded onto [-1, 1]^2, stored as two snorm16
+inline void encodeOctahedral(const float normal[3], int16_t out[2]) {
+	float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+	float x = length > 0.0f ? normal[0] / length : 0.0f;
+	float y = length > 0.0f ? normal[1] / length : 0.0f;
+	float z = length > 0.0f ? normal[2] / length : 1.0f;
+	if (z < 0.0f) {
+		float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	out[0] = static_cast<int16_t>(std::lround(std::clamp(x, -1.0f, 1.0f) * 32767.0f));
+	out[1] = static_cast<int16_t>(std::lround(std::clamp(y, -1.0f, 1.0f) * 32767.0f));
+}
+
+// VAO + one interleaved vertex VBO (+ index buffer for indexed meshes) that stay resident on the GPU.
+// The owner marks it dirty when the CPU side geometry changes, UPLOAD only touches the GPU then.
+struct MESH_BUFFER {
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLuint instanceVBO = 0;
+	GLsizei vertexCount = 0;
+	GLsizei indexCount = 0;
+	VERTEX_FORMAT format;
+	bool dirty = true;
+
+	MESH_BUFFER() = default;
+	MESH_BUFFER(const MESH_BUFFER&) = delete;
+	MESH_BUFFER& operator=(const MESH_BUFFER&) = delete;
+	~MESH_BUFFER() {
+		RELEASE();
+	}
+
+	bool isResident() const {
+		return VAO != 0;
+	}
+
+	// lodIndices, the coarser levels of a LOD chain, follow indices in the same element buffer
+	void UPLOAD(const std::vector<uint8_t>& vertexData, const VERTEX_FORMAT& vertexFormat, const std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& lodIndices) {
+		RENDER_STATS& stats = getRenderStats();
+		bool layoutChanged = !isResident() || vertexFormat != format;
+		if (!isResident()) {
+			glGenVertexArrays(1, &VAO);
+			glGenBuffers(1, &VBO);
+			glGenBuffers(1, &EBO);
+			stats.buffersCreated += 3;
+		}
+		GL_STATE& state = getGlState();
+		state.BIND_VERTEX_ARRAY(VAO);
+		uploadStream(GL_ARRAY_BUFFER, VBO, vertexData.data(), vertexData.size(), vboSize);
+		if (layoutChanged) {
+			vertexFormat.SET_ATTRIBUTES();
+			format = vertexFormat;
+		}
+		// The element array binding is VAO state
+		if (lodIndices.empty()) {
+			uploadStream(GL_ELEMENT_ARRAY_BUFFER, EBO, indices.data(), indices.size() * sizeof(uint32_t), eboSize);
+		}
+		else {
+			std::vector<uint32_t> chain(indices);
+			chain.insert(chain.end(), lodIndices.begin(), lodIndices.end());
+			uploadStream(GL_ELEMENT_ARRAY_BUFFER, EBO, chain.data(), chain.size() * sizeof(uint32_t), eboSize);
+		}
+		state.BIND_VERTEX_ARRAY(0);
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, 0);
+
+		vertexCount = static_cast<GLsizei>(vertexData.size() / vertexFormat.getStride());
+		indexCount = static_cast<GLsizei>(indices.size());
+		dirty = false;
+	}
+
+	size_t getResidentBytes() const {
+		return static_cast<size_t>(vboSize + eboSize);
+	}
+
+	// Expects the VAO to be bound
+	void DRAW() const {
+		if (indexCount > 0) {
+			glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0);
+		}
+		else {
+			glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+		}
+	}
+	void DRAW_INSTANCED(GLsizei instanceCount) const {
+		if (indexCount > 0) {
+			glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (void*)0, instanceCount);
+		}
+		else {
+			glDrawArraysInstanced(GL_TRIANGLES, 0, vertexCount, instanceCount);
+		}
+	}
+	// A range of the element buffer, e.g. one LOD level
+	void DRAW(GLsizei firstIndex, GLsizei count) const {
+		glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(uint32_t)));
+	}
+	void DRAW_INSTANCED(GLsizei instanceCount, GLsizei firstIndex, GLsizei count) const {
+		glDrawElementsInstanced(GL_TRIANGLES, count, GL_UNSIGNED_INT, (void*)(firstIndex * sizeof(uint32_t)), instanceCount);
+	}
+
+	// Streams the instance array for this frame into the VAO's instance buffer (orphaned on every upload).
+	// Leaves the VAO and the instance buffer bound for the draw that follows.
+	void UPLOAD_INSTANCES(const std::vector<INSTANCE_DATA>& instances) {
+		RENDER_STATS& stats = getRenderStats();
+		GL_STATE& state = getGlState();
+		GLsizeiptr size = static_cast<GLsizeiptr>(instances.size() * sizeof(INSTANCE_DATA));
+		if (instanceVBO == 0) {
+			glGenBuffers(1, &instanceVBO);
+			stats.buffersCreated += 1;
+
+			state.BIND_VERTEX_ARRAY(VAO);
+			state.BIND_BUFFER(GL_ARRAY_BUFFER, instanceVBO);
+			for (GLuint i = 0; i < 4; ++i) {
+				glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA), (void*)(offsetof(INSTANCE_DATA, model) + sizeof(glm::vec4) * i));
+				glEnableVertexAttribArray(2 + i);
+				glVertexAttribDivisor(2 + i, 1);
+			}
+			glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA), (void*)offsetof(INSTANCE_DATA, color));
+			glEnableVertexAttribArray(6);
+			glVertexAttribDivisor(6, 1);
+			for (GLuint i = 0; i < 3; ++i) {
+				glVertexAttribPointer(8 + i, 3, GL_FLOAT, GL_FALSE, sizeof(INSTANCE_DATA), (void*)(offsetof(INSTANCE_DATA, normalMatrix) + sizeof(glm::vec3) * i));
+				glEnableVertexAttribArray(8 + i);
+				glVertexAttribDivisor(8 + i, 1);
+			}
+		}
+		state.BIND_VERTEX_ARRAY(VAO);
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, instanceVBO);
+		if (size > instanceCapacity) {
+			instanceCapacity = size * 2;
+		}
+		glBufferData(GL_ARRAY_BUFFER, instanceCapacity, nullptr, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+		stats.bytesUploaded += static_cast<size_t>(size);
+	}
+
+	void RELEASE() {
+		if (!isResident()) {
+			return;
+		}
+		GL_STATE& state = getGlState();
+		state.FORGET_VERTEX_ARRAY(VAO);
+		state.FORGET_BUFFER(VBO);
+		state.FORGET_BUFFER(instanceVBO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		getRenderStats().buffersDeleted += 3;
+		if (instanceVBO != 0) {
+			glDeleteBuffers(1, &instanceVBO);
+			getRenderStats().buffersDeleted += 1;
+		}
+		VAO = VBO = EBO = instanceVBO = 0;
+		vboSize = eboSize = instanceCapacity = 0;
+		vertexCount = 0;
+		indexCount = 0;
+		dirty = true;
+	}
+
+private:
+	// Sizes are tracked per buffer so an unchanged size is updated in place instead of reallocated
+	GLsizeiptr vboSize = 0;
+	GLsizeiptr eboSize = 0;
+	GLsizeiptr instanceCapacity = 0;
+
+	void uploadStream(GLenum target, GLuint buffer, const void* data, size_t bytes, GLsizeiptr& current) {
+		GLsizeiptr size = static_cast<GLsizeiptr>(bytes);
+		getGlState().BIND_BUFFER(target, buffer);
+		if (size == current) {
+			glBufferSubData(target, 0, size, data);
+		}
+		else {
+			glBufferData(target, size, data, GL_STATIC_DRAW);
+			current = size;
+		}
+		getRenderStats().bytesUploaded += bytes;
+	}
+};
+
+// Free space of a buffer handed out in fixed units (vertices, indices): sorted, coalesced blocks, first fit
+struct FREE_LIST {
+	struct BLOCK {
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	uint32_t capacity = 0;
+	std::vector<BLOCK> blocks;
+
+	bool ALLOCATE(uint32_t size, uint32_t& offset) {
+		if (size == 0) {
+			offset = 0;
+			return true;
+		}
+		for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+			if (it->size >= size) {
+				offset = it->offset;
+				it->offset += size;
+				it->size -= size;
+				if (it->size == 0) {
+					blocks.erase(it);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+	void FREE(uint32_t offset, uint32_t size) {
+		if (size == 0) {
+			return;
+		}
+		auto next = std::lower_bound(blocks.begin(), blocks.end(), offset, [](const BLOCK& block, uint32_t value) { return block.offset < value; });
+		bool joinsPrevious = next != blocks.begin() && std::prev(next)->offset + std::prev(next)->size == offset;
+		bool joinsNext = next != blocks.end() && offset + size == next->offset;
+		if (joinsPrevious && joinsNext) {
+			std::prev(next)->size += size + next->size;
+			blocks.erase(next);
+		}
+		else if (joinsPrevious) {
+			std::prev(next)->size += size;
+		}
+		else if (joinsNext) {
+			next->offset = offset;
+			next->size += size;
+		}
+		else {
+			blocks.insert(next, { offset, size });
+		}
+	}
+	// The first used units taken, the rest up to newCapacity free
+	void RESET(uint32_t newCapacity, uint32_t used) {
+		capacity = newCapacity;
+		blocks.clear();
+		if (used < newCapacity) {
+			blocks.push_back({ used, newCapacity - used });
+		}
+	}
+
+	uint32_t getFree() const {
+		uint32_t free = 0;
+		for (const BLOCK& block : blocks) {
+			free += block.size;
+		}
+		return free;
+	}
+	uint32_t getUsed() const {
+		return capacity - getFree();
+	}
+	// Free units in holes between ranges, what packing would win back
+	uint32_t getFragmented() const {
+		uint32_t free = getFree();
+		return !blocks.empty() && blocks.back().offset + blocks.back().size == capacity ? free - blocks.back().size : free;
+	}
+};
+
+struct GEOMETRY_ARENA;
+
+// A mesh's vertices and index chain inside a GEOMETRY_ARENA; the space goes back when released or destroyed
+struct ARENA_RANGE {
+	GEOMETRY_ARENA* arena = nullptr; // null until uploaded, and again once the arena is gone
+	uint32_t firstVertex = 0;
+	uint32_t vertexCount = 0;
+	uint32_t firstIndex = 0;
+	uint32_t indexCount = 0; // indices, then the LOD chain
+	bool dirty = true;       // the mesh changed since the upload
+
+	ARENA_RANGE() = default;
+	ARENA_RANGE(const ARENA_RANGE&) = delete;
+	ARENA_RANGE& operator=(const ARENA_RANGE&) = delete;
+	~ARENA_RANGE() {
+		RELEASE();
+	}
+
+	bool isResident() const {
+		return arena != nullptr;
+	}
+	void RELEASE();
+};
+
+// Every mesh of one vertex format in a shared vertex buffer and index buffer, so the whole world can be
+// submitted with one multi-draw indirect call. Ranges come from free lists; a mesh that does not fit makes
+// the buffers reallocate larger with the live ranges packed to the front, which DEFRAGMENT also does on
+// demand. Attribute 11 streams 0, 1, 2... per instance: offset by a command's baseInstance, it is the
+// instance's slot in the per-draw storage buffer.
+struct GEOMETRY_ARENA {
+	static constexpr GLuint DRAW_INDEX_LOCATION = 11;
+	static constexpr uint32_t MIN_VERTICES = 1 << 16;
+	static constexpr uint32_t MIN_INDICES = 1 << 18;
+
+	const VERTEX_FORMAT format;
+	GLuint VAO = 0;
+	GLuint VBO = 0;
+	GLuint EBO = 0;
+	GLuint drawIndexVBO = 0;
+	FREE_LIST vertexSpace; // in vertices
+	FREE_LIST indexSpace;  // in indices
+	uint32_t drawIndexCount = 0;
+
+	explicit GEOMETRY_ARENA(const VERTEX_FORMAT& format) : format(format) {}
+	GEOMETRY_ARENA(const GEOMETRY_ARENA&) = delete;
+	GEOMETRY_ARENA& operator=(const GEOMETRY_ARENA&) = delete;
+	// Ranges still out turn non-resident and upload into a new arena when next drawn
+	~GEOMETRY_ARENA() {
+		for (ARENA_RANGE* range : ranges) {
+			range->arena = nullptr;
+			range->dirty = true;
+		}
+		if (VAO == 0) {
+			return;
+		}
+		GL_STATE& state = getGlState();
+		state.FORGET_VERTEX_ARRAY(VAO);
+		state.FORGET_BUFFER(VBO);
+		state.FORGET_BUFFER(EBO);
+		state.FORGET_BUFFER(drawIndexVBO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		getRenderStats().buffersDeleted += 3;
+		if (drawIndexVBO != 0) {
+			glDeleteBuffers(1, &drawIndexVBO);
+			getRenderStats().buffersDeleted += 1;
+		}
+	}
+
+	// Writes a mesh into its range, allocating one first when the mesh is new here or changed size
+	void UPLOAD(ARENA_RANGE& range, const std::vector<uint8_t>& vertexData, const std::vector<uint32_t>& indices,
+		const std::vector<uint32_t>& lodIndices) {
+		size_t stride = format.getStride();
+		uint32_t vertexCount = static_cast<uint32_t>(vertexData.size() / stride);
+		uint32_t indexCount = static_cast<uint32_t>(indices.size() + lodIndices.size());
+		if (range.arena != this || range.vertexCount != vertexCount || range.indexCount != indexCount) {
+			range.RELEASE();
+			allocate(range, vertexCount, indexCount);
+		}
+		GL_STATE& state = getGlState();
+		// The copy targets leave the VAO's element array binding alone
+		state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, VBO);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range.firstVertex * stride), static_cast<GLsizeiptr>(vertexData.size()), vertexData.data());
+		state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, EBO);
+		GLintptr indexOffset = static_cast<GLintptr>(range.firstIndex * sizeof(uint32_t));
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset, static_cast<GLsizeiptr>(indices.size() * sizeof(uint32_t)), indices.data());
+		glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset + static_cast<GLintptr>(indices.size() * sizeof(uint32_t)),
+			static_cast<GLsizeiptr>(lodIndices.size() * sizeof(uint32_t)), lodIndices.data());
+		getRenderStats().bytesUploaded += vertexData.size() + indexCount * sizeof(uint32_t);
+		range.dirty = false;
+	}
+
+	void FREE(ARENA_RANGE& range) {
+		vertexSpace.FREE(range.firstVertex, range.vertexCount);
+		indexSpace.FREE(range.firstIndex, range.indexCount);
+		auto it = std::find(ranges.begin(), ranges.end(), &range);
+		*it = ranges.back();
+		ranges.pop_back();
+		range.arena = nullptr;
+		range.dirty = true;
+	}
+
+	// Packs the live ranges to the front; buffers less than a quarter used shrink to twice their contents
+	void DEFRAGMENT() {
+		auto fit = [](const FREE_LIST& space, uint32_t minimum) {
+			uint32_t used = space.getUsed();
+			return used < space.capacity / 4 ? std::max(used * 2, minimum) : space.capacity;
+		};
+		reallocate(fit(vertexSpace, MIN_VERTICES), fit(indexSpace, MIN_INDICES));
+	}
+	// Holes make up more than a quarter of either buffer
+	bool isFragmented() const {
+		return vertexSpace.getFragmented() > vertexSpace.capacity / 4 || indexSpace.getFragmented() > indexSpace.capacity / 4;
+	}
+
+	// Makes the draw index stream at least count long
+	void RESERVE_DRAW_INDICES(uint32_t count) {
+		if (count <= drawIndexCount || VAO == 0) {
+			return;
+		}
+		GL_STATE& state = getGlState();
+		if (drawIndexVBO == 0) {
+			glGenBuffers(1, &drawIndexVBO);
+			getRenderStats().buffersCreated += 1;
+			state.BIND_VERTEX_ARRAY(VAO);
+			state.BIND_BUFFER(GL_ARRAY_BUFFER, drawIndexVBO);
+			glVertexAttribIPointer(DRAW_INDEX_LOCATION, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+			glEnableVertexAttribArray(DRAW_INDEX_LOCATION);
+			glVertexAttribDivisor(DRAW_INDEX_LOCATION, 1);
+		}
+		drawIndexCount = std::max(count, drawIndexCount * 2);
+		std::vector<uint32_t> sequence(drawIndexCount);
+		for (uint32_t i = 0; i < drawIndexCount; ++i) {
+			sequence[i] = i;
+		}
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, drawIndexVBO);
+		glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sequence.size() * sizeof(uint32_t)), sequence.data(), GL_STATIC_DRAW);
+		getRenderStats().bytesUploaded += sequence.size() * sizeof(uint32_t);
+	}
+
+	size_t getRangeCount() const {
+		return ranges.size();
+	}
+	size_t getCapacityBytes() const {
+		return vertexSpace.capacity * format.getStride() + indexSpace.capacity * sizeof(uint32_t);
+	}
+	size_t getUsedBytes() const {
+		return vertexSpace.getUsed() * format.getStride() + indexSpace.getUsed() * sizeof(uint32_t);
+	}
+
+private:
+	std::vector<ARENA_RANGE*> ranges; // live, so reallocation can move them
+
+	void allocate(ARENA_RANGE& range, uint32_t vertexCount, uint32_t indexCount) {
+		auto fits = [](const FREE_LIST& space, uint32_t size) {
+			return size == 0 || std::any_of(space.blocks.begin(), space.blocks.end(), [size](const FREE_LIST::BLOCK& block) { return block.size >= size; });
+		};
+		if (!fits(vertexSpace, vertexCount) || !fits(indexSpace, indexCount)) {
+			// Packing puts all free space in one block at the end, so growing to used + size is enough
+			reallocate(std::max({ vertexSpace.capacity * 2, vertexSpace.getUsed() + vertexCount, MIN_VERTICES }),
+				std::max({ indexSpace.capacity * 2, indexSpace.getUsed() + indexCount, MIN_INDICES }));
+		}
+		vertexSpace.ALLOCATE(vertexCount, range.firstVertex);
+		indexSpace.ALLOCATE(indexCount, range.firstIndex);
+		range.vertexCount = vertexCount;
+		range.indexCount = indexCount;
+		range.arena = this;
+		ranges.push_back(&range);
+	}
+
+	// New buffers of the given capacities, with every live range copied over back to back on the GPU
+	void reallocate(uint32_t vertexCapacity, uint32_t indexCapacity) {
+		GL_STATE& state = getGlState();
+		RENDER_STATS& stats = getRenderStats();
+		size_t stride = format.getStride();
+		if (VAO == 0) {
+			glGenVertexArrays(1, &VAO);
+			stats.buffersCreated += 1;
+		}
+		GLuint buffers[2];
+		glGenBuffers(2, buffers);
+		stats.buffersCreated += 2;
+		state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, buffers[0]);
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(vertexCapacity * stride), nullptr, GL_STATIC_DRAW);
+		state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, buffers[1]);
+		glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(indexCapacity * sizeof(uint32_t)), nullptr, GL_STATIC_DRAW);
+
+		uint32_t vertexEnd = 0;
+		uint32_t indexEnd = 0;
+		if (VBO != 0) {
+			state.BIND_BUFFER(GL_COPY_READ_BUFFER, VBO);
+			state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, buffers[0]);
+			for (ARENA_RANGE* range : ranges) {
+				if (!range->dirty) {
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range->firstVertex * stride),
+						static_cast<GLintptr>(vertexEnd * stride), static_cast<GLsizeiptr>(range->vertexCount * stride));
+				}
+				range->firstVertex = vertexEnd;
+				vertexEnd += range->vertexCount;
+			}
+			state.BIND_BUFFER(GL_COPY_READ_BUFFER, EBO);
+			state.BIND_BUFFER(GL_COPY_WRITE_BUFFER, buffers[1]);
+			for (ARENA_RANGE* range : ranges) {
+				if (!range->dirty) {
+					glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(range->firstIndex * sizeof(uint32_t)),
+						static_cast<GLintptr>(indexEnd * sizeof(uint32_t)), static_cast<GLsizeiptr>(range->indexCount * sizeof(uint32_t)));
+				}
+				range->firstIndex = indexEnd;
+				indexEnd += range->indexCount;
+			}
+			state.FORGET_BUFFER(VBO);
+			state.FORGET_BUFFER(EBO);
+			glDeleteBuffers(1, &VBO);
+			glDeleteBuffers(1, &EBO);
+			stats.buffersDeleted += 2;
+		}
+		VBO = buffers[0];
+		EBO = buffers[1];
+		vertexSpace.RESET(vertexCapacity, vertexEnd);
+		indexSpace.RESET(indexCapacity, indexEnd);
+
+		// Attribute pointers capture the buffer bound when they are set
+		state.BIND_VERTEX_ARRAY(VAO);
+		state.BIND_BUFFER(GL_ARRAY_BUFFER, VBO);
+		format.SET_ATTRIBUTES();
+		state.BIND_BUFFER(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		state.BIND_VERTEX_ARRAY(0);
+	}
+};
+
+inline void ARENA_RANGE::RELEASE() {
+	if (arena) {
+		arena->FREE(*this);
+	}
+}
+
+// One arena per vertex format in use
+struct GEOMETRY_ARENAS {
+	std::vector<std::unique_ptr<GEOMETRY_ARENA>> arenas;
+
+	// Multi-draw indirect and shader storage buffers are core from 4.3
+	static bool isSupported() {
+		return GLEW_VERSION_4_3;
+	}
+
+	GEOMETRY_ARENA& GET(const VERTEX_FORMAT& format) {
+		for (auto& arena : arenas) {
+			if (arena->format == format) {
+				return *arena;
+			}
+		}
+		arenas.push_back(std::make_unique<GEOMETRY_ARENA>(format));
+		return *arenas.back();
+	}
+	// Packs the arenas that deleted meshes left full of holes; an empty arena is dropped
+	void COMPACT() {
+		for (auto it = arenas.begin(); it != arenas.end();) {
+			if ((*it)->getRangeCount() == 0) {
+				it = arenas.erase(it);
+				continue;
+			}
+			if ((*it)->isFragmented()) {
+				(*it)->DEFRAGMENT();
+			}
+			++it;
+		}
+	}
+	void CLEAR() {
+		arenas.clear();
+	}
+};
+
+inline GEOMETRY_ARENAS& getGeometryArenas() {
+	static GEOMETRY_ARENAS arenas;
+	return arenas;
+}
+
+// Import-time simplification ratios and draw-time switch points of the LOD chain. Level i + 1 is drawn once the
+// bounding sphere covers less than screenSizes[i] of the viewport height; hysteresis widens every switch point
+// into a band, so a model sitting on it does not pop between two levels from frame to frame.
+struct LOD_SETTINGS {
+	bool enabled = true;
+	std::vector<float> ratios = { 0.5f, 0.25f, 0.1f }; // triangles kept per level, of the full mesh
+	std::vector<float> screenSizes = { 0.3f, 0.12f, 0.05f };
+	float hysteresis = 0.15f; // relative width of the band around each switch point
+	size_t minTriangles = 64; // smaller meshes get no chain
+
+	// Level to draw at screenSize, given the level drawn last frame
+	size_t SELECT(float screenSize, size_t current, size_t levelCount) const {
+		if (!enabled || levelCount <= 1) {
+			return 0;
+		}
+		size_t maxLevel = std::min(levelCount - 1, screenSizes.size());
+		size_t level = std::min(current, maxLevel);
+		while (level < maxLevel && screenSize < screenSizes[level] * (1.0f - hysteresis)) {
+			++level;
+		}
+		while (level > 0 && screenSize > screenSizes[level - 1] * (1.0f + hysteresis)) {
+			--level;
+		}
+		return level;
+	}
+};
+
+inline LOD_SETTINGS& getLodSettings() {
+	static LOD_SETTINGS settings;
+	return settings;
+}
+
+// One level of a LOD chain: a range of MESH::lodIndices and the simplification error in mesh units
+struct MESH_LOD {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;
+};
+
+// One node of an imported file's hierarchy, transform relative to its parent. The geometry is baked
+// into the file's space at import, so nodes only place things attached to them.
+struct MESH_NODE {
+	char name[56];   // truncated, always terminated
+	int32_t parent;  // index into MESH::nodes, -1 for a root
+	float position[3];
+	float rotation[3]; // Euler degrees, applied X then Y then Z
+	float scale[3];
+};
+
+// CPU side geometry plus its resident GPU copy, shared by every model drawing the same shape.
+// With indices, each (position, normal, uv) tuple is stored once; without, every 3 vertices are a triangle.
+// The float streams are the editable source; the GPU gets them interleaved and encoded in format.
+struct MESH {
+	std::vector<float> vertices;
+	std::vector<float> normals;
+	std::vector<float> textures;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> lodIndices; // coarser levels, back to back, indexing the same vertices
+	std::vector<MESH_LOD> lods;       // level 1 and up; level 0 is indices
+	std::vector<MESH_NODE> nodes;     // parents before children, empty for built-in shapes
+	VERTEX_FORMAT format = getDefaultVertexFormat();
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	std::vector<uint8_t> vertexData; // interleaved, kept only until uploaded
+	MESH_BUFFER buffer;
+	ARENA_RANGE arenaRange;          // the copy the indirect path draws from
+	TRIANGLE_BVH bvh;
+	bool bvhDirty = true;
+
+	MESH() = default;
+	// For meshes built off the GL thread, which must not read the editor's default format
+	explicit MESH(const VERTEX_FORMAT& format) : format(format) {}
+
+	size_t getVertexCount() const {
+		return vertices.size() / 3;
+	}
+	size_t getTriangleCount() const {
+		return indices.empty() ? getVertexCount() / 3 : indices.size() / 3;
+	}
+	size_t getMemoryBytes() const {
+		return (vertices.size() + normals.size() + textures.size()) * sizeof(float) + (indices.size() + lodIndices.size()) * sizeof(uint32_t);
+	}
+	size_t getLodCount() const {
+		return lods.size() + 1;
+	}
+	// Range of a level in the element buffer, where the chain follows indices; clamped to the coarsest level
+	MESH_LOD getLod(size_t level) const {
+		if (level == 0 || lods.empty()) {
+			return { 0, static_cast<uint32_t>(indices.size()), 0.0f };
+		}
+		MESH_LOD lod = lods[std::min(level, lods.size()) - 1];
+		lod.firstIndex += static_cast<uint32_t>(indices.size());
+		return lod;
+	}
+
+	// Simplifies each level from the previous one. Stops early when a level no longer saves enough to be worth its memory.
+	void BUILD_LODS(const LOD_SETTINGS& settings) {
+		lods.clear();
+		lodIndices.clear();
+		if (indices.empty() || getTriangleCount() < settings.minTriangles) {
+			return;
+		}
+		MESH_SIMPLIFIER simplifier;
+		std::vector<uint32_t> source = indices;
+		float error = 0.0f;
+		for (float ratio : settings.ratios) {
+			size_t target = static_cast<size_t>(getTriangleCount() * ratio) * 3;
+			std::vector<uint32_t> simplified = simplifier.SIMPLIFY(vertices, normals, source, target);
+			if (simplified.empty() || simplified.size() > source.size() * 9 / 10) {
+				break;
+			}
+			error += simplifier.error;
+			lods.push_back({ static_cast<uint32_t>(lodIndices.size()), static_cast<uint32_t>(simplified.size()), error });
+			lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+			source = std::move(simplified);
+		}
+		setGeometryDirty();
+	}
+
+	// Built on first use and after the geometry changed, for exact ray picking
+	const TRIANGLE_BVH& getTriangleBVH() {
+		if (bvhDirty) {
+			bvh.BUILD(vertices, indices);
+			bvhDirty = false;
+		}
+		return bvh;
+	}
+
+	void setFormat(const VERTEX_FORMAT& newFormat) {
+		if (newFormat != format) {
+			format = newFormat;
+			vertexData.clear();
+			setGeometryDirty();
+		}
+	}
+	// Both GPU copies re-upload before they are next drawn
+	void setGeometryDirty() {
+		buffer.dirty = true;
+		arenaRange.dirty = true;
+	}
+
+	// 16-bit positions are stored relative to the bounds; the vertex shader computes mPos * scale + offset
+	glm::vec3 getPositionOffset() const {
+		return format.position == POSITION_ENCODING::FLOAT32 ? glm::vec3(0.0f) : boundsMin;
+	}
+	glm::vec3 getPositionScale() const {
+		return format.position == POSITION_ENCODING::FLOAT32 ? glm::vec3(1.0f) : boundsMax - boundsMin;
+	}
+
+	// Encodes the float streams into vertexData. Safe off the GL thread, e.g. right after an import.
+	void INTERLEAVE() {
+		size_t count = getVertexCount();
+		size_t stride = format.getStride();
+		boundsMin = glm::vec3(count > 0 ? FLT_MAX : 0.0f);
+		boundsMax = glm::vec3(count > 0 ? -FLT_MAX : 0.0f);
+		for (size_t i = 0; i < count; ++i) {
+			glm::vec3 position(vertices[i * 3], vertices[i * 3 + 1], vertices[i * 3 + 2]);
+			boundsMin = glm::min(boundsMin, position);
+			boundsMax = glm::max(boundsMax, position);
+		}
+		glm::vec3 extent = boundsMax - boundsMin;
+		glm::vec3 inverseExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+		bool hasUv = textures.size() >= count * 2;
+
+		vertexData.assign(count * stride, 0);
+		for (size_t i = 0; i < count; ++i) {
+			uint8_t* out = &vertexData[i * stride];
+			const float* position = &vertices[i * 3];
+			const float* normal = &normals[i * 3];
+			float uv[2] = { hasUv ? textures[i * 2] : 0.0f, hasUv ? textures[i * 2 + 1] : 0.0f };
+			if (format.position == POSITION_ENCODING::FLOAT32) {
+				std::memcpy(out, position, 12);
+			}
+			else {
+				uint16_t quantized[4] = { 0, 0, 0, 0 };
+				for (int axis = 0; axis < 3; ++axis) {
+					float t = (position[axis] - boundsMin[axis]) * inverseExtent[axis];
+					quantized[axis] = static_cast<uint16_t>(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+				}
+				std::memcpy(out, quantized, 8);
+			}
+			out += format.getNormalOffset();
+			if (format.normal == NORMAL_ENCODING::FLOAT32) {
+				std::memcpy(out, normal, 12);
+			}
+			else {
+				int16_t encoded[2];
+				encodeOctahedral(normal, encoded);
+				std::memcpy(out, encoded, 4);
+			}
+			out = &vertexData[i * stride + format.getUvOffset()];
+			if (format.uv == UV_ENCODING::FLOAT32) {
+				std::memcpy(out, uv, 8);
+			}
+			else {
+				uint16_t half[2] = { floatToHalf(uv[0]), floatToHalf(uv[1]) };
+				std::memcpy(out, half, 4);
+			}
+		}
+	}
+
+	void BIND() {
+		if (buffer.dirty) {
+			if (vertexData.empty()) {
+				INTERLEAVE();
+			}
+			buffer.UPLOAD(vertexData, format, indices, lodIndices);
+			std::vector<uint8_t>().swap(vertexData);
+			arenaRange.RELEASE();
+		}
+		getGlState().BIND_VERTEX_ARRAY(buffer.VAO);
+	}
+	// Puts the geometry in the arena of its format, when it is not there yet or changed. Uploading to either
+	// place gives up the other, so a mesh has a single copy on the GPU whichever path draws it.
+	const ARENA_RANGE& BIND_ARENA() {
+		GEOMETRY_ARENA& arena = getGeometryArenas().GET(format);
+		if (arenaRange.dirty || arenaRange.arena != &arena) {
+			if (vertexData.empty()) {
+				INTERLEAVE();
+			}
+			arena.UPLOAD(arenaRange, vertexData, indices, lodIndices);
+			std::vector<uint8_t>().swap(vertexData);
+			buffer.RELEASE();
+		}
+		return arenaRange;
+	}
+};
+
+// Builds an indexed MESH from triangle corners, welding corners whose position, normal and uv are bit-identical
+struct MESH_BUILDER {
+	struct VERTEX_KEY {
+		uint32_t bits[8];
+
+		bool operator==(const VERTEX_KEY& other) const {
+			return std::memcmp(bits, other.bits, sizeof(bits)) == 0;
+		}
+	};
+	struct VERTEX_KEY_HASH {
+		size_t operator()(const VERTEX_KEY& key) const {
+			uint64_t hash = 14695981039346656037ull;
+			for (uint32_t bits : key.bits) {
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+
+	MESH& mesh;
+	std::unordered_map<VERTEX_KEY, uint32_t, VERTEX_KEY_HASH> lookup;
+	size_t cornerCount = 0;
+
+	// Expects an empty mesh; every corner added afterwards is welded against the others
+	MESH_BUILDER(MESH& mesh) : mesh(mesh) {}
+
+	void ADD_CORNER(const float position[3], const float normal[3], const float uv[2]) {
+		++cornerCount;
+		auto [it, inserted] = lookup.emplace(makeKey(position, normal, uv), static_cast<uint32_t>(mesh.getVertexCount()));
+		if (inserted) {
+			mesh.vertices.insert(mesh.vertices.end(), position, position + 3);
+			mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+			mesh.textures.insert(mesh.textures.end(), uv, uv + 2);
+		}
+		mesh.indices.push_back(it->second);
+	}
+
+	// Size the same corners would take as separate, unindexed vertices
+	size_t getExpandedBytes() const {
+		return cornerCount * 8 * sizeof(float);
+	}
+
+private:
+	static uint32_t toBits(float value) {
+		if (value == 0.0f) {
+			value = 0.0f; // -0 welds with +0
+		}
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+	static VERTEX_KEY makeKey(const float position[3], const float normal[3], const float uv[2]) {
+		return { { toBits(position[0]), toBits(position[1]), toBits(position[2]),
+			toBits(normal[0]), toBits(normal[1]), toBits(normal[2]),
+			toBits(uv[0]), toBits(uv[1]) } };
+	}
+};
+
+// Meshes loaded from files, so importing the same file twice shares the geometry
+struct MESH_LIBRARY {
+	std::unordered_map<std::string, std::weak_ptr<MESH>> meshes;
+
+	std::shared_ptr<MESH> FIND(const std::string& key) {
+		auto it = meshes.find(key);
+		if (it == meshes.end()) {
+			return nullptr;
+		}
+		std::shared_ptr<MESH> mesh = it->second.lock();
+		if (!mesh) {
+			meshes.erase(it);
+		}
+		return mesh;
+	}
+	void ADD(const std::string& key, const std::shared_ptr<MESH>& mesh) {
+		meshes[key] = mesh;
+	}
+	template<typename FN>
+	void FOR_EACH(FN fn) {
+		for (auto& [key, weak] : meshes) {
+			if (std::shared_ptr<MESH> mesh = weak.lock()) {
+				fn(key, *mesh);
+			}
+		}
+	}
+};
+
+inline MESH_LIBRARY& getMeshLibrary() {
+	static MESH_LIBRARY library;
+	return library;
+}
+
+// How the visible models are submitted
+enum class RENDER_MODE {
+	PER_MODEL, // one draw call per model
+	INSTANCED, // one instanced draw per mesh and LOD level
+	INDIRECT,  // one multi-draw indirect per vertex format, needs GL 4.3
+	COUNT
+};
+
+inline const char* getRenderModeName(RENDER_MODE mode) {
+	switch (mode) {
+	case RENDER_MODE::PER_MODEL: return "per-model";
+	case RENDER_MODE::INSTANCED: return "instanced";
+	case RENDER_MODE::INDIRECT: return "indirect";
+	default: return "unknown";
+	}
+}
+
+// Runs framesPerMode frames in each render mode, indirect first, and prints the comparison
+struct RENDER_BENCHMARK {
+	static constexpr int MODE_COUNT = static_cast<int>(RENDER_MODE::COUNT);
+
+	bool active = false;
+	int framesPerMode = 100;
+	int frame = 0;
+	double submitTotal[MODE_COUNT] = {};
+	size_t drawCallTotal[MODE_COUNT] = {};
+
+	RENDER_MODE getMode() const {
+		return static_cast<RENDER_MODE>(MODE_COUNT - 1 - std::min(frame / framesPerMode, MODE_COUNT - 1));
+	}
+	bool isFinished() const {
+		return frame >= framesPerMode * MODE_COUNT;
+	}
+
+	void RECORD(const RENDER_STATS& stats) {
+		RENDER_MODE mode = getMode();
+		printf("frame %d [%s]: draw calls %zu, submit %.3f ms\n",
+			frame, getRenderModeName(mode), stats.drawCalls, stats.submitTime);
+		submitTotal[static_cast<int>(mode)] += stats.submitTime;
+		drawCallTotal[static_cast<int>(mode)] += stats.drawCalls;
+		++frame;
+		if (isFinished()) {
+			REPORT();
+			active = false;
+		}
+	}
+
+	void REPORT() const {
+		for (int mode = MODE_COUNT - 1; mode >= 0; --mode) {
+			printf("%s: %.1f draw calls/frame, %.3f ms submit/frame\n", getRenderModeName(static_cast<RENDER_MODE>(mode)),
+				static_cast<double>(drawCallTotal[mode]) / framesPerMode, submitTotal[mode] / framesPerMode);
+		}
+	}
+};
+
+#endif
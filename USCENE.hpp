@@ -0,0 +1,526 @@
+#ifndef __USCENE_HPP__
+#define __USCENE_HPP__
+#include "UENTITY.hpp"
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class SCENE_MODEL_TYPE : uint32_t {
+	CUBE,
+	FBX
+};
+
+enum SCENE_MODEL_FLAGS : uint32_t {
+	SCENE_MODEL_BODY = 1 << 0,
+	SCENE_MODEL_AXIS = 1 << 1
+};
+
+// A name or path in the string section
+struct SCENE_STRING {
+	uint32_t offset;
+	uint32_t length;
+};
+
+// One model, fixed size so the section is a plain array
+struct SCENE_MODEL {
+	SCENE_MODEL_TYPE type;
+	uint32_t asset; // index into the asset section, NO_ASSET for built-in meshes
+	SCENE_STRING name;
+	uint32_t colliderType; // COLLIDER_TYPE
+	uint32_t flags;        // SCENE_MODEL_FLAGS
+	float position[3];
+	float rotation[3];
+	float scale[3];
+	float color[3];
+	float colliderOffset[3];
+	float colliderScale[3];
+	float mass;
+	float velocity[3];
+	uint32_t parent;     // index of the parent model, NO_PARENT for a root
+	uint32_t parentNode; // node of the parent model's mesh it hangs from, NO_PARENT for the model itself
+};
+static_assert(sizeof(SCENE_MODEL) == 120, "SCENE_MODEL is written as is");
+
+struct SCENE_LIGHT {
+	float position[3];
+	float color[3];
+};
+
+// Layout: SCENE_HEADER, assets[assetCount], models[modelCount], lights[lightCount], strings[stringBytes],
+// little endian, every section at the offset the header gives. Loading maps the file and reads the
+// sections in place.
+struct SCENE_HEADER {
+	char magic[4];
+	uint32_t version;
+	uint32_t assetCount;
+	uint32_t modelCount;
+	uint32_t lightCount;
+	uint32_t stringBytes;
+	uint64_t assetOffset;
+	uint64_t modelOffset;
+	uint64_t lightOffset;
+	uint64_t stringOffset;
+};
+
+// Sections of a scene, pointing into a mapped file or into SCENE_DATA
+struct SCENE_VIEW {
+	const SCENE_STRING* assets = nullptr;
+	size_t assetCount = 0;
+	const SCENE_MODEL* models = nullptr;
+	size_t modelCount = 0;
+	const SCENE_LIGHT* lights = nullptr;
+	size_t lightCount = 0;
+	const char* strings = nullptr;
+	size_t stringBytes = 0;
+
+	std::string_view getString(const SCENE_STRING& string) const {
+		return { strings + string.offset, string.length };
+	}
+	bool isValid() const {
+		auto inside = [&](const SCENE_STRING& string) {
+			return string.offset <= stringBytes && string.length <= stringBytes - string.offset;
+		};
+		for (size_t i = 0; i < assetCount; ++i) {
+			if (!inside(assets[i])) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < modelCount; ++i) {
+			const SCENE_MODEL& model = models[i];
+			bool assetValid = model.type == SCENE_MODEL_TYPE::FBX ? model.asset < assetCount : model.asset == UINT32_MAX;
+			bool parentValid = model.parent == UINT32_MAX || (model.parent < modelCount && model.parent != i);
+			if (!inside(model.name) || !assetValid || !parentValid
+				|| model.type > SCENE_MODEL_TYPE::FBX || model.colliderType > static_cast<uint32_t>(COLLIDER_TYPE::SPHERE)) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+struct SCENE_DATA {
+	std::vector<SCENE_STRING> assets;
+	std::vector<SCENE_MODEL> models;
+	std::vector<SCENE_LIGHT> lights;
+	std::string strings;
+
+	SCENE_STRING ADD_STRING(std::string_view string) {
+		SCENE_STRING result = { static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(string.size()) };
+		strings.append(string);
+		return result;
+	}
+	SCENE_VIEW getView() const {
+		return { assets.data(), assets.size(), models.data(), models.size(), lights.data(), lights.size(), strings.data(), strings.size() };
+	}
+};
+
+// Whole editor scene: models with their mesh assets, transforms, colliders and bodies, plus the lights.
+// SAVE/LOAD use the binary file; EXPORT_TEXT/IMPORT_TEXT write the same records one per line for diffs.
+struct SCENE_FILE {
+	static constexpr char MAGIC[4] = { 'U', 'S', 'C', 'N' };
+	static constexpr uint32_t VERSION = 2;
+	static constexpr uint32_t NO_ASSET = UINT32_MAX;
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	static SCENE_DATA CAPTURE(const ENTITY_STORE& entities, const std::vector<LIGHT>& lights) {
+		SCENE_DATA data;
+		const std::vector<MODEL*>& models = entities.getModels();
+		std::unordered_map<std::string, uint32_t> assetIndices;
+		const BODY_STORE& bodies = getBodyStore();
+		// Transforms models can hang from: each model's own and those of its nodes
+		std::unordered_map<const TRANSFORM*, std::pair<uint32_t, uint32_t>> owners;
+		for (const auto& model : models) {
+			if (model->getParent()) {
+				for (uint32_t i = 0; i < models.size(); ++i) {
+					owners.emplace(&models[i]->getTransform(), std::make_pair(i, NO_PARENT));
+					for (uint32_t node = 0; TRANSFORM* transform = models[i]->getNodeTransform(node); ++node) {
+						owners.emplace(transform, std::make_pair(i, node));
+					}
+				}
+				break;
+			}
+		}
+		data.models.reserve(models.size());
+		for (size_t i = 0; i < models.size(); ++i) {
+			const MODEL* model = models[i];
+			ENTITY_HANDLE entity = entities.getEntity(i);
+			SCENE_MODEL record = {};
+			record.type = SCENE_MODEL_TYPE::CUBE;
+			record.asset = NO_ASSET;
+			if (const FBX* fbx = dynamic_cast<const FBX*>(model)) {
+				record.type = SCENE_MODEL_TYPE::FBX;
+				auto [it, added] = assetIndices.emplace(fbx->getSource(), static_cast<uint32_t>(data.assets.size()));
+				if (added) {
+					data.assets.push_back(data.ADD_STRING(fbx->getSource()));
+				}
+				record.asset = it->second;
+			}
+			record.name = data.ADD_STRING(model->getName());
+			record.parent = NO_PARENT;
+			record.parentNode = NO_PARENT;
+			auto owner = owners.find(model->getParent());
+			if (owner != owners.end()) {
+				record.parent = owner->second.first;
+				record.parentNode = owner->second.second;
+			}
+			store(record.position, model->getProperty_Position());
+			store(record.rotation, model->getProperty_RotationAxis());
+			store(record.scale, model->getProperty_Scale());
+			store(record.color, model->getColor());
+			record.colliderType = static_cast<uint32_t>(entities.getColliderType(entity));
+			if (const COLLIDER* collider = entities.getCollider(entity)) {
+				store(record.colliderOffset, collider->getRelativePosition());
+				store(record.colliderScale, collider->getScale());
+			}
+			BODY_HANDLE body = entities.getBody(entity);
+			if (!body.isNull()) {
+				record.flags |= SCENE_MODEL_BODY;
+				record.mass = bodies.getMass(body);
+				store(record.velocity, bodies.getVelocity(body));
+			}
+			if (entities.getComponents(entity) & COMPONENT_GIZMO) {
+				record.flags |= SCENE_MODEL_AXIS;
+			}
+			data.models.push_back(record);
+		}
+		for (const LIGHT& light : lights) {
+			SCENE_LIGHT record;
+			store(record.position, light.getPosition());
+			store(record.color, light.getColor());
+			data.lights.push_back(record);
+		}
+		return data;
+	}
+
+	// Replaces the entities and lights with the scene, entity i for model record i. FBX assets load through
+	// the mesh library, so each file is read once.
+	static void APPLY(const SCENE_VIEW& view, ENTITY_STORE& entities, std::vector<LIGHT>& lights) {
+		entities.CLEAR();
+		BODY_STORE& bodies = getBodyStore();
+		for (size_t i = 0; i < view.modelCount; ++i) {
+			const SCENE_MODEL& record = view.models[i];
+			std::unique_ptr<MODEL> model;
+			if (record.type == SCENE_MODEL_TYPE::FBX) {
+				model = std::make_unique<FBX>();
+				model->Init(std::string(view.getString(view.assets[record.asset])));
+			}
+			else {
+				model = std::make_unique<CUBE>();
+				model->Init("");
+			}
+			model->setName(std::string(view.getString(record.name)));
+			model->setProperty_Position(load(record.position));
+			model->setProperty_RotationAxis(load(record.rotation));
+			model->setProperty_Scale(load(record.scale));
+			model->setColor(load(record.color));
+			ENTITY_HANDLE entity = entities.CREATE(std::move(model));
+			entities.setCollider(entity, static_cast<COLLIDER_TYPE>(record.colliderType));
+			if (COLLIDER* collider = entities.getCollider(entity)) {
+				collider->setRelativePosition(load(record.colliderOffset));
+				collider->setScale(load(record.colliderScale));
+			}
+			if (record.flags & SCENE_MODEL_BODY) {
+				BODY_HANDLE body = entities.setBody(entity);
+				bodies.setMass(body, record.mass);
+				bodies.setVelocity(body, load(record.velocity));
+			}
+			if (record.flags & SCENE_MODEL_AXIS) {
+				entities.setGizmo(entity);
+			}
+		}
+		// Parents may come later in the list; a cycle in the file leaves the models that would close it as roots
+		const std::vector<MODEL*>& models = entities.getModels();
+		for (size_t i = 0; i < view.modelCount; ++i) {
+			const SCENE_MODEL& record = view.models[i];
+			if (record.parent != NO_PARENT) {
+				MODEL& parent = *models[record.parent];
+				TRANSFORM* node = record.parentNode != NO_PARENT ? parent.getNodeTransform(record.parentNode) : nullptr;
+				models[i]->setParent(node ? node : &parent.getTransform());
+			}
+		}
+		lights.clear();
+		for (size_t i = 0; i < view.lightCount; ++i) {
+			LIGHT light;
+			light.setPosition(load(view.lights[i].position));
+			light.setColor(load(view.lights[i].color));
+			lights.push_back(light);
+		}
+		if (lights.empty()) {
+			lights.push_back(LIGHT()); // the renderer lights with lights.at(0)
+		}
+	}
+
+	bool SAVE(const std::string& path, const ENTITY_STORE& entities, const std::vector<LIGHT>& lights) const {
+		SCENE_DATA data = CAPTURE(entities, lights);
+		SCENE_HEADER header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.assetCount = static_cast<uint32_t>(data.assets.size());
+		header.modelCount = static_cast<uint32_t>(data.models.size());
+		header.lightCount = static_cast<uint32_t>(data.lights.size());
+		header.stringBytes = static_cast<uint32_t>(data.strings.size());
+		header.assetOffset = sizeof(SCENE_HEADER);
+		header.modelOffset = header.assetOffset + data.assets.size() * sizeof(SCENE_STRING);
+		header.lightOffset = header.modelOffset + data.models.size() * sizeof(SCENE_MODEL);
+		header.stringOffset = header.lightOffset + data.lights.size() * sizeof(SCENE_LIGHT);
+
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cerr << "Failed to write scene " << path << std::endl;
+			return false;
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		writeArray(out, data.assets);
+		writeArray(out, data.models);
+		writeArray(out, data.lights);
+		out.write(data.strings.data(), data.strings.size());
+		return static_cast<bool>(out);
+	}
+
+	bool LOAD(const std::string& path, ENTITY_STORE& entities, std::vector<LIGHT>& lights) const {
+		MAPPED_FILE file;
+		if (!file.OPEN(path) || file.size < sizeof(SCENE_HEADER)) {
+			std::cerr << "Failed to read scene " << path << std::endl;
+			return false;
+		}
+		SCENE_HEADER header;
+		std::memcpy(&header, file.data, sizeof(header));
+		if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION) {
+			std::cerr << "Not a version " << VERSION << " scene: " << path << std::endl;
+			return false;
+		}
+		auto fits = [&](uint64_t offset, uint64_t bytes) {
+			return offset <= file.size && bytes <= file.size - offset;
+		};
+		if (!fits(header.assetOffset, uint64_t(header.assetCount) * sizeof(SCENE_STRING)) || !fits(header.modelOffset, uint64_t(header.modelCount) * sizeof(SCENE_MODEL))
+			|| !fits(header.lightOffset, uint64_t(header.lightCount) * sizeof(SCENE_LIGHT)) || !fits(header.stringOffset, header.stringBytes)
+			|| header.assetOffset % 4 != 0 || header.modelOffset % 4 != 0 || header.lightOffset % 4 != 0) {
+			std::cerr << "Truncated scene " << path << std::endl;
+			return false;
+		}
+		SCENE_VIEW view;
+		view.assets = reinterpret_cast<const SCENE_STRING*>(file.data + header.assetOffset);
+		view.assetCount = header.assetCount;
+		view.models = reinterpret_cast<const SCENE_MODEL*>(file.data + header.modelOffset);
+		view.modelCount = header.modelCount;
+		view.lights = reinterpret_cast<const SCENE_LIGHT*>(file.data + header.lightOffset);
+		view.lightCount = header.lightCount;
+		view.strings = reinterpret_cast<const char*>(file.data + header.stringOffset);
+		view.stringBytes = header.stringBytes;
+		if (!view.isValid()) {
+			std::cerr << "Corrupt scene " << path << std::endl;
+			return false;
+		}
+		APPLY(view, entities, lights);
+		return true;
+	}
+
+	// "uscn <version>", then one "asset", "light" or "model" line per record. Floats are written shortest
+	// round-trip, so an export, import and export again gives the same text.
+	bool EXPORT_TEXT(const std::string& path, const ENTITY_STORE& entities, const std::vector<LIGHT>& lights) const {
+		SCENE_DATA data = CAPTURE(entities, lights);
+		SCENE_VIEW view = data.getView();
+		std::string text = "uscn " + std::to_string(VERSION) + "\n";
+		text.reserve(text.size() + data.models.size() * 160);
+		for (const SCENE_STRING& asset : data.assets) {
+			text += "asset ";
+			text += view.getString(asset);
+			text += '\n';
+		}
+		for (const SCENE_LIGHT& light : data.lights) {
+			text += "light";
+			appendFloats(text, light.position, 3);
+			appendFloats(text, light.color, 3);
+			text += '\n';
+		}
+		for (const SCENE_MODEL& model : data.models) {
+			text += "model ";
+			text += std::to_string(static_cast<uint32_t>(model.type));
+			text += ' ';
+			appendIndex(text, model.asset);
+			text += ' ';
+			text += std::to_string(model.colliderType);
+			text += ' ';
+			text += std::to_string(model.flags);
+			text += ' ';
+			appendIndex(text, model.parent);
+			text += ' ';
+			appendIndex(text, model.parentNode);
+			appendFloats(text, model.position, 3);
+			appendFloats(text, model.rotation, 3);
+			appendFloats(text, model.scale, 3);
+			appendFloats(text, model.color, 3);
+			appendFloats(text, model.colliderOffset, 3);
+			appendFloats(text, model.colliderScale, 3);
+			appendFloats(text, &model.mass, 1);
+			appendFloats(text, model.velocity, 3);
+			text += ' ';
+			text += view.getString(model.name); // rest of the line, may contain spaces
+			text += '\n';
+		}
+		std::ofstream out(path, std::ios::binary | std::ios::trunc);
+		out.write(text.data(), text.size());
+		return static_cast<bool>(out);
+	}
+
+	bool IMPORT_TEXT(const std::string& path, ENTITY_STORE& entities, std::vector<LIGHT>& lights) const {
+		MAPPED_FILE file;
+		if (!file.OPEN(path)) {
+			std::cerr << "Failed to read scene " << path << std::endl;
+			return false;
+		}
+		SCENE_DATA data;
+		TEXT_READER reader{ reinterpret_cast<const char*>(file.data), reinterpret_cast<const char*>(file.data) + file.size };
+		uint32_t version = 0;
+		if (reader.WORD() != "uscn" || !reader.UINT(version) || version != VERSION) {
+			std::cerr << "Not a version " << VERSION << " text scene: " << path << std::endl;
+			return false;
+		}
+		reader.NEXT_LINE();
+		size_t line = 2;
+		for (; !reader.isDone(); reader.NEXT_LINE(), ++line) {
+			std::string_view kind = reader.WORD();
+			bool ok = true;
+			if (kind == "asset") {
+				data.assets.push_back(data.ADD_STRING(reader.REST()));
+			}
+			else if (kind == "light") {
+				SCENE_LIGHT light;
+				ok = reader.FLOATS(light.position, 3) && reader.FLOATS(light.color, 3);
+				data.lights.push_back(light);
+			}
+			else if (kind == "model") {
+				SCENE_MODEL model = {};
+				uint32_t type = 0;
+				ok = reader.UINT(type) && reader.INDEX(model.asset);
+				model.type = static_cast<SCENE_MODEL_TYPE>(type);
+				ok = ok && reader.UINT(model.colliderType) && reader.UINT(model.flags) && reader.INDEX(model.parent) && reader.INDEX(model.parentNode)
+					&& reader.FLOATS(model.position, 3) && reader.FLOATS(model.rotation, 3) && reader.FLOATS(model.scale, 3)
+					&& reader.FLOATS(model.color, 3) && reader.FLOATS(model.colliderOffset, 3) && reader.FLOATS(model.colliderScale, 3)
+					&& reader.FLOATS(&model.mass, 1) && reader.FLOATS(model.velocity, 3);
+				model.name = data.ADD_STRING(reader.REST());
+				data.models.push_back(model);
+			}
+			else if (!kind.empty()) {
+				ok = false;
+			}
+			if (!ok) {
+				std::cerr << path << ":" << line << ": malformed " << std::string(kind) << " line" << std::endl;
+				return false;
+			}
+		}
+		SCENE_VIEW view = data.getView();
+		if (!view.isValid()) {
+			std::cerr << "Corrupt scene " << path << std::endl;
+			return false;
+		}
+		APPLY(view, entities, lights);
+		return true;
+	}
+
+private:
+	// Cursor over the text file; numbers go through std::from_chars, which neither allocates nor looks at the locale
+	struct TEXT_READER {
+		const char* current;
+		const char* end;
+		const char* wordStart = nullptr;
+
+		bool isDone() const {
+			return current >= end;
+		}
+		void skipSpaces() {
+			while (current < end && (*current == ' ' || *current == '\t' || *current == '\r')) {
+				++current;
+			}
+		}
+		std::string_view WORD() {
+			skipSpaces();
+			wordStart = current;
+			while (current < end && *current != ' ' && *current != '\t' && *current != '\r' && *current != '\n') {
+				++current;
+			}
+			return { wordStart, static_cast<size_t>(current - wordStart) };
+		}
+		// Un-reads the last WORD
+		void BACK() {
+			current = wordStart;
+		}
+		bool UINT(uint32_t& value) {
+			skipSpaces();
+			auto [next, error] = std::from_chars(current, end, value);
+			current = next;
+			return error == std::errc();
+		}
+		// A UINT, or "-" for none (UINT32_MAX)
+		bool INDEX(uint32_t& value) {
+			if (WORD() == "-") {
+				value = UINT32_MAX;
+				return true;
+			}
+			BACK();
+			return UINT(value);
+		}
+		bool FLOATS(float* values, int count) {
+			for (int i = 0; i < count; ++i) {
+				skipSpaces();
+				auto [next, error] = std::from_chars(current, end, values[i]);
+				if (error != std::errc()) {
+					return false;
+				}
+				current = next;
+			}
+			return true;
+		}
+		// The rest of the line after one separating space, without the line break
+		std::string_view REST() {
+			if (current < end && *current == ' ') {
+				++current;
+			}
+			const char* start = current;
+			while (current < end && *current != '\n') {
+				++current;
+			}
+			const char* last = current;
+			if (last > start && last[-1] == '\r') {
+				--last;
+			}
+			return { start, static_cast<size_t>(last - start) };
+		}
+		void NEXT_LINE() {
+			while (current < end && *current != '\n') {
+				++current;
+			}
+			if (current < end) {
+				++current;
+			}
+		}
+	};
+
+	static void store(float* out, const glm::vec3& value) {
+		out[0] = value.x; out[1] = value.y; out[2] = value.z;
+	}
+	static glm::vec3 load(const float* values) {
+		return { values[0], values[1], values[2] };
+	}
+	static void appendIndex(std::string& text, uint32_t value) {
+		text += value == UINT32_MAX ? std::string("-") : std::to_string(value);
+	}
+	static void appendFloats(std::string& text, const float* values, int count) {
+		char buffer[32];
+		for (int i = 0; i < count; ++i) {
+			auto [next, error] = std::to_chars(buffer, buffer + sizeof(buffer), values[i]);
+			text += ' ';
+			text.append(buffer, next);
+		}
+	}
+	template<typename T>
+	static void writeArray(std::ofstream& out, const std::vector<T>& values) {
+		out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+};
+
+#endif
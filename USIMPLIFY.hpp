@@ -0,0 +1,345 @@
+#ifndef __USIMPLIFY_HPP__
+#define __USIMPLIFY_HPP__
+#include "UPHYSIC.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+// Garland-Heckbert error quadric: the symmetric 4x4 matrix stored as its upper triangle
+// (xx xy xz xw yy yz yw zz zw ww), in double so large coordinates keep their precision.
+// weight is the total area that went in, so evaluate() / weight is a mean squared distance.
+struct QUADRIC {
+	double a[10] = {};
+	double weight = 0.0;
+
+	static QUADRIC PLANE(const glm::vec3& normal, float d, double weight) {
+		double x = normal.x, y = normal.y, z = normal.z, w = d;
+		QUADRIC q;
+		double values[10] = { x * x, x * y, x * z, x * w, y * y, y * z, y * w, z * z, z * w, w * w };
+		for (int i = 0; i < 10; ++i) {
+			q.a[i] = values[i] * weight;
+		}
+		q.weight = weight;
+		return q;
+	}
+	void ADD(const QUADRIC& other) {
+		for (int i = 0; i < 10; ++i) {
+			a[i] += other.a[i];
+		}
+		weight += other.weight;
+	}
+	double evaluate(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+			+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+			+ a[7] * z * z + 2.0 * a[8] * z + a[9];
+	}
+	// Root mean squared distance of p to the planes, in mesh units
+	float getError(const glm::vec3& p) const {
+		return weight > 0.0 ? static_cast<float>(std::sqrt(std::max(evaluate(p), 0.0) / weight)) : 0.0f;
+	}
+};
+
+// Quadric edge collapse over an indexed triangle list. Vertices only ever move onto other existing vertices
+// (half edge collapses), so every simplified index list still indexes the original vertex buffer and a whole
+// LOD chain shares one VBO. Collapses work on positions: corners the builder split for normals or uvs move
+// together, each onto the sibling at the target whose normal matches best.
+struct MESH_SIMPLIFIER {
+	float maxError = FLT_MAX; // largest collapse error allowed, in mesh units
+	float borderWeight = 10.0f; // how strongly open borders resist moving inwards
+	float error = 0.0f;       // largest collapse error of the last SIMPLIFY
+	size_t collapses = 0;     // collapses done by the last SIMPLIFY
+
+	// positions and normals as xyz floats; returns at most targetIndexCount indices unless maxError stops it first
+	std::vector<uint32_t> SIMPLIFY(const std::vector<float>& positions, const std::vector<float>& normals,
+		const std::vector<uint32_t>& indices, size_t targetIndexCount) {
+		error = 0.0f;
+		collapses = 0;
+		size_t vertexCount = positions.size() / 3;
+		size_t triangleCount = indices.size() / 3;
+		buildClasses(positions, vertexCount);
+		size_t classCount = classPositions.size();
+
+		std::vector<uint32_t> corners(indices.begin(), indices.begin() + triangleCount * 3);
+		std::vector<uint8_t> alive(triangleCount, 1);
+		std::vector<std::vector<uint32_t>> classTriangles(classCount);
+		std::vector<QUADRIC> quadrics(classCount);
+		std::unordered_map<uint64_t, uint32_t> edgeUses;
+		size_t aliveCount = 0;
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			uint32_t c[3] = { classOf[corners[t * 3]], classOf[corners[t * 3 + 1]], classOf[corners[t * 3 + 2]] };
+			if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2]) {
+				alive[t] = 0;
+				continue;
+			}
+			++aliveCount;
+			glm::vec3 normal = glm::cross(classPositions[c[1]] - classPositions[c[0]], classPositions[c[2]] - classPositions[c[0]]);
+			float length = glm::length(normal);
+			QUADRIC plane = length > 0.0f
+				? QUADRIC::PLANE(normal / length, -glm::dot(normal / length, classPositions[c[0]]), length * 0.5)
+				: QUADRIC();
+			for (int k = 0; k < 3; ++k) {
+				classTriangles[c[k]].push_back(t);
+				quadrics[c[k]].ADD(plane);
+				++edgeUses[getEdgeKey(c[k], c[(k + 1) % 3])];
+			}
+		}
+		// Edges of a single triangle are borders: a plane through the edge, perpendicular to the face, keeps them in place
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			if (!alive[t]) {
+				continue;
+			}
+			uint32_t c[3] = { classOf[corners[t * 3]], classOf[corners[t * 3 + 1]], classOf[corners[t * 3 + 2]] };
+			glm::vec3 faceNormal = glm::cross(classPositions[c[1]] - classPositions[c[0]], classPositions[c[2]] - classPositions[c[0]]);
+			for (int k = 0; k < 3; ++k) {
+				uint32_t a = c[k], b = c[(k + 1) % 3];
+				if (edgeUses[getEdgeKey(a, b)] != 1) {
+					continue;
+				}
+				glm::vec3 edge = classPositions[b] - classPositions[a];
+				glm::vec3 normal = glm::cross(edge, faceNormal);
+				float length = glm::length(normal);
+				if (length <= 0.0f) {
+					continue;
+				}
+				normal /= length;
+				QUADRIC plane = QUADRIC::PLANE(normal, -glm::dot(normal, classPositions[a]), glm::dot(edge, edge) * borderWeight);
+				quadrics[a].ADD(plane);
+				quadrics[b].ADD(plane);
+			}
+		}
+
+		remap.resize(classCount);
+		for (uint32_t c = 0; c < classCount; ++c) {
+			remap[c] = c;
+		}
+		std::vector<uint32_t> versions(classCount, 0);
+		std::priority_queue<COLLAPSE, std::vector<COLLAPSE>, std::greater<COLLAPSE>> queue;
+		auto pushEdge = [&](uint32_t a, uint32_t b) {
+			QUADRIC q = quadrics[a];
+			q.ADD(quadrics[b]);
+			queue.push({ q.getError(classPositions[b]), a, b, versions[a], versions[b] });
+			queue.push({ q.getError(classPositions[a]), b, a, versions[b], versions[a] });
+		};
+		for (auto& [key, uses] : edgeUses) {
+			pushEdge(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key));
+		}
+
+		size_t targetTriangles = targetIndexCount / 3;
+		std::vector<uint32_t> neighbors;
+		while (aliveCount > targetTriangles && !queue.empty()) {
+			COLLAPSE collapse = queue.top();
+			queue.pop();
+			uint32_t from = collapse.from;
+			uint32_t to = collapse.to;
+			// Either end collapsed or changed since: a fresh entry was pushed then
+			if (remap[from] != from || remap[to] != to || versions[from] != collapse.fromVersion || versions[to] != collapse.toVersion) {
+				continue;
+			}
+			if (collapse.error > maxError) {
+				break;
+			}
+			if (flips(from, to, corners, alive, classTriangles[from])) {
+				continue;
+			}
+
+			remap[from] = to;
+			for (uint32_t t : classTriangles[from]) {
+				if (!alive[t]) {
+					continue;
+				}
+				if (hasClass(t, to, corners)) {
+					alive[t] = 0;
+					--aliveCount;
+				}
+				else {
+					classTriangles[to].push_back(t);
+				}
+			}
+			std::vector<uint32_t>().swap(classTriangles[from]);
+			std::vector<uint32_t>& around = classTriangles[to];
+			around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !alive[t]; }), around.end());
+			quadrics[to].ADD(quadrics[from]);
+			++versions[to];
+			error = std::max(error, collapse.error);
+			++collapses;
+
+			// Only edges at to changed cost; the version bump dropped their old entries
+			neighbors.clear();
+			for (uint32_t t : around) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t c = resolve(classOf[corners[t * 3 + k]]);
+					if (c != to) {
+						neighbors.push_back(c);
+					}
+				}
+			}
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+			for (uint32_t n : neighbors) {
+				pushEdge(to, n);
+			}
+		}
+
+		// Corners of a moved class take the sibling at the target with the closest normal
+		std::vector<uint32_t> moved(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> result;
+		result.reserve(aliveCount * 3);
+		for (uint32_t t = 0; t < triangleCount; ++t) {
+			if (!alive[t]) {
+				continue;
+			}
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = corners[t * 3 + k];
+				uint32_t c = resolve(classOf[v]);
+				if (c == classOf[v]) {
+					result.push_back(v);
+					continue;
+				}
+				if (moved[v] == UINT32_MAX) {
+					moved[v] = closestSibling(v, c, normals);
+				}
+				result.push_back(moved[v]);
+			}
+		}
+		return result;
+	}
+
+private:
+	struct COLLAPSE {
+		float error;
+		uint32_t from;
+		uint32_t to;
+		uint32_t fromVersion;
+		uint32_t toVersion;
+
+		bool operator>(const COLLAPSE& other) const {
+			return error > other.error;
+		}
+	};
+	struct POSITION_KEY {
+		uint32_t bits[3];
+		bool operator==(const POSITION_KEY& other) const {
+			return std::memcmp(bits, other.bits, sizeof(bits)) == 0;
+		}
+	};
+	struct POSITION_KEY_HASH {
+		size_t operator()(const POSITION_KEY& key) const {
+			size_t hash = 0;
+			for (uint32_t bits : key.bits) {
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	std::vector<uint32_t> classOf;             // vertex -> position class
+	std::vector<glm::vec3> classPositions;
+	std::vector<uint32_t> classVertexStart;    // class c owns classVertices[start[c], start[c + 1])
+	std::vector<uint32_t> classVertices;
+	std::vector<uint32_t> remap;               // class -> class it collapsed into, itself while alive
+
+	void buildClasses(const std::vector<float>& positions, size_t vertexCount) {
+		std::unordered_map<POSITION_KEY, uint32_t, POSITION_KEY_HASH> lookup;
+		lookup.reserve(vertexCount);
+		classOf.assign(vertexCount, 0);
+		classPositions.clear();
+		for (size_t v = 0; v < vertexCount; ++v) {
+			POSITION_KEY key;
+			std::memcpy(key.bits, &positions[v * 3], sizeof(key.bits));
+			auto [it, inserted] = lookup.try_emplace(key, static_cast<uint32_t>(classPositions.size()));
+			if (inserted) {
+				classPositions.emplace_back(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+			}
+			classOf[v] = it->second;
+		}
+		classVertexStart.assign(classPositions.size() + 1, 0);
+		for (uint32_t c : classOf) {
+			++classVertexStart[c + 1];
+		}
+		for (size_t c = 0; c < classPositions.size(); ++c) {
+			classVertexStart[c + 1] += classVertexStart[c];
+		}
+		classVertices.resize(vertexCount);
+		std::vector<uint32_t> fill(classVertexStart.begin(), classVertexStart.end() - 1);
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			classVertices[fill[classOf[v]]++] = v;
+		}
+	}
+
+	uint32_t resolve(uint32_t c) {
+		uint32_t root = c;
+		while (remap[root] != root) {
+			root = remap[root];
+		}
+		while (remap[c] != root) {
+			uint32_t next = remap[c];
+			remap[c] = root;
+			c = next;
+		}
+		return root;
+	}
+
+	static uint64_t getEdgeKey(uint32_t a, uint32_t b) {
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	bool hasClass(uint32_t t, uint32_t c, const std::vector<uint32_t>& corners) {
+		for (int k = 0; k < 3; ++k) {
+			if (resolve(classOf[corners[t * 3 + k]]) == c) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Moving from onto to must not turn any surviving triangle around from over, or squash it flat
+	bool flips(uint32_t from, uint32_t to, const std::vector<uint32_t>& corners, const std::vector<uint8_t>& alive,
+		const std::vector<uint32_t>& triangles) {
+		for (uint32_t t : triangles) {
+			if (!alive[t] || hasClass(t, to, corners)) {
+				continue;
+			}
+			glm::vec3 before[3];
+			glm::vec3 after[3];
+			for (int k = 0; k < 3; ++k) {
+				uint32_t c = resolve(classOf[corners[t * 3 + k]]);
+				before[k] = classPositions[c];
+				after[k] = c == from ? classPositions[to] : before[k];
+			}
+			glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+			glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+			float oldLength = glm::length(oldNormal);
+			float newLength = glm::length(newNormal);
+			if (newLength <= 1e-6f * oldLength || glm::dot(oldNormal, newNormal) < 0.2f * oldLength * newLength) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t closestSibling(uint32_t v, uint32_t c, const std::vector<float>& normals) const {
+		uint32_t best = classVertices[classVertexStart[c]];
+		if (normals.size() < classOf.size() * 3) {
+			return best;
+		}
+		glm::vec3 normal(normals[v * 3], normals[v * 3 + 1], normals[v * 3 + 2]);
+		float bestDot = -FLT_MAX;
+		for (uint32_t i = classVertexStart[c]; i < classVertexStart[c + 1]; ++i) {
+			uint32_t sibling = classVertices[i];
+			float d = glm::dot(normal, glm::vec3(normals[sibling * 3], normals[sibling * 3 + 1], normals[sibling * 3 + 2]));
+			if (d > bestDot) {
+				bestDot = d;
+				best = sibling;
+			}
+		}
+		return best;
+	}
+};
+
+#endif
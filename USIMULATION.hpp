@@ -0,0 +1,160 @@
+#ifndef __USIMULATION_HPP__
+#define __USIMULATION_HPP__
+#include "UBODY.hpp"
+#include "UPROFILE.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+inline double getWallTime() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Body positions after one fixed step, indexed by BODY_HANDLE::index
+struct TRANSFORM_SNAPSHOT {
+	double wallTime = 0.0;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> generations;
+
+	bool find(BODY_HANDLE body, glm::vec3& position) const {
+		if (body.index >= generations.size() || generations[body.index] != body.generation) {
+			return false;
+		}
+		position = positions[body.index];
+		return true;
+	}
+};
+
+// The reader always wants the last two snapshots. They are published as shared snapshots, swapped under
+// a short lock, and a reader keeps its two alive for as long as it uses them. The writer fills a snapshot
+// no reader can see: a retired one once every reader has let go of it, or a new one.
+struct SNAPSHOT_BUFFER {
+	TRANSFORM_SNAPSHOT& BEGIN_WRITE() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!writing) {
+			for (std::shared_ptr<TRANSFORM_SNAPSHOT>& snapshot : retired) {
+				// Readers drop their references with a release decrement; the fence orders their last reads
+				// of the snapshot before the writes that reuse it
+				if (snapshot.use_count() == 1) {
+					std::atomic_thread_fence(std::memory_order_acquire);
+					writing = std::move(snapshot);
+					std::swap(snapshot, retired.back());
+					retired.pop_back();
+					break;
+				}
+			}
+			if (!writing) {
+				writing = std::make_shared<TRANSFORM_SNAPSHOT>();
+			}
+		}
+		return *writing;
+	}
+	void PUBLISH() {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (previous && retired.size() < MAX_RETIRED) {
+			retired.push_back(std::move(previous));
+		}
+		previous = std::move(current);
+		current = std::move(writing);
+	}
+
+	bool READ(std::shared_ptr<const TRANSFORM_SNAPSHOT>& previousSnapshot, std::shared_ptr<const TRANSFORM_SNAPSHOT>& currentSnapshot) const {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!previous) {
+			return false;
+		}
+		previousSnapshot = previous;
+		currentSnapshot = current;
+		return true;
+	}
+
+private:
+	static constexpr size_t MAX_RETIRED = 4;
+	mutable std::mutex mutex;
+	std::shared_ptr<TRANSFORM_SNAPSHOT> writing;
+	std::shared_ptr<TRANSFORM_SNAPSHOT> previous;
+	std::shared_ptr<TRANSFORM_SNAPSHOT> current;
+	std::vector<std::shared_ptr<TRANSFORM_SNAPSHOT>> retired;
+};
+
+// Steps the simulation at a fixed rate on its own thread. simulationMutex is held for every
+// step; the main thread takes it only while it reads or edits simulation state (GUI, picking).
+struct PHYSICS_THREAD {
+	std::atomic<float> fixedStep{ 1.0f / 60.0f };
+	int maxStepsPerUpdate = 8; // past this the simulation slows down instead of spiralling
+	std::mutex simulationMutex;
+	SNAPSHOT_BUFFER snapshots;
+	std::atomic<uint64_t> stepCount{ 0 };
+
+	PHYSICS_THREAD() = default;
+	PHYSICS_THREAD(const PHYSICS_THREAD&) = delete;
+	PHYSICS_THREAD& operator=(const PHYSICS_THREAD&) = delete;
+	~PHYSICS_THREAD() {
+		STOP();
+	}
+
+	// step advances the simulation by dt, capture fills a snapshot; both run under simulationMutex
+	void START(std::function<void(float)> step, std::function<void(TRANSFORM_SNAPSHOT&)> capture) {
+		STOP();
+		this->step = std::move(step);
+		this->capture = std::move(capture);
+		running = true;
+		thread = std::thread([this]() { loop(); });
+	}
+
+	void STOP() {
+		running = false;
+		if (thread.joinable()) {
+			thread.join();
+		}
+	}
+
+	// How far the render time is between the previous and current snapshot
+	float getAlpha(const TRANSFORM_SNAPSHOT& current) const {
+		float alpha = static_cast<float>((getWallTime() - current.wallTime) / fixedStep.load());
+		return std::min(std::max(alpha, 0.0f), 1.0f);
+	}
+
+private:
+	std::function<void(float)> step;
+	std::function<void(TRANSFORM_SNAPSHOT&)> capture;
+	std::atomic<bool> running{ false };
+	std::thread thread;
+
+	void loop() {
+		UPROFILE_THREAD("Physics");
+		double previous = getWallTime();
+		double accumulator = 0.0;
+		while (running) {
+			double now = getWallTime();
+			accumulator += now - previous;
+			previous = now;
+
+			float dt = fixedStep.load();
+			int steps = 0;
+			while (accumulator >= dt && steps < maxStepsPerUpdate) {
+				{
+					UPROFILE_SCOPE("PHYSICS_THREAD::STEP");
+					std::lock_guard<std::mutex> lock(simulationMutex);
+					step(dt);
+					TRANSFORM_SNAPSHOT& snapshot = snapshots.BEGIN_WRITE();
+					capture(snapshot);
+					snapshot.wallTime = getWallTime();
+				}
+				snapshots.PUBLISH();
+				accumulator -= dt;
+				++steps;
+				++stepCount;
+			}
+			if (steps == maxStepsPerUpdate) {
+				accumulator = 0.0;
+			}
+			std::this_thread::sleep_for(std::chrono::duration<double>(std::max(dt - accumulator, 0.0) * 0.5));
+		}
+	}
+};
+
+#endif
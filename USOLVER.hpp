@@ -0,0 +1,334 @@
+#ifndef __USOLVER_HPP__
+#define __USOLVER_HPP__
+#include "UBODY.hpp"
+#include <cfloat>
+#include <chrono>
+
+// Contact between two colliders, with A's key below B's. The normal points from A to B.
+// Bodies carry no rotation, so a face contact acts on the same linear freedom at every point
+// of the face: one point at the deepest penetration is the whole manifold.
+struct CONTACT {
+	uint64_t keyA = 0;
+	uint64_t keyB = 0;
+	BODY_HANDLE bodyA; // null for a collider without a body, which never moves
+	BODY_HANDLE bodyB;
+	glm::vec3 normal = glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::vec3 point = glm::vec3(0.0f);
+	float depth = 0.0f;
+
+	// Accumulated impulses, carried over from the last step by warm starting
+	float normalImpulse = 0.0f;
+	glm::vec3 tangentImpulse = glm::vec3(0.0f);
+
+	// Set up by SOLVE_VELOCITIES; a body that is static, asleep or absent has inverse mass 0
+	uint32_t denseA = 0;
+	uint32_t denseB = 0;
+	float invMassA = 0.0f;
+	float invMassB = 0.0f;
+	float mass = 0.0f; // 1 / (invMassA + invMassB)
+	float bounce = 0.0f; // target separating speed from restitution
+	glm::vec3 startA = glm::vec3(0.0f); // positions before INTEGRATE_POSITIONS, for the position pass
+	glm::vec3 startB = glm::vec3(0.0f);
+
+	bool operator<(const CONTACT& other) const {
+		return keyA < other.keyA || (keyA == other.keyA && keyB < other.keyB);
+	}
+};
+
+// Shapes as the editor builds them: a box has the collider scale as its size and is turned by the
+// orientation the caller passes (the editor's is the model rotation), a sphere's diameter is the largest
+// scale component. Both are centered on position + relative position.
+inline float getSphereRadius(const COLLIDER& sphere) {
+	glm::vec3 scale = sphere.getScale();
+	return 0.5f * std::max(scale.x, std::max(scale.y, scale.z));
+}
+
+// Fills normal, point and depth; false when the shapes do not overlap. The columns of axesA and axesB are
+// the box axes in world space, the same orientations the narrowphase tested.
+inline bool makeContact(const COLLIDER& a, const COLLIDER& b, CONTACT& contact,
+	const glm::mat3& axesA = glm::mat3(1.0f), const glm::mat3& axesB = glm::mat3(1.0f)) {
+	glm::vec3 centerA = a.position + a.getRelativePosition();
+	glm::vec3 centerB = b.position + b.getRelativePosition();
+	bool sphereA = a.type == COLLIDER_TYPE::SPHERE;
+	bool sphereB = b.type == COLLIDER_TYPE::SPHERE;
+
+	if (sphereA && sphereB) {
+		float radii = getSphereRadius(a) + getSphereRadius(b);
+		glm::vec3 delta = centerB - centerA;
+		float distance = glm::length(delta);
+		if (distance >= radii) {
+			return false;
+		}
+		contact.normal = distance > 1e-6f ? delta / distance : glm::vec3(0.0f, 1.0f, 0.0f);
+		contact.depth = radii - distance;
+		contact.point = centerA + contact.normal * (getSphereRadius(a) - 0.5f * contact.depth);
+		return true;
+	}
+
+	if (sphereA != sphereB) {
+		// In the box's frame, where it is axis aligned
+		const COLLIDER& sphere = sphereA ? a : b;
+		glm::vec3 center = sphereA ? centerA : centerB;
+		glm::vec3 boxCenter = sphereA ? centerB : centerA;
+		const glm::mat3& axes = sphereA ? axesB : axesA;
+		glm::vec3 extent = 0.5f * (sphereA ? b : a).getScale();
+		float radius = getSphereRadius(sphere);
+		glm::vec3 local = glm::transpose(axes) * (center - boxCenter);
+		glm::vec3 closest = glm::clamp(local, -extent, extent);
+		glm::vec3 outward; // from the box towards the sphere
+		float depth;
+		if (closest != local) {
+			glm::vec3 delta = local - closest;
+			float distance = glm::length(delta);
+			if (distance >= radius) {
+				return false;
+			}
+			outward = delta / distance;
+			depth = radius - distance;
+		}
+		else {
+			// Center inside the box: out through the nearest face
+			glm::vec3 gap = extent - glm::abs(local);
+			int axis = gap.x < gap.y ? (gap.x < gap.z ? 0 : 2) : (gap.y < gap.z ? 1 : 2);
+			outward = glm::vec3(0.0f);
+			outward[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+			depth = gap[axis] + radius;
+		}
+		outward = axes * outward;
+		contact.normal = sphereA ? -outward : outward;
+		contact.depth = depth;
+		contact.point = boxCenter + axes * closest;
+		return true;
+	}
+
+	// Separating axes: the face normals of both boxes, then the edge cross products. The normal is the
+	// axis of least overlap; an edge axis has to beat the faces clearly, or a face contact whose edges line
+	// up would flip between normals from step to step. Axis aligned boxes only ever see their face axes.
+	glm::vec3 extentA = 0.5f * a.getScale();
+	glm::vec3 extentB = 0.5f * b.getScale();
+	glm::vec3 delta = centerB - centerA;
+	float best = FLT_MAX; // overlap along bestAxis, edge overlaps weighted up
+	glm::vec3 bestAxis(0.0f, 1.0f, 0.0f);
+	auto overlaps = [&](const glm::vec3& axis, float weight) {
+		float ra = extentA.x * std::abs(glm::dot(axesA[0], axis)) + extentA.y * std::abs(glm::dot(axesA[1], axis)) + extentA.z * std::abs(glm::dot(axesA[2], axis));
+		float rb = extentB.x * std::abs(glm::dot(axesB[0], axis)) + extentB.y * std::abs(glm::dot(axesB[1], axis)) + extentB.z * std::abs(glm::dot(axesB[2], axis));
+		float distance = glm::dot(delta, axis);
+		float overlap = ra + rb - std::abs(distance);
+		if (overlap <= 0.0f) {
+			return false;
+		}
+		if (overlap * weight < best) {
+			best = overlap * weight;
+			bestAxis = distance < 0.0f ? -axis : axis;
+			contact.depth = overlap;
+		}
+		return true;
+	};
+	for (int i = 0; i < 3; ++i) {
+		if (!overlaps(axesA[i], 1.0f)) {
+			return false;
+		}
+	}
+	for (int j = 0; j < 3; ++j) {
+		if (!overlaps(axesB[j], 1.0f)) {
+			return false;
+		}
+	}
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			glm::vec3 axis = glm::cross(axesA[i], axesB[j]);
+			float length = glm::length(axis);
+			if (length > 1e-3f && !overlaps(axis / length, 1.05f)) {
+				return false;
+			}
+		}
+	}
+	contact.normal = bestAxis;
+	// Halfway into the penetration, from the middle of B's deepest feature along the normal
+	glm::vec3 deepest = centerB;
+	for (int j = 0; j < 3; ++j) {
+		float along = glm::dot(axesB[j], contact.normal);
+		if (std::abs(along) > 1e-4f) {
+			deepest += axesB[j] * (along < 0.0f ? extentB[j] : -extentB[j]);
+		}
+	}
+	contact.point = deepest + contact.normal * (0.5f * contact.depth);
+	return true;
+}
+
+// Sequential impulses over the step's contacts. Accumulated impulses are cached by collider pair and
+// applied up front on the next step (warm starting), so a resting stack starts each step near its
+// solution and holds with a few iterations. Penetration is resolved by moving positions after
+// integration rather than through a velocity bias, which would add energy nothing takes out.
+struct CONTACT_SOLVER {
+	int iterations = 8;
+	int positionIterations = 2;
+	bool warmStarting = true;
+	float friction = 0.5f;
+	float restitution = 0.2f;
+	float bounceSpeed = 1.0f; // approach speeds below this do not bounce, so resting contacts stay put
+	float correction = 0.2f; // fraction of the penetration removed per position iteration
+	float maxCorrection = 0.2f;
+	float slop = 0.005f; // penetration left alone, so contacts persist from step to step
+	glm::vec3 gravity = glm::vec3(0.0f);
+
+	std::vector<CONTACT> contacts;
+	size_t warmStarted = 0; // contacts found in the cache by the last solve
+	float maxPenetration = 0.0f; // deepest contact left after the last position pass
+	double time = 0.0; // ms in the last SOLVE_VELOCITIES and SOLVE_POSITIONS
+
+	// Each step before ADD
+	void BEGIN() {
+		contacts.clear();
+	}
+
+	// keyA and keyB identify the colliders across steps; a null body is static. axesA and axesB orient
+	// boxes as in makeContact.
+	bool ADD(const COLLIDER& a, const COLLIDER& b, uint64_t keyA, uint64_t keyB, BODY_HANDLE bodyA, BODY_HANDLE bodyB,
+		const glm::mat3& axesA = glm::mat3(1.0f), const glm::mat3& axesB = glm::mat3(1.0f)) {
+		CONTACT contact;
+		bool swapped = keyB < keyA;
+		if (!makeContact(swapped ? b : a, swapped ? a : b, contact, swapped ? axesB : axesA, swapped ? axesA : axesB)) {
+			return false;
+		}
+		contact.keyA = swapped ? keyB : keyA;
+		contact.keyB = swapped ? keyA : keyB;
+		contact.bodyA = swapped ? bodyB : bodyA;
+		contact.bodyB = swapped ? bodyA : bodyB;
+		contacts.push_back(contact);
+		return true;
+	}
+
+	// Between INTEGRATE_VELOCITIES and INTEGRATE_POSITIONS
+	void SOLVE_VELOCITIES(BODY_STORE& bodies) {
+		auto start = std::chrono::high_resolution_clock::now();
+		// Sorted by key, the solve order does not depend on the broadphase, and the cache merges in one pass
+		std::sort(contacts.begin(), contacts.end());
+		warmStarted = 0;
+		size_t cached = 0;
+		for (CONTACT& contact : contacts) {
+			while (cached < cache.size() && cache[cached] < contact) {
+				++cached;
+			}
+			bool hit = warmStarting && cached < cache.size() && !(contact < cache[cached]);
+			contact.normalImpulse = hit ? cache[cached].normalImpulse : 0.0f;
+			// The old friction impulse, kept in the new contact plane
+			contact.tangentImpulse = hit ? cache[cached].tangentImpulse - glm::dot(cache[cached].tangentImpulse, contact.normal) * contact.normal : glm::vec3(0.0f);
+			warmStarted += hit ? 1 : 0;
+			prepare(bodies, contact);
+		}
+		for (CONTACT& contact : contacts) {
+			if (contact.mass > 0.0f) {
+				applyImpulse(bodies, contact, contact.normal * contact.normalImpulse + contact.tangentImpulse);
+			}
+		}
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			for (CONTACT& contact : contacts) {
+				if (contact.mass > 0.0f) {
+					solveVelocity(bodies, contact);
+				}
+			}
+		}
+		// Static and sleeping pairs keep their impulses too, for when the bodies wake
+		cache.assign(contacts.begin(), contacts.end());
+		auto end = std::chrono::high_resolution_clock::now();
+		time = std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	// After INTEGRATE_POSITIONS: pushes overlapping bodies apart, in proportion to their inverse masses
+	void SOLVE_POSITIONS(BODY_STORE& bodies) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int iteration = 0; iteration < positionIterations; ++iteration) {
+			for (CONTACT& contact : contacts) {
+				if (contact.mass <= 0.0f) {
+					continue;
+				}
+				float push = std::min(correction * std::max(getDepth(bodies, contact) - slop, 0.0f), maxCorrection) * contact.mass;
+				if (push > 0.0f) {
+					translate(bodies, contact.denseA, contact.normal * (-push * contact.invMassA));
+					translate(bodies, contact.denseB, contact.normal * (push * contact.invMassB));
+				}
+			}
+		}
+		maxPenetration = 0.0f;
+		for (const CONTACT& contact : contacts) {
+			if (contact.mass > 0.0f) {
+				maxPenetration = std::max(maxPenetration, getDepth(bodies, contact));
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		time += std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+private:
+	std::vector<CONTACT> cache; // last step's contacts, sorted by key
+
+	void prepare(const BODY_STORE& bodies, CONTACT& contact) {
+		auto resolve = [&](BODY_HANDLE body, uint32_t& dense, float& invMass, glm::vec3& position) {
+			invMass = 0.0f;
+			if (!body.isNull() && bodies.isValid(body)) {
+				dense = bodies.getDenseIndex(body);
+				position = { bodies.px[dense], bodies.py[dense], bodies.pz[dense] };
+				invMass = dense < bodies.getAwakeCount() ? bodies.invMass[dense] : 0.0f;
+			}
+		};
+		resolve(contact.bodyA, contact.denseA, contact.invMassA, contact.startA);
+		resolve(contact.bodyB, contact.denseB, contact.invMassB, contact.startB);
+		float inverse = contact.invMassA + contact.invMassB;
+		contact.mass = inverse > 0.0f ? 1.0f / inverse : 0.0f;
+		float approach = glm::dot(getVelocity(bodies, contact.denseB, contact.invMassB) - getVelocity(bodies, contact.denseA, contact.invMassA), contact.normal);
+		contact.bounce = approach < -bounceSpeed ? -restitution * approach : 0.0f;
+	}
+
+	// Friction first, bounded by the normal impulse of the last iteration, then the non-penetration constraint
+	void solveVelocity(BODY_STORE& bodies, CONTACT& contact) {
+		glm::vec3 relative = getVelocity(bodies, contact.denseB, contact.invMassB) - getVelocity(bodies, contact.denseA, contact.invMassA);
+		glm::vec3 slide = relative - glm::dot(relative, contact.normal) * contact.normal;
+		glm::vec3 tangent = contact.tangentImpulse - slide * contact.mass;
+		float limit = friction * contact.normalImpulse;
+		float length = glm::length(tangent);
+		if (length > limit) {
+			tangent *= length > 0.0f ? limit / length : 0.0f;
+		}
+		applyImpulse(bodies, contact, tangent - contact.tangentImpulse);
+		contact.tangentImpulse = tangent;
+
+		relative = getVelocity(bodies, contact.denseB, contact.invMassB) - getVelocity(bodies, contact.denseA, contact.invMassA);
+		float speed = glm::dot(relative, contact.normal);
+		float impulse = std::max(contact.normalImpulse - (speed - contact.bounce) * contact.mass, 0.0f);
+		applyImpulse(bodies, contact, contact.normal * (impulse - contact.normalImpulse));
+		contact.normalImpulse = impulse;
+	}
+
+	static glm::vec3 getVelocity(const BODY_STORE& bodies, uint32_t dense, float invMass) {
+		return invMass > 0.0f ? glm::vec3(bodies.vx[dense], bodies.vy[dense], bodies.vz[dense]) : glm::vec3(0.0f);
+	}
+	// The impulse pushes B along it and A against it
+	static void applyImpulse(BODY_STORE& bodies, const CONTACT& contact, const glm::vec3& impulse) {
+		if (contact.invMassA > 0.0f) {
+			bodies.vx[contact.denseA] -= impulse.x * contact.invMassA;
+			bodies.vy[contact.denseA] -= impulse.y * contact.invMassA;
+			bodies.vz[contact.denseA] -= impulse.z * contact.invMassA;
+		}
+		if (contact.invMassB > 0.0f) {
+			bodies.vx[contact.denseB] += impulse.x * contact.invMassB;
+			bodies.vy[contact.denseB] += impulse.y * contact.invMassB;
+			bodies.vz[contact.denseB] += impulse.z * contact.invMassB;
+		}
+	}
+	static void translate(BODY_STORE& bodies, uint32_t dense, const glm::vec3& offset) {
+		if (offset != glm::vec3(0.0f)) {
+			bodies.px[dense] += offset.x;
+			bodies.py[dense] += offset.y;
+			bodies.pz[dense] += offset.z;
+		}
+	}
+	// Penetration now: the bodies only translate, so it changes by how far they moved along the normal
+	static float getDepth(const BODY_STORE& bodies, const CONTACT& contact) {
+		glm::vec3 movedA = contact.invMassA > 0.0f ? glm::vec3(bodies.px[contact.denseA], bodies.py[contact.denseA], bodies.pz[contact.denseA]) - contact.startA : glm::vec3(0.0f);
+		glm::vec3 movedB = contact.invMassB > 0.0f ? glm::vec3(bodies.px[contact.denseB], bodies.py[contact.denseB], bodies.pz[contact.denseB]) - contact.startB : glm::vec3(0.0f);
+		return contact.depth - glm::dot(movedB - movedA, contact.normal);
+	}
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef __UTHREAD_HPP__
+#define __UTHREAD_HPP__
+#include "UPROFILE.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool. Every participant owns a deque: it pops its own tasks from the back
+// and steals from the front of the others. The thread calling PARALLEL_FOR is participant 0.
+struct THREAD_POOL {
+	using TASK = std::function<void(size_t worker)>;
+
+	THREAD_POOL(size_t threadCount = 1) {
+		RESIZE(threadCount);
+	}
+	THREAD_POOL(const THREAD_POOL&) = delete;
+	THREAD_POOL& operator=(const THREAD_POOL&) = delete;
+	~THREAD_POOL() {
+		STOP();
+	}
+
+	size_t getThreadCount() const {
+		return queues.size();
+	}
+
+	void RESIZE(size_t threadCount) {
+		threadCount = std::max<size_t>(threadCount, 1);
+		if (threadCount == queues.size()) {
+			return;
+		}
+		STOP();
+		stopping = false;
+		queues.clear();
+		for (size_t i = 0; i < threadCount; ++i) {
+			queues.push_back(std::make_unique<WORKER_QUEUE>());
+		}
+		for (size_t i = 1; i < threadCount; ++i) {
+			threads.emplace_back([this, i]() { workerLoop(i); });
+		}
+	}
+
+	void STOP() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	// Splits [0, count) into chunks of grain and blocks until all of them ran.
+	// fn(begin, end, worker) gets the index of the participant running it, for per-thread buffers.
+	void PARALLEL_FOR(size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& fn) {
+		grain = std::max<size_t>(grain, 1);
+		size_t chunks = (count + grain - 1) / grain;
+		if (queues.size() == 1 || chunks <= 1) {
+			if (count > 0) {
+				fn(0, count, 0);
+			}
+			return;
+		}
+		pending = chunks;
+		for (size_t c = 0; c < chunks; ++c) {
+			size_t begin = c * grain;
+			size_t end = std::min(count, begin + grain);
+			WORKER_QUEUE& queue = *queues[c % queues.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back([&fn, begin, end](size_t worker) { fn(begin, end, worker); });
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			queued += chunks;
+		}
+		wake.notify_all();
+
+		while (pending > 0) {
+			TASK task;
+			if (pop(0, task)) {
+				run(0, task);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	struct WORKER_QUEUE {
+		std::mutex mutex;
+		std::deque<TASK> tasks;
+	};
+	std::vector<std::unique_ptr<WORKER_QUEUE>> queues;
+	std::vector<std::thread> threads;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<size_t> pending{ 0 };
+	std::atomic<size_t> queued{ 0 };
+	bool stopping = false;
+
+	bool pop(size_t worker, TASK& task) {
+		{
+			WORKER_QUEUE& own = *queues[worker];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty()) {
+				task = std::move(own.tasks.back());
+				own.tasks.pop_back();
+				--queued;
+				return true;
+			}
+		}
+		for (size_t i = 1; i < queues.size(); ++i) {
+			WORKER_QUEUE& victim = *queues[(worker + i) % queues.size()];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty()) {
+				task = std::move(victim.tasks.front());
+				victim.tasks.pop_front();
+				--queued;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run(size_t worker, TASK& task) {
+		task(worker);
+		--pending;
+	}
+
+	void workerLoop(size_t worker) {
+		UPROFILE_THREAD("Worker");
+		while (true) {
+			TASK task;
+			if (pop(worker, task)) {
+				run(worker, task);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this]() { return stopping || queued > 0; });
+			if (stopping) {
+				return;
+			}
+		}
+	}
+};
+
+#endif
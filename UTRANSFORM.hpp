@@ -0,0 +1,169 @@
+#ifndef __UTRANSFORM_HPP__
+#define __UTRANSFORM_HPP__
+#include "UPHYSIC.hpp"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+// One node of a transform hierarchy: position, Euler rotation (degrees, applied X then Y then Z) and scale
+// relative to the parent. The local, world and normal matrices are cached and rebuilt on the first read
+// after a change. A change marks the node's subtree stale, stopping at nodes that already are, so moving
+// one object touches its own descendants only and moving it again before a read touches nothing.
+struct TRANSFORM {
+	// Called when the world matrix goes stale, through this node or an ancestor; no matrix may be read in it
+	std::function<void()> onWorldChanged;
+
+	TRANSFORM() = default;
+	TRANSFORM(const TRANSFORM&) = delete;
+	TRANSFORM& operator=(const TRANSFORM&) = delete;
+	// Children stay where their local transform puts them, relative to the world from now on
+	~TRANSFORM() {
+		setParent(nullptr);
+		for (TRANSFORM* child : children) {
+			child->parent = nullptr;
+			child->markWorldDirty();
+		}
+	}
+
+	const glm::vec3& getPosition() const {
+		return position;
+	}
+	const glm::vec3& getRotation() const {
+		return rotation;
+	}
+	const glm::vec3& getScale() const {
+		return scale;
+	}
+	void setPosition(const glm::vec3& value) {
+		if (value != position) {
+			position = value;
+			markLocalDirty();
+		}
+	}
+	void setRotation(const glm::vec3& degrees) {
+		if (degrees != rotation) {
+			rotation = degrees;
+			markLocalDirty();
+		}
+	}
+	void setScale(const glm::vec3& value) {
+		if (value != scale) {
+			scale = value;
+			markLocalDirty();
+		}
+	}
+
+	TRANSFORM* getParent() const {
+		return parent;
+	}
+	const std::vector<TRANSFORM*>& getChildren() const {
+		return children;
+	}
+	bool isAncestorOf(const TRANSFORM* node) const {
+		for (; node; node = node->parent) {
+			if (node == this) {
+				return true;
+			}
+		}
+		return false;
+	}
+	// Keeps the local transform, so the node moves with its new parent. False, and nothing changes, for a cycle.
+	bool setParent(TRANSFORM* newParent) {
+		if (newParent == parent) {
+			return true;
+		}
+		if (newParent && isAncestorOf(newParent)) {
+			return false;
+		}
+		if (parent) {
+			parent->children.erase(std::find(parent->children.begin(), parent->children.end(), this));
+		}
+		parent = newParent;
+		if (parent) {
+			parent->children.push_back(this);
+		}
+		markWorldDirty();
+		return true;
+	}
+
+	const glm::mat4& getLocalMatrix() const {
+		if (localDirty) {
+			local = compose(position, rotation, scale);
+			localDirty = false;
+		}
+		return local;
+	}
+	const glm::mat4& getWorldMatrix() const {
+		if (worldDirty) {
+			world = parent ? parent->getWorldMatrix() * getLocalMatrix() : getLocalMatrix();
+			worldDirty = false;
+		}
+		return world;
+	}
+	// Inverse transpose of the world 3x3, for normals in world space
+	const glm::mat3& getNormalMatrix() const {
+		if (normalDirty) {
+			normal = inverseTranspose(glm::mat3(getWorldMatrix()));
+			normalDirty = false;
+		}
+		return normal;
+	}
+
+	// A zero scale has no inverse; its normals are never seen, so any finite matrix will do
+	static glm::mat3 inverseTranspose(const glm::mat3& linear) {
+		return std::abs(glm::determinant(linear)) > 1e-12f ? glm::transpose(glm::inverse(linear)) : linear;
+	}
+
+	// Rz * Ry * Rx alone, the axes of a box rotated by degrees
+	static glm::mat3 rotationMatrix(const glm::vec3& degrees) {
+		return glm::mat3(compose(glm::vec3(0.0f), degrees, glm::vec3(1.0f)));
+	}
+	// translate * Rz * Ry * Rx * scale, written out instead of multiplied together
+	static glm::mat4 compose(const glm::vec3& position, const glm::vec3& degrees, const glm::vec3& scale) {
+		float sx = std::sin(glm::radians(degrees.x)), cx = std::cos(glm::radians(degrees.x));
+		float sy = std::sin(glm::radians(degrees.y)), cy = std::cos(glm::radians(degrees.y));
+		float sz = std::sin(glm::radians(degrees.z)), cz = std::cos(glm::radians(degrees.z));
+		glm::mat4 matrix(1.0f);
+		matrix[0] = glm::vec4(cz * cy, sz * cy, -sy, 0.0f) * scale.x;
+		matrix[1] = glm::vec4(cz * sy * sx - sz * cx, sz * sy * sx + cz * cx, cy * sx, 0.0f) * scale.y;
+		matrix[2] = glm::vec4(cz * sy * cx + sz * sx, sz * sy * cx - cz * sx, cy * cx, 0.0f) * scale.z;
+		matrix[3] = glm::vec4(position, 1.0f);
+		return matrix;
+	}
+
+private:
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 rotation = glm::vec3(0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+	TRANSFORM* parent = nullptr;
+	std::vector<TRANSFORM*> children;
+
+	mutable glm::mat4 local = glm::mat4(1.0f);
+	mutable glm::mat4 world = glm::mat4(1.0f);
+	mutable glm::mat3 normal = glm::mat3(1.0f);
+	mutable bool localDirty = false;
+	mutable bool worldDirty = false;
+	mutable bool normalDirty = false;
+
+	void markLocalDirty() {
+		localDirty = true;
+		markWorldDirty();
+	}
+	// A stale node's descendants are all stale already: a node is only refreshed after its parent
+	void markWorldDirty() {
+		if (worldDirty) {
+			return;
+		}
+		worldDirty = true;
+		normalDirty = true;
+		if (onWorldChanged) {
+			onWorldChanged();
+		}
+		for (TRANSFORM* child : children) {
+			child->markWorldDirty();
+		}
+	}
+};
+
+#endif
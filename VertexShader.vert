@@ -1,23 +1,48 @@
 #version 330 core
 
 layout (location = 0) in vec3 mPos;
+#ifdef OCT_NORMALS
+layout (location = 1) in vec2 mNormal;
+#else
 layout (location = 1) in vec3 mNormal;
+#endif
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec3 LightDir;
+out vec3 Color;
 
 uniform mat4 model;
+uniform mat3 normalMatrix; // inverse transpose of model, computed once per object on the CPU
 uniform mat4 view;
 uniform mat4 projection;
 uniform vec3 lightPos;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform vec3 objectColor;
+
+vec3 decodeNormal()
+{
+#ifdef OCT_NORMALS
+    vec3 n = vec3(mNormal, 1.0 - abs(mNormal.x) - abs(mNormal.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+#else
+    return mNormal;
+#endif
+}
 
 void main()
 {
-    vec4 worldPos = model * vec4(mPos, 1.0);
+    // Identity for float positions, bounds dequantization for 16-bit ones
+    vec3 position = mPos * positionScale + positionOffset;
+    vec4 worldPos = model * vec4(position, 1.0);
     gl_Position = projection * view * worldPos;
 
     FragPos = worldPos.xyz;
-    Normal = mat3(transpose(inverse(model * view))) * mNormal;
+    Normal = normalMatrix * decodeNormal();
     LightDir = normalize(lightPos - FragPos);
+    Color = objectColor;
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #include "UIMGUI.hpp"
+#include "UBENCH.hpp"
+#include "UHEADLESS.hpp"
 EDITOR sEditor;
 KEYBOARD sKeyboard;
 MOUSE sMouse;
 IMGUI sImgui;
+FRAME_TIMINGS sFrameTimings;
 
 void activeKeyboard(unsigned char key, int x, int y) {
     if (ImGui::GetIO().WantCaptureKeyboard) {
@@ -19,6 +22,7 @@ void activeMouse(int button, int state, int x, int y) {
         ImGui_ImplGLUT_MouseFunc(button, state, x, y);
     }
     else {
+        std::lock_guard<std::mutex> lock(sEditor.physicsThread.simulationMutex);
         sMouse.active(button, state, x, y, sEditor);
         glutPostRedisplay();
     }
@@ -57,41 +61,85 @@ void CAMERA_VIEW() {
     glLoadMatrixf(glm::value_ptr(viewMatrix));
 }
 
+// Every collider of the scene, with its entity's body (null without one) and a key that identifies the
+// entity across steps for the contact cache, in broadphase proxy order.
+// The bounds of a proxy whose sleeping body held it last step too are kept from that step.
+// The narrowphase shapes turn each box by its model's rotation.
+std::vector<COLLIDER*> physicsColliders;
+std::vector<BODY_HANDLE> physicsBodies;
+std::vector<uint64_t> physicsKeys;
+std::vector<BODY_HANDLE> previousPhysicsBodies;
+std::vector<AABB> physicsBounds;
+NARROWPHASE_SHAPES physicsShapes;
+std::vector<BROADPHASE_PAIR> physicsPairs;
+
 void PHYSICS_PIPE() {
-    for (size_t i = 0; i < sEditor.models.size(); ++i) {
-        sEditor.models[i]->setCollision(false);
-    }
-    for (size_t i = 0; i < sEditor.models.size(); ++i) {
-        for (size_t j = i + 1; j < sEditor.models.size(); ++j) {
-            if (sEditor.models[i]->collider == nullptr || sEditor.models[j]->collider == nullptr) {
-				continue;
-			}
-            if (CollisionChecking(*sEditor.models[i]->collider, *sEditor.models[j]->collider)) {
-                sEditor.models[i]->setCollision(true);
-                sEditor.models[j]->setCollision(true);
-			}
+    UPROFILE_SCOPE("PHYSICS_PIPE");
+    std::swap(physicsBodies, previousPhysicsBodies);
+    physicsColliders.clear();
+    physicsBodies.clear();
+    physicsKeys.clear();
+    physicsShapes.CLEAR();
+    BODY_STORE& bodies = getBodyStore();
+    bodies.CLEAR_COLLISIONS();
+    std::vector<uint8_t>& resting = sEditor.broadphase->resting;
+    resting.clear();
+    sEditor.entities.FOR_EACH(0, [&](ARCHETYPE& archetype) {
+        if (!archetype.hasAny(COMPONENT_COLLIDER)) {
+            return;
+        }
+        bool hasBody = archetype.has(COMPONENT_BODY);
+        for (size_t row = 0; row < archetype.size(); ++row) {
+            COLLIDER* collider = archetype.getCollider(row);
+            BODY_HANDLE body = hasBody ? archetype.bodies[row] : BODY_HANDLE();
+            size_t proxy = physicsColliders.size();
+            bool asleep = !body.isNull() && !bodies.isAwake(body);
+            bool unchanged = asleep && proxy < previousPhysicsBodies.size() && previousPhysicsBodies[proxy] == body;
+            if (!asleep) {
+                collider->collision = false;
+            }
+            physicsColliders.push_back(collider);
+            physicsBodies.push_back(body);
+            physicsShapes.ADD(*collider, TRANSFORM::rotationMatrix(archetype.models[row]->getProperty_RotationAxis()));
+            physicsKeys.push_back(static_cast<uint64_t>(archetype.entities[row].generation) << 32 | archetype.entities[row].index);
+            if (proxy == physicsBounds.size()) {
+                physicsBounds.emplace_back();
+            }
+            if (!unchanged) {
+                physicsBounds[proxy] = getColliderBounds(*collider);
+            }
+            resting.push_back(unchanged ? 1 : 0);
+        }
+    });
+    physicsBounds.resize(physicsColliders.size());
+    sEditor.broadphase->COLLECT(physicsBounds, physicsPairs);
+    const std::vector<uint32_t>& hits = sEditor.narrowphase.RUN_BATCHED(physicsPairs, physicsShapes);
+    sEditor.islands.BEGIN();
+    sEditor.solver.BEGIN();
+    for (uint32_t hit : hits) {
+        const BROADPHASE_PAIR& pair = physicsPairs[hit];
+        sEditor.islands.CONTACT(bodies, physicsBodies[pair.a], physicsBodies[pair.b]);
+        sEditor.solver.ADD(*physicsColliders[pair.a], *physicsColliders[pair.b], physicsKeys[pair.a], physicsKeys[pair.b],
+            physicsBodies[pair.a], physicsBodies[pair.b], physicsShapes[pair.a].axes, physicsShapes[pair.b].axes);
+        for (uint32_t proxy : { pair.a, pair.b }) {
+            physicsColliders[proxy]->collision = true;
+            if (!physicsBodies[proxy].isNull()) {
+                bodies.setCollision(physicsBodies[proxy], true);
+            }
         }
     }
 }
 
 void DRAW_GRID() {
-    int gridSize = 100;
-    float cellSize = 100.0f / gridSize;
-    glColor3f(0.5f, 0.5f, 0.5f);
-    for (int i = -gridSize / 2; i < gridSize / 2; ++i) {
-        for (int j = -gridSize / 2; j < gridSize / 2; ++j) {
-            glBegin(GL_LINE_LOOP); // 각 셀을 그립니다.
-            glVertex3f(i * cellSize, 0.0f, j * cellSize);
-            glVertex3f((i + 1) * cellSize, 0.0f, j * cellSize);
-            glVertex3f((i + 1) * cellSize, 0.0f, (j + 1) * cellSize);
-            glVertex3f(i * cellSize, 0.0f, (j + 1) * cellSize);
-            glEnd();
-        }
-    }
+    UPROFILE_SCOPE("DRAW_GRID");
+    sEditor.grid.DRAW();
 }
 
 void DRAW_AXIS() {
-    glDisable(GL_LIGHTING);
+    UPROFILE_SCOPE("DRAW_AXIS");
+    GL_STATE& state = getGlState();
+    state.USE_FIXED_FUNCTION();
+    state.DISABLE(GL_LIGHTING);
 
     glBegin(GL_LINES);
     glColor3f(1.0, 0.0, 0.0);
@@ -105,82 +153,147 @@ void DRAW_AXIS() {
     glVertex3f(0.0, 0.0, 1000.0);
     glEnd();
 
-    for(auto& model : sEditor.models){
-        if (model->axisX != nullptr) {
-            model->axisX->setStart(model->getProperty_Position());
-            model->axisX->DRAW();
-        }
-        if (model->axisY != nullptr) {
-            model->axisY->setStart(model->getProperty_Position());
-            model->axisY->DRAW();
+    sEditor.entities.FOR_EACH(COMPONENT_GIZMO, [](ARCHETYPE& archetype) {
+        for (size_t row = 0; row < archetype.size(); ++row) {
+            archetype.gizmos[row].DRAW(archetype.models[row]->getProperty_Position());
         }
-        if (model->axisZ != nullptr) {
-            model->axisZ->setStart(model->getProperty_Position());
-            model->axisZ->DRAW();
-        }
-	}
+    });
 
-    glEnable(GL_LIGHTING);
+    state.ENABLE(GL_LIGHTING);
 }
 
 void DRAW_COLLIDER() {
-    glDisable(GL_LIGHTING);
+    UPROFILE_SCOPE("DRAW_COLLIDER");
+    GL_STATE& state = getGlState();
+    state.USE_FIXED_FUNCTION();
+    state.DISABLE(GL_LIGHTING);
     for (auto& light : sEditor.lights) {
 		light.DRAW();
 	}
-    for (auto& model : sEditor.models) {
-        if (model->collider == nullptr) {
-            continue;
-        }
-        if (model->collider->type == COLLIDER_TYPE::SPHERE) {
-            SPHERE_COLLIDER* sphereCollider = dynamic_cast<SPHERE_COLLIDER*>(model->collider.get());
-            sphereCollider->DRAW();
+    sEditor.entities.FOR_EACH(COMPONENT_SPHERE_COLLIDER, [](ARCHETYPE& archetype) {
+        for (SPHERE_COLLIDER& sphere : archetype.spheres) {
+            sphere.DRAW();
         }
-        else if (model->collider->type == COLLIDER_TYPE::BOX) {
-            BOX_COLLIDER* boxCollider = dynamic_cast<BOX_COLLIDER*>(model->collider.get());
-            boxCollider->DRAW();
+    });
+    sEditor.entities.FOR_EACH(COMPONENT_BOX_COLLIDER, [](ARCHETYPE& archetype) {
+        for (BOX_COLLIDER& box : archetype.boxes) {
+            box.DRAW();
         }
-    }
-    glDisable(GL_BLEND);
+    });
+    // Collider shapes enable blending themselves
+    state.FORGET_CAPABILITY(GL_BLEND);
+    state.DISABLE(GL_BLEND);
 }
 
 void DRAW_WORLD() {
+    UPROFILE_SCOPE("DRAW_WORLD");
+    auto start = std::chrono::high_resolution_clock::now();
     for (auto& light : sEditor.lights) {
         light.SET();
     }
-    for(auto& model : sEditor.models) {
-		model->DRAW(sEditor.lights.at(0), *sEditor.camera);
-	}
+    // Without culling every model counts as visible
+    std::vector<MODEL*>& visible = sEditor.culler.visible;
+    if (sEditor.culling) {
+        sEditor.culler.CULL(sEditor.entities.getModels(), *sEditor.camera);
+    }
+    else {
+        visible = sEditor.entities.getModels();
+    }
+    for (MODEL* model : visible) {
+        model->UPDATE_LOD(*sEditor.camera, getLodSettings());
+    }
+    RENDER_MODE mode = sEditor.renderMode;
+    if (mode == RENDER_MODE::INDIRECT && !GEOMETRY_ARENAS::isSupported()) {
+        mode = RENDER_MODE::INSTANCED;
+    }
+    switch (mode) {
+    case RENDER_MODE::INDIRECT:
+        sEditor.indirectRenderer.DRAW(visible, sEditor.lights.at(0), *sEditor.camera);
+        break;
+    case RENDER_MODE::INSTANCED:
+        sEditor.instancedRenderer.DRAW(visible, sEditor.lights.at(0), *sEditor.camera);
+        break;
+    default:
+        for (MODEL* model : visible) {
+            model->DRAW(sEditor.lights.at(0), *sEditor.camera);
+        }
+        break;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    getRenderStats().submitTime = std::chrono::duration<double, std::milli>(end - start).count();
 }
 
 void DRAW_GUI() {
+    UPROFILE_SCOPE("DRAW_GUI");
     sImgui.begin();
     sImgui.draw(sEditor);
     sImgui.end();
     glutPostRedisplay();
 }
 
-void UPDATE_PHYSICS(){
-    for(auto& model : sEditor.models){
-        if (model->physics != nullptr) {
-            if (model->collider != nullptr && model->collider->collision)
-            {
-                model->physics->setVelocity(glm::zero<glm::vec3>());
-                model->physics->setForce(glm::zero<glm::vec3>());
+void UPDATE_PHYSICS(float dt){
+    UPROFILE_SCOPE("UPDATE_PHYSICS");
+    BODY_STORE& bodies = getBodyStore();
+    bodies.INTEGRATE_VELOCITIES(dt, sEditor.solver.gravity);
+    sEditor.solver.SOLVE_VELOCITIES(bodies);
+    bodies.INTEGRATE_POSITIONS(dt);
+    sEditor.solver.SOLVE_POSITIONS(bodies);
+    sEditor.entities.FOR_EACH(COMPONENT_BODY, [&](ARCHETYPE& archetype) {
+        if (!archetype.hasAny(COMPONENT_COLLIDER)) {
+            return;
+        }
+        for (size_t row = 0; row < archetype.size(); ++row) {
+            uint32_t i = bodies.getDenseIndex(archetype.bodies[row]);
+            if (i < bodies.getAwakeCount()) {
+                archetype.getCollider(row)->position = { bodies.px[i], bodies.py[i], bodies.pz[i] };
             }
-            glm::vec3 addPos = model->physics->UPDATE(0.1f);
-            glm::vec3 pos = model->getProperty_Position();
-            model->setProperty_Position(pos + addPos);
         }
-	}
+    });
+    sEditor.islands.UPDATE(bodies, dt);
 }
 
-void engineLoop() {
+// Runs on sEditor.physicsThread with simulationMutex held
+void STEP_PHYSICS(float dt) {
+    PHYSICS_PIPE();
+    UPDATE_PHYSICS(dt);
+}
+
+void CAPTURE_PHYSICS(TRANSFORM_SNAPSHOT& snapshot) {
+    getBodyStore().CAPTURE(snapshot.positions, snapshot.generations);
+}
+
+std::shared_ptr<const TRANSFORM_SNAPSHOT> previousSnapshot;
+std::shared_ptr<const TRANSFORM_SNAPSHOT> currentSnapshot;
+
+// Takes the last two physics snapshots and interpolates the drawn positions
+void SYNC_TRANSFORMS() {
+    bool hasSnapshots = sEditor.physicsThread.snapshots.READ(previousSnapshot, currentSnapshot);
+    float alpha = hasSnapshots ? sEditor.physicsThread.getAlpha(*currentSnapshot) : 1.0f;
+    sEditor.entities.FOR_EACH(0, [&](ARCHETYPE& archetype) {
+        bool hasBody = hasSnapshots && archetype.has(COMPONENT_BODY);
+        for (size_t row = 0; row < archetype.size(); ++row) {
+            MODEL& model = *archetype.models[row];
+            glm::vec3 current;
+            if (hasBody && currentSnapshot->find(archetype.bodies[row], current)) {
+                glm::vec3 previous = current;
+                previousSnapshot->find(archetype.bodies[row], previous);
+                model.syncFromSnapshot(current, glm::mix(previous, current, alpha));
+            }
+            else {
+                model.syncFromSnapshot();
+            }
+        }
+    });
+}
+
+// Scene part of a frame, shared by engineLoop and the headless benchmark
+void DRAW_FRAME() {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     PERSPECTIVE_VIEW();
     CAMERA_VIEW();
-    PHYSICS_PIPE();
+    SYNC_TRANSFORMS();
+    sFrameTimings.LAP(FRAME_PHASE::SYNC);
     if (sEditor.axisView) {
         DRAW_AXIS();
     }
@@ -188,19 +301,232 @@ void engineLoop() {
 		DRAW_GRID();
 	}
     if (sEditor.colliderView) {
+        std::lock_guard<std::mutex> lock(sEditor.physicsThread.simulationMutex);
         DRAW_COLLIDER();
     }
+    sFrameTimings.LAP(FRAME_PHASE::HELPERS);
     if (sEditor.modelView) {
-        DRAW_GRID();
         DRAW_WORLD();
 	}
-    DRAW_GUI();
-    UPDATE_PHYSICS();
+    sFrameTimings.LAP(FRAME_PHASE::WORLD);
+}
+
+void engineLoop() {
+    UPROFILE_FRAME();
+    getRenderStats().RESET();
+    if (sEditor.renderBenchmark.active) {
+        sEditor.renderMode = sEditor.renderBenchmark.getMode();
+    }
+    sFrameTimings.BEGIN();
+    DRAW_FRAME();
+    {
+        std::lock_guard<std::mutex> lock(sEditor.physicsThread.simulationMutex);
+        sEditor.importQueue.POLL(sEditor.entities);
+        sFrameTimings.LAP(FRAME_PHASE::IMPORT);
+        DRAW_GUI();
+        sFrameTimings.LAP(FRAME_PHASE::GUI);
+    }
 
     glutSwapBuffers(); 
+    sFrameTimings.LAP(FRAME_PHASE::GPU);
+    sFrameTimings.END();
+
+    if (sEditor.renderBenchmark.active) {
+        sEditor.renderBenchmark.RECORD(getRenderStats());
+        if (sEditor.renderBenchmark.isFinished()) {
+            glutLeaveMainLoop();
+        }
+    }
+}
+
+void ADD_CUBE_GRID(int cubeCount) {
+    int side = static_cast<int>(std::ceil(std::cbrt(static_cast<double>(cubeCount))));
+    for (int i = 0; i < cubeCount; ++i) {
+        std::unique_ptr<CUBE> cube = std::make_unique<CUBE>();
+        cube->Init("");
+        cube->setProperty_Position(glm::vec3(i % side, (i / side) % side, i / (side * side)) * 2.0f);
+        sEditor.entities.CREATE(std::move(cube));
+    }
+}
+
+// --bench-instancing <cubes> [framesPerMode]: fills the scene with cubes and compares indirect, instanced and per-model submission
+void START_RENDER_BENCHMARK(int cubeCount, int framesPerMode) {
+    ADD_CUBE_GRID(cubeCount);
+    sEditor.renderBenchmark.active = true;
+    sEditor.renderBenchmark.framesPerMode = std::max(framesPerMode, 1);
+    printf("Render benchmark: %d cubes, %d frames per mode\n", cubeCount, sEditor.renderBenchmark.framesPerMode);
+}
+
+// --headless [frames] [--size WxH] [--cubes N] [--fbx file]... [--warmup N] [--json out.json] [--dump out.ppm] [--trace out.json]
+// [--physics] [--mode per-model|instanced|indirect]:
+// renders the scene into an offscreen context along a scripted orbit and reports per-phase frame time
+// percentiles as JSON. No GUI is drawn; the GPU phase is a glFinish, so it measures the (software) driver.
+int RUN_HEADLESS(const HEADLESS_OPTIONS& options) {
+    HEADLESS_CONTEXT context;
+    if (!context.CREATE(options.width, options.height)) {
+        return 1;
+    }
+    sEditor.camera = std::make_shared<CAMERA>();
+    sEditor.camera->_viewportWidth = options.width;
+    sEditor.camera->_viewportHeight = options.height;
+    getGlState().ENABLE(GL_DEPTH_TEST);
+    getGlState().ENABLE(GL_LIGHTING);
+    getGlState().ENABLE(GL_LIGHT0);
+    // Light and collider gizmos are GLUT shapes, which need glutInit and so a display
+    sEditor.colliderView = false;
+    sEditor.renderMode = options.mode;
+
+    ADD_CUBE_GRID(options.cubes);
+    for (const std::string& file : options.files) {
+        sEditor.importQueue.ADD(file);
+    }
+    while (!sEditor.importQueue.getJobs().empty()) {
+        sEditor.importQueue.POLL(sEditor.entities);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    HEADLESS_CAMERA_PATH path;
+    path.SET(sEditor.entities.getModels());
+    if (options.physics) {
+        sEditor.physicsThread.START(STEP_PHYSICS, CAPTURE_PHYSICS);
+    }
+
+    size_t triangles = 0;
+    size_t drawCalls = 0;
+    GL_CALL_COUNTS glCalls; // reported per frame as [issued, skipped]
+    for (int frame = -options.warmupFrames; frame < options.frames; ++frame) {
+        getRenderStats().RESET();
+        path.APPLY(*sEditor.camera, std::max(frame, 0), options.frames);
+        UPROFILE_FRAME();
+        sFrameTimings.recording = frame >= 0;
+        sFrameTimings.BEGIN();
+        DRAW_FRAME();
+        {
+            std::lock_guard<std::mutex> lock(sEditor.physicsThread.simulationMutex);
+            sEditor.importQueue.POLL(sEditor.entities);
+        }
+        sFrameTimings.LAP(FRAME_PHASE::IMPORT);
+        glFinish();
+        sFrameTimings.LAP(FRAME_PHASE::GPU);
+        sFrameTimings.END();
+        if (frame >= 0) {
+            triangles += getRenderStats().trianglesDrawn;
+            drawCalls += getRenderStats().drawCalls;
+            glCalls += getGlState().calls;
+        }
+    }
+    sEditor.physicsThread.STOP();
+#if UPROFILE_ENABLED
+    if (!options.tracePath.empty() && !getProfiler().EXPORT_CHROME_TRACE(options.tracePath)) {
+        std::cerr << "Could not write trace " << options.tracePath << std::endl;
+    }
+#endif
+
+    bool imageSaved = !options.imagePath.empty() && context.SAVE_IMAGE(options.imagePath);
+    std::string renderer = context.getRenderer();
+    std::replace(renderer.begin(), renderer.end(), '"', '\'');
+    std::ostringstream json;
+    json << "{\n"
+         << "  \"renderer\": \"" << renderer << "\",\n"
+         << "  \"width\": " << options.width << ",\n"
+         << "  \"height\": " << options.height << ",\n"
+         << "  \"frames\": " << options.frames << ",\n"
+         << "  \"renderMode\": \"" << getRenderModeName(sEditor.renderMode) << "\",\n"
+         << "  \"models\": " << sEditor.entities.size() << ",\n"
+         << "  \"trianglesPerFrame\": " << triangles / options.frames << ",\n"
+         << "  \"drawCallsPerFrame\": " << drawCalls / options.frames << ",\n"
+         << "  \"glCallsPerFrame\": {";
+    for (size_t i = 0; i < static_cast<size_t>(GL_CALL::COUNT); ++i) {
+        json << (i ? ", " : "") << "\"" << getGlCallName(static_cast<GL_CALL>(i)) << "\": [" << glCalls.issued[i] / options.frames
+             << ", " << glCalls.skipped[i] / options.frames << "]";
+    }
+    json << "},\n"
+         << "  \"image\": " << (imageSaved ? "\"" + options.imagePath + "\"" : std::string("null")) << ",\n"
+         << "  \"ms\": " << sFrameTimings.TO_JSON(2) << "\n"
+         << "}\n";
+    if (options.jsonPath.empty()) {
+        std::cout << json.str();
+    }
+    else {
+        std::ofstream(options.jsonPath) << json.str();
+    }
+    // Release the GL objects while the context is still current
+    sEditor.entities.CLEAR();
+    sEditor.indirectRenderer.RELEASE();
+    getGeometryArenas().CLEAR();
+    return 0;
 }
 
 int main(int argc, char** argv) {
+    UPROFILE_THREAD("Main");
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--headless") {
+            HEADLESS_OPTIONS options;
+            if (!options.PARSE(argc, argv, i)) {
+                return 1;
+            }
+            return RUN_HEADLESS(options);
+        }
+        if (std::string(argv[i]) == "--bench-broadphase") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 10000;
+            int frames = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 30;
+            BENCH_BROADPHASE(count, frames);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-narrowphase") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100000;
+            size_t maxThreads = (i + 2 < argc) ? std::strtoul(argv[i + 2], nullptr, 10) : std::thread::hardware_concurrency();
+            BENCH_NARROWPHASE(count, maxThreads);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--fuzz-narrowphase") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 1000000;
+            uint32_t seed = (i + 2 < argc) ? static_cast<uint32_t>(std::strtoul(argv[i + 2], nullptr, 10)) : 1234;
+            return FUZZ_NARROWPHASE(count, seed) ? 0 : 1;
+        }
+        if (std::string(argv[i]) == "--bench-integrate") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100000;
+            int steps = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 100;
+            BENCH_INTEGRATE(count, steps);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-sleep") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 5000;
+            int steps = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 300;
+            BENCH_SLEEP(count, steps);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-stacking") {
+            size_t columns = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100;
+            int steps = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 300;
+            float tilt = (i + 3 < argc) ? static_cast<float>(std::atof(argv[i + 3])) : 0.0f;
+            BENCH_STACKING(columns, steps, tilt);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-picking") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100000;
+            int rays = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 100;
+            BENCH_PICKING(count, rays);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-culling") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100000;
+            int frames = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 100;
+            BENCH_CULLING(count, frames);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-scene") {
+            size_t count = (i + 1 < argc) ? std::strtoul(argv[i + 1], nullptr, 10) : 100000;
+            int runs = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 5;
+            BENCH_SCENE(count, runs);
+            return 0;
+        }
+        if (std::string(argv[i]) == "--bench-meshcache" && i + 1 < argc) {
+            int runs = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 5;
+            BENCH_MESH_CACHE(argv[i + 1], runs);
+            return 0;
+        }
+    }
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH | GLUT_MULTISAMPLE);
 
@@ -222,10 +548,10 @@ int main(int argc, char** argv) {
     ImGui_ImplGLUT_InstallFuncs();
     ImGui_ImplOpenGL3_Init("#version 130");
 
-    glEnable(GL_MULTISAMPLE);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
+    getGlState().ENABLE(GL_MULTISAMPLE);
+    getGlState().ENABLE(GL_DEPTH_TEST);
+    getGlState().ENABLE(GL_LIGHTING);
+    getGlState().ENABLE(GL_LIGHT0);
 
     glutReshapeFunc(reshape);
     glutDisplayFunc(engineLoop);
@@ -235,6 +561,17 @@ int main(int argc, char** argv) {
     glutMouseWheelFunc(activeScroll);
     reshape(windowWidth, windowHeight);
 
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--bench-instancing" && i + 1 < argc) {
+            int cubeCount = std::atoi(argv[i + 1]);
+            int framesPerMode = (i + 2 < argc) ? std::atoi(argv[i + 2]) : 100;
+            START_RENDER_BENCHMARK(cubeCount, framesPerMode);
+        }
+    }
+
+    glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_GLUTMAINLOOP_RETURNS);
+    sEditor.physicsThread.START(STEP_PHYSICS, CAPTURE_PHYSICS);
     glutMainLoop();
+    sEditor.physicsThread.STOP();
     return 0;
 }